@@ -0,0 +1,46 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   AdminConsole.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/27 11:20:14 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/27 11:20:14 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef ADMINCONSOLE_HPP
+# define ADMINCONSOLE_HPP
+
+# include "UtilityHeaders.hpp"
+
+/**
+ * @brief A connection to the admin socket (see ServerAdmin.cpp): its
+ * unread lines, the output waiting for it and the table it is being sent,
+ * if any. A table is listed a few rows per loop iteration, from the key
+ * of the next row, so clients and channels may come and go meanwhile.
+ *
+ * @var listing  The table being listed, LIST_NONE between commands.
+ * @var channel  LIST_CHANNELS: the next channel. LIST_MEMBERS: the channel.
+ * @var nextId   LIST_CLIENTS, LIST_MEMBERS: the id of the next row.
+ * @var closing  QUIT or end of input, closed once everything is answered.
+ * @var skipping A line was too long, input is dropped up to its end.
+ *
+ * @author Hamad
+ */
+struct AdminConsole {
+	enum Listing {LIST_NONE, LIST_CLIENTS, LIST_CHANNELS, LIST_MEMBERS};
+
+	std::string	input;
+	std::string	output;
+	Listing		listing;
+	std::string	channel;
+	int			nextId;
+	bool		closing;
+	bool		skipping;
+
+	AdminConsole() : listing(LIST_NONE), nextId(0), closing(false), skipping(false) {}
+};
+
+#endif
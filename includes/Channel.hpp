@@ -17,21 +17,43 @@
 # include "UtilityHeaders.hpp"
 # include "Client.hpp"
 # include "UtilitiyFunctions.hpp"
+# include "ChannelHistory.hpp"
+# include "ChannelRing.hpp"
+# include "TaggedLine.hpp"
+# include "Probes.hpp"
+# include "RateMeter.hpp"
+# include "HotClients.hpp"
 
 class Client; 
 
 class Channel {
     private:
+        // A member, its slot in the server's HotClients and, in pull
+        // fan-out, the seq of the next ring line it reads. Ordered by id.
+        struct Member {
+            int id;
+            size_t slot;
+            unsigned long next;
+        };
+
         std::string channelName;
         std::string topic;
         std::string createdAt;
         std::set<int> invitedUsers; 
         std::set<int> channelMembers;  // Client FDs (only store FDs to avoid nickname issues)
+        std::vector<Member> memberSlots; // The same members, walked by the broadcasts
         bool inviteOnly;               // +i mode
         bool topicRestricted;          // +t mode (only ops can change topic)
         std::string key;               // Channel password (+k mode)
         int userLimit;                 // -1 = no limit (+l mode)
         std::set<int> operators;       // Operator FDs (+o mode)
+        ChannelHistory history;        // Recent PRIVMSG/NOTICE for CHATHISTORY
+        RateMeter deliveries;          // Lines queued to members, for the admin socket
+        ChannelRing ring;              // Pull fan-out of a big channel (see ChannelRing.hpp)
+
+        size_t memberIndex(int id) const;
+        bool drainReader(HotClient* hot, Member& member, size_t limit, size_t& recipients, unsigned long& skipped);
+        void noticeGap(Client& member, unsigned long missed) const;
         
     public:
         // Constructors and destructor
@@ -39,6 +61,11 @@ class Channel {
         Channel(const std::string& name);
         Channel(const Channel& copy); // private
         Channel& operator=(const Channel& right); // private
+# if __cplusplus >= 201103L
+        // C++17 build: member sets and history are moved, not copied
+        Channel(Channel&& right) = default;
+        Channel& operator=(Channel&& right) = default;
+# endif
         ~Channel();
         
         // Member management
@@ -47,11 +74,13 @@ class Channel {
         bool hasMember(int clientFd) const;
         const std::set<int>& getMembers() const;
         size_t getMemberCount() const;
+        void replaceMember(int oldId, int newId);
         
         // Invitation management
         void inviteUser(int clientFd);
         bool isInvited(int clientFd) const;
         void removeInvite(int clientFd);
+        const std::set<int>& getInvitedUsers() const;
         
         // Operator management
         void addOperator(int clientFd);
@@ -61,20 +90,30 @@ class Channel {
         size_t getOperatorCount() const;
         
         // Broadcasting messages
-        void broadcast(const std::string& message);
-        void broadcast(const std::string& message, int excludeFd);
+        void broadcast(HotClients& clients, const std::string& message);
+        void broadcast(HotClients& clients, const std::string& message, int excludeFd);
+        void broadcast(HotClients& clients, const std::string& message, std::set<int>& delivered);
+        void broadcast(HotClients& clients, const std::string& message, std::set<int>& delivered, unsigned int capability);
+        void broadcast(HotClients& clients, TaggedLine& line, std::set<int>& delivered);
+        void broadcast(HotClients& clients, TaggedLine& line, int excludeFd);
+
+        // Pull fan-out
+        void startRing();
+        unsigned long stopRing(HotClients& clients);
+        unsigned long drainRing(HotClients& clients);
+        unsigned long catchUpMember(HotClients& clients, int id);
+        const ChannelRing& getRing() const;
         
         // Channel info and replies
-        std::string getNamesReply(const std::map<int, Client>& clientMap) const;
-        std::string getName() const;
-        std::string getTopic() const;
+        const std::string& getName() const;
+        const std::string& getTopic() const;
         std::string getCreationTime() const;
         
 
         // Mode Getters
         bool isInviteOnly() const;          // +i mode
         bool isTopicRestricted() const;     // +t mode
-        std::string getKey() const;         // +k mode
+        const std::string& getKey() const;         // +k mode
         int getUserLimit() const;           // +l mode
             
         // Mode Setters
@@ -83,6 +122,15 @@ class Channel {
         void setKey(const std::string& password);        // +k mode
         void setUserLimit(int limit);                    // +l mode
         void setTopic(const std::string& newTopic);      // Topic content 
+        void setCreationTime(const std::string& time);   // Restored after an upgrade
+
+        // Message history
+        ChannelHistory& getHistory();
+        const ChannelHistory& getHistory() const;
+        const RateMeter& getDeliveries() const;
+
+        // Heap bytes of the names, member sets and ring, history apart (see MemoryUsage.hpp)
+        size_t getMemoryUsage() const;
 };
 
 # endif
\ No newline at end of file
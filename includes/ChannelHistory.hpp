@@ -0,0 +1,78 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelHistory.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/18 10:12:05 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/18 10:12:05 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CHANNELHISTORY_HPP
+# define CHANNELHISTORY_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief The last PRIVMSG/NOTICE lines of a channel, for CHATHISTORY.
+ *
+ * Entries live in a ring of HISTORY_LENGTH slots, the lines themselves are
+ * packed back to back in one byte arena: the oldest line is always at the
+ * front, so dropping it only moves arenaStart, and the dead front is cut
+ * off once it is larger than the live part. Times and msgids only grow, the
+ * lookups are binary searches over the ring.
+ *
+ * Nothing is allocated before the first message, the global budget shared
+ * by all channels is enforced by the server (see Server::recordHistory()).
+ *
+ * @author Hamad
+ */
+class ChannelHistory {
+	public:
+		struct Entry {
+			unsigned long	time;    // Wall clock, ms since the epoch
+			unsigned long	msgid;
+			unsigned long	offset;  // In the arena, counted from arenaBase
+			unsigned int	length;
+		};
+
+	private:
+		std::vector<Entry>	slots;
+		size_t				head;
+		size_t				count;
+		std::vector<char>	arena;
+		size_t				arenaStart;  // First live byte in arena
+		unsigned long		arenaBase;   // Offset of arena[0]
+		size_t				liveBytes;
+
+		const Entry&	at(size_t index) const;
+
+	public:
+		ChannelHistory();
+		ChannelHistory(const ChannelHistory& right);
+		ChannelHistory& operator=(const ChannelHistory& right);
+# if __cplusplus >= 201103L
+		ChannelHistory(ChannelHistory&& right) = default;
+		ChannelHistory& operator=(ChannelHistory&& right) = default;
+# endif
+		~ChannelHistory();
+
+		void			append(unsigned long time, unsigned long msgid, const std::string& line);
+		void			dropOldest(void);
+		bool			isEmpty(void) const;
+		size_t			getCount(void) const;
+		size_t			getMemoryUsage(void) const;
+		size_t			getHeapUsage(void) const;
+		unsigned long	getOldestMsgid(void) const;
+
+		const Entry&	getEntry(size_t index) const;
+		std::string		getLine(size_t index) const;
+		size_t			lowerBoundTime(unsigned long time) const;
+		size_t			findMsgid(unsigned long msgid) const;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelLogger.hpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/19 09:31:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/19 09:31:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CHANNELLOGGER_HPP
+# define CHANNELLOGGER_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "UtilitiyFunctions.hpp"
+# include "Metrics.hpp"
+
+/**
+ * @brief Transcripts of the channels marked "log" in the config, written
+ * by a background thread so the event loop never waits on the disk.
+ *
+ * The event loop (the only producer) copies each line with its time into a
+ * lock free single producer / single consumer byte ring of LOG_QUEUE_BYTES:
+ *
+ *     [record length][channel length][time in ms][channel][line]
+ *
+ * tail is only written by the producer and head only by the writer, each
+ * published with a release store and read with an acquire load, so no lock
+ * is ever taken. When the ring is full the line is dropped (and counted)
+ * rather than blocking the loop.
+ *
+ * The writer wakes every LOG_FLUSH_MS, takes everything queued, and commits
+ * it as a group: one write() and one fdatasync() per channel touched. Each
+ * channel goes to <log_dir>/<channel>.<start ms>.log, a new segment is
+ * started once one reaches LOG_SEGMENT_BYTES.
+ *
+ * @author Hamad
+ */
+class ChannelLogger {
+	private:
+		struct Segment {
+			int		fd;
+			size_t	size;
+		};
+
+		std::string		directory;
+		std::vector<char>	ring;
+		unsigned long	head;      // Writer position, written by the writer only
+		unsigned long	tail;      // Producer position, written by the loop only
+		bool			running;
+		bool			started;
+		pthread_t		thread;
+		unsigned long	dropped;   // Loop only
+		MetricCell		linesWritten;  // Writer only, read by the metrics page
+		MetricCell		bytesWritten;
+		bool			dropping;  // Loop only
+
+		std::map<std::string, Segment>	segments;  // Writer only
+
+		ChannelLogger(const ChannelLogger& right);
+		ChannelLogger& operator=(const ChannelLogger& right);
+
+		static void	*run(void *self);
+		void		writerLoop(void);
+		size_t		commitQueued(void);
+		void		copyOut(unsigned long position, char *data, size_t length) const;
+		Segment&	segmentFor(const std::string& channel, size_t incoming);
+
+	public:
+		ChannelLogger();
+		~ChannelLogger();
+
+		void			open(const std::string& dir);
+		void			stop(void);
+		bool			isEnabled(void) const;
+		bool			append(const std::string& channel, const std::string& line);
+		unsigned long	getDropped(void) const;
+		unsigned long	getLinesWritten(void) const;
+		unsigned long	getBytesWritten(void) const;
+
+		static std::string	fileName(const std::string& channel);
+
+		class ChannelLoggerException: public std::exception{
+			private:
+				std::string message;
+			public:
+				ChannelLoggerException(const std::string& message);
+				~ChannelLoggerException() throw();
+				const char	*what() const throw();
+		};
+};
+
+#endif
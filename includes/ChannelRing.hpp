@@ -0,0 +1,97 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelRing.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/05 14:05:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2026/01/05 14:05:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CHANNELRING_HPP
+# define CHANNELRING_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "HotClients.hpp"
+# include "TaggedLine.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief Pull fan-out of a big channel: every line to the channel is
+ * appended once here instead of being queued to every member, and each
+ * member (reader) keeps the sequence number of the next line it reads
+ * (see Channel::Member). The server copies the lines to the members'
+ * output queues later, in batches, while their queues are short (see
+ * Channel::drainRing()).
+ *
+ * A line carries who does not get it: the readers in excluded (the
+ * sender, or those a multi-target message already reached through
+ * another channel) and, with a capability, the readers without it
+ * (away-notify). A line that is not tagged goes as it is to everybody.
+ *
+ * The ring keeps FANOUT_RING_LINES lines, a reader still behind the
+ * oldest one when a new line comes in has lost the difference: it skips
+ * to the oldest line kept and is told how many it missed (skipGap()).
+ * Once every reader caught up the lines are let go.
+ *
+ * A new line concerns every reader, the drain after it walks them all.
+ * Until the next one only the readers left behind by that walk (stalled,
+ * their queue was full) have something to read, the drains in between
+ * only walk them.
+ *
+ * @author Hamad
+ */
+class ChannelRing {
+	private:
+		struct Entry {
+			TaggedLine			line;
+			bool				tagged;      // false: line.getLine() for every reader
+			unsigned int		capability;  // CAP_* bit a reader needs, 0 for none
+			std::vector<int>	excluded;    // Readers it is not for, sorted
+
+			Entry(const TaggedLine& line, bool tagged, unsigned int capability);
+		};
+
+		std::deque<Entry>	entries;
+		unsigned long		firstSeq;   // Seq of entries.front()
+		bool				active;
+		size_t				readers;
+		size_t				lagging;    // Readers behind the last line
+		std::set<int>		stalled;    // Readers the last drain left behind
+		bool				appended;   // A line came in since the last drain
+
+	public:
+		ChannelRing();
+		ChannelRing(const ChannelRing& right);
+		ChannelRing& operator=(const ChannelRing& right);
+		~ChannelRing();
+
+		void			start(size_t readers);
+		void			stop(void);
+		bool			isActive(void) const;
+		bool			isCaughtUp(void) const;
+		unsigned long	getNextSeq(void) const;
+		size_t			getLength(void) const;
+		size_t			getLagging(void) const;
+		size_t			getMemoryUsage(void) const;
+
+		void			append(const TaggedLine& line, bool tagged, int excludeId);
+		void			append(const TaggedLine& line, bool tagged, unsigned int capability, const std::vector<int>& excluded);
+		void			addReader(void);
+		void			removeReader(int id, unsigned long next);
+		void			replaceReader(int oldId, int newId, unsigned long next);
+		std::set<int>&	getStalled(void);
+		bool			hasNewLines(void) const;
+		void			markDrained(void);
+
+		unsigned long	skipGap(unsigned long& next);
+		unsigned long	read(unsigned long& next, int reader, HotClient& client, size_t limit);
+		unsigned long	skipAll(unsigned long& next);
+		void			catchUp(unsigned long& next);
+		void			trim(void);
+};
+
+#endif
@@ -0,0 +1,98 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelStore.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/14 11:25:37 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/14 11:25:37 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CHANNELSTORE_HPP
+# define CHANNELSTORE_HPP
+
+# include <set>
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "Channel.hpp"
+# include "StateStream.hpp"
+
+/**
+ * @brief Keeps channel metadata (topic, +i +t +k +l, creation time) across
+ * restarts, in the state_dir of the config file.
+ *
+ * channels.snapshot holds every channel as of the last compaction,
+ * channels.journal the channels changed since, one record per change.
+ * Changes are only marked during the loop iteration and encoded together
+ * by commit() at its end (group commit). The disk work runs on a writer
+ * thread, like ChannelLogger: the loop queues the encoded records (or a
+ * whole snapshot once the journal is large) and goes on, the writer takes
+ * everything queued and costs one write and one fdatasync per round,
+ * however many MODE/TOPIC came in. At startup both files are mmap'd and
+ * replayed, then folded into a fresh snapshot.
+ *
+ * Record: name, topic, createdAt, inviteOnly, topicRestricted, key, limit
+ * (StateWriter encoding). The journal frames every record with its length,
+ * so a record cut by a crash is detected and dropped.
+ *
+ * @author Hamad
+ */
+class ChannelStore {
+	private:
+		struct Job {
+			bool		snapshot;  // data is a whole snapshot, else journal records
+			std::string	data;
+		};
+
+		std::string				directory;
+		int						journalFd;
+		size_t					journalSize;    // Loop only, bytes queued since the last snapshot
+		std::set<std::string>	dirtyChannels;  // Loop only
+
+		// Shared with the writer, under lock
+		pthread_mutex_t			lock;
+		pthread_cond_t			wakeup;     // Jobs queued or stop()
+		pthread_cond_t			idle;       // The writer finished a round
+		std::vector<Job>		jobs;
+		bool					busy;
+		bool					running;
+		bool					started;
+		pthread_t				thread;
+
+		ChannelStore(const ChannelStore& right);
+		ChannelStore& operator=(const ChannelStore& right);
+
+		std::string	filePath(const std::string& name) const;
+		size_t		replayJournal(std::map<std::string, Channel>& channels);
+		void		enqueue(bool snapshot, const std::string& data);
+		static void	*run(void *self);
+		void		writerLoop(void);
+		void		writeJobs(const std::vector<Job>& batch);
+		bool		writeSnapshot(const std::string& data);
+
+	public:
+		ChannelStore();
+		~ChannelStore();
+
+		void	open(const std::string& stateDirectory);
+		bool	isEnabled(void) const;
+		size_t	load(std::map<std::string, Channel>& channels);
+		void	markDirty(const std::string& channelName);
+		void	commit(const std::map<std::string, Channel>& channels);
+		void	compact(const std::map<std::string, Channel>& channels);
+		void	sync(void);
+		void	stop(void);
+
+		class ChannelStoreException: public std::exception{
+			private:
+				std::string message;
+			public:
+				ChannelStoreException(const std::string& message);
+				~ChannelStoreException() throw();
+				const char	*what() const throw();
+		};
+};
+
+#endif
@@ -13,30 +13,102 @@
 #ifndef CLIENT_HPP
 # define CLIENT_HPP
 # include "UtilityHeaders.hpp"
+# include "SocketHeaders.hpp"
+# include "RateMeter.hpp"
+# include "MemoryUsage.hpp"
 
 class Client{
+	public:
+		/*
+			A connection is either a user (LINK_NONE) or a server link: one we
+			opened and introduced ourselves on (LINK_CONNECTING) until the peer
+			answers with SERVER, then LINK_ESTABLISHED.
+		*/
+		enum LinkState {LINK_NONE, LINK_CONNECTING, LINK_ESTABLISHED};
+
 	private:
+		/*
+			Hot part: what a channel broadcast reads for every member, kept
+			at the start of the object so a recipient costs a cache line or
+			two and not one per field. Everything after is only read by the
+			commands of the client itself.
+
+			link is the fd of the server link a remote user is reached
+			through, -1 for local users. capabilities are the IRCv3 CAP_*
+			bits. prefix is "nick!user", the source of the user's messages,
+			kept with the two. outputQueue holds the bytes waiting to be
+			written to the socket, flushed when it becomes writable. The
+			C++17 build checks that they all start in the first cache line.
+		*/
+		int link;
+		unsigned int capabilities;
+		std::string prefix;
+		std::string outputQueue;
+
+		/*
+			State flags, one bit each. Registration waits for CAP END while
+			capNegotiating is set. pingSent is set while a keepalive PING is
+			unanswered, serverOperator by OPER (e.g. for SEARCH).
+		*/
+		bool passwordAuthenticated : 1;
+		bool nicknameSet : 1;
+		bool userSet : 1;
+		bool capNegotiating : 1;
+		bool pingSent : 1;
+		bool serverOperator : 1;
+
 		std::string username;
 		std::string nickname;
 		std::string realname;
 		std::string hostname;
-		
-		// Authentication state flags
-		bool passwordAuthenticated;
-		bool nicknameSet;
-		bool userSet;
+
+		//Peer IPv4 address (host byte order) and the connection class it was put in.
+		in_addr_t address;
+		size_t connectionClass;
+
+		//Flood control bucket, in thousandths of a command.
+		long floodTokens;
+		unsigned long lastFloodRefill;
+
+		std::string awayMessage;
+		//RESUME token of the user's session, empty without one.
+		std::string sessionToken;
+
+		//Keepalive: when the peer last sent something.
+		unsigned long lastActivity;
+
+		//Lines read from and written to the connection, for the admin socket.
+		RateMeter linesIn;
+		RateMeter linesOut;
+
+		/*
+			Server linking. Users on other servers are kept in the client map
+			too (see link). serverName is the server a user is on, or the
+			peer's name for a link connection.
+		*/
+		LinkState linkState;
+		std::string serverName;
+		std::string linkPassword;
+		//When the nickname was taken, the oldest one wins a collision.
+		unsigned long nicknameTs;
 
 	public:
 		Client();
 		Client(const Client& right);
 		Client& operator=(const Client& right);
+# if __cplusplus >= 201103L
+		// C++17 build: a client changing id (detach, resume) takes its strings along
+		Client(Client&& right) = default;
+		Client& operator=(Client&& right) = default;
+# endif
 		~Client();
 
 		// Getters
-		std::string	getNickname(void) const;
-		std::string	getUsername(void) const;
-		std::string getRealname(void) const;
-		std::string getHostname(void) const;
+		const std::string&	getNickname(void) const;
+		const std::string&	getUsername(void) const;
+		const std::string&	getRealname(void) const;
+		const std::string&	getHostname(void) const;
+		const std::string&	getPrefix(void) const;
 
 		// Setters
 		void	setNickname(const std::string &nNickname);
@@ -54,5 +126,64 @@ class Client{
 		bool	isUserSet(void) const;
 		bool	isFullyRegistered(void) const;
 
+		// Connection class and flood control
+		in_addr_t	getAddress(void) const;
+		void		setAddress(in_addr_t nAddress);
+		size_t		getConnectionClass(void) const;
+		void		setConnectionClass(size_t nConnectionClass);
+		bool		takeFloodTokens(unsigned long nowMs, unsigned int rate, unsigned int burst, unsigned int cost);
+
+		// Output queue
+		void				queueOutput(const std::string &message);
+		const std::string&	getOutput(void) const;
+		void				consumeOutput(size_t bytes);
+		size_t				getOutputSize(void) const;
+		bool				hasPendingOutput(void) const;
+
+		// Capabilities, away and session
+		unsigned int		getCapabilities(void) const;
+		void				setCapabilities(unsigned int nCapabilities);
+		bool				hasCapability(unsigned int capability) const;
+		bool				isCapNegotiating(void) const;
+		void				setCapNegotiating(bool negotiating);
+		const std::string&	getAwayMessage(void) const;
+		void				setAwayMessage(const std::string &nAwayMessage);
+		bool				isAway(void) const;
+		const std::string&	getSessionToken(void) const;
+		void				setSessionToken(const std::string &nSessionToken);
+
+		// Keepalive
+		void				markActive(unsigned long nowMs);
+		unsigned long		getLastActivity(void) const;
+		bool				isPingSent(void) const;
+		void				setPingSent(bool sent);
+
+		// Traffic
+		void				countLinesIn(unsigned long lines, unsigned long nowMs);
+		void				countLinesOut(unsigned long lines, unsigned long nowMs);
+		const RateMeter&	getLinesIn(void) const;
+		const RateMeter&	getLinesOut(void) const;
+
+		// Server links
+		LinkState			getLinkState(void) const;
+		void				setLinkState(LinkState nLinkState);
+		bool				isServer(void) const;
+		int					getLink(void) const;
+		void				setLink(int nLink);
+		bool				isRemote(void) const;
+		const std::string&	getServerName(void) const;
+		void				setServerName(const std::string &nServerName);
+		const std::string&	getLinkPassword(void) const;
+		void				setLinkPassword(const std::string &nLinkPassword);
+		unsigned long		getNicknameTs(void) const;
+		void				setNicknameTs(unsigned long nNicknameTs);
+
+		// Server operator
+		bool				isServerOperator(void) const;
+		void				setServerOperator(bool nServerOperator);
+
+		// Heap bytes of the strings, the output queue apart (see MemoryUsage.hpp)
+		size_t				getMemoryUsage(void) const;
+
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,133 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/09 20:03:11 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/09 20:03:11 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CONFIG_HPP
+# define CONFIG_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "ConnectionClass.hpp"
+# include "LinkBlock.hpp"
+
+/**
+ * @brief Runtime settings of the server, read from the optional config file
+ * given as third argument. Without a file every value is the compile time
+ * default from Constants.hpp.
+ *
+ * The file has one directive per line, lines starting with '#' are comments:
+ *
+ *     listen        127.0.0.1
+ *     max_clients   64
+ *     buffer_size   4096
+ *     poll_timeout  250
+ *     session_grace 120
+ *     state_dir     ./state
+ *     log_dir       ./logs
+ *     server_name   irc1.hai.local
+ *     link          <server name> <ip> <port> <password> [autoconnect]
+ *     oper          <name> <password>
+ *     metrics       <address> <port>
+ *     admin_socket  ./ircserv.sock
+ *     capture       ./traffic.cap
+ *     memory_budget 268435456
+ *     fanout_ring   1000
+ *     channel       #general [log]
+ *     class         <name> <cidr> [password=..] [recvq=..] [sendq=..]
+ *                   [burst=..] [rate=..] [max_clients=..] [exempt=yes|no]
+ *
+ * Classes are matched in file order. When no class line is present the
+ * built in "default" class is used, and without channel lines the default
+ * channels are created. Channel topics and modes are only kept across
+ * restarts when state_dir is set (see ChannelStore.hpp), channels marked
+ * "log" are written to log_dir (see ChannelLogger.hpp). Servers linked
+ * together need distinct server names, with a dot so they can't be taken
+ * for a nickname. An oper line lets a user become a server operator with
+ * OPER <name> <password>. session_grace is how many seconds the user of a
+ * dropped connection may be resumed for (see ServerSession.cpp), 0 (the
+ * default) disables it. A metrics line serves the metrics page on its own
+ * port (see ServerMetrics.cpp), admin_socket opens the admin console at
+ * that path (see ServerAdmin.cpp). capture records the client traffic to
+ * that file from startup (see TrafficCapture.hpp). memory_budget is how
+ * many bytes the server may hold before it sheds load (see
+ * ServerMemory.cpp), 0 (the default) for no limit. Channels with at least
+ * fanout_ring members use pull fan-out (see ServerFanout.cpp), 0 for never.
+ *
+ * @author Hamad
+ */
+class Config {
+	private:
+		std::string						path;
+		std::string						listenAddress;
+		unsigned int					maxClients;
+		size_t							bufferSize;
+		int								pollTimeout;
+		std::string						stateDir;
+		std::vector<std::string>		channels;
+		std::string						logDir;
+		std::set<std::string>			loggedChannels;
+		std::vector<ConnectionClass>	classes;
+		std::string						serverName;
+		std::vector<LinkBlock>			links;
+		std::map<std::string, std::string>	operators;
+		unsigned long					sessionGrace;
+		std::string						metricsAddress;
+		int								metricsPort;      // 0 without a metrics line
+		std::string						adminSocket;
+		std::string						capture;
+		size_t							memoryBudget;
+		size_t							fanoutRing;
+
+		void	parseLine(const std::vector<std::string>& words, size_t lineNumber);
+		void	parseClass(const std::vector<std::string>& words, size_t lineNumber);
+		void	parseLink(const std::vector<std::string>& words, size_t lineNumber);
+
+	public:
+		Config();
+		Config(const Config& right);
+		Config& operator=(const Config& right);
+		~Config();
+
+		void	load(const std::string& filePath);
+
+		// Getters
+		const std::string&					getPath(void) const;
+		const std::string&					getListenAddress(void) const;
+		unsigned int						getMaxClients(void) const;
+		size_t								getBufferSize(void) const;
+		int									getPollTimeout(void) const;
+		const std::string&					getStateDir(void) const;
+		const std::vector<std::string>&		getChannels(void) const;
+		const std::string&					getLogDir(void) const;
+		const std::set<std::string>&		getLoggedChannels(void) const;
+		const std::vector<ConnectionClass>&	getClasses(void) const;
+		const std::string&					getServerName(void) const;
+		const std::vector<LinkBlock>&		getLinks(void) const;
+		const std::map<std::string, std::string>&	getOperators(void) const;
+		unsigned long						getSessionGrace(void) const;
+		const std::string&					getMetricsAddress(void) const;
+		int									getMetricsPort(void) const;
+		const std::string&					getAdminSocket(void) const;
+		const std::string&					getCapture(void) const;
+		size_t								getMemoryBudget(void) const;
+		size_t								getFanoutRing(void) const;
+
+		class InvalidConfigException: public std::exception{
+			private:
+				std::string message;
+			public:
+				InvalidConfigException(const std::string& message);
+				~InvalidConfigException() throw();
+				const char	*what() const throw();
+		};
+};
+
+#endif
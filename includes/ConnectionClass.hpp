@@ -0,0 +1,78 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionClass.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/07 16:21:40 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/07 16:21:40 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CONNECTIONCLASS_HPP
+# define CONNECTIONCLASS_HPP
+
+# include "UtilityHeaders.hpp"
+# include "SocketHeaders.hpp"
+# include "Constants.hpp"
+
+/**
+ * @brief Limits shared by a group of connections, picked by source address
+ * (CIDR) and optionally by the password given with PASS.
+ *
+ * @var recvQ       Max bytes of unprocessed input before "Excess Flood".
+ * @var sendQ       Max bytes of unsent output before "SendQ exceeded".
+ * @var floodBurst  Commands a client may send back to back (bucket size).
+ * @var floodRate   Commands regained per second (bucket refill).
+ * @var maxClients  Connections allowed in the class at the same time, 0 for
+ *                  no limit other than the server's.
+ * @var exempt      Trusted connections (bots) that are never throttled.
+ *
+ * @author Hamad
+ */
+class ConnectionClass {
+	private:
+		std::string		name;
+		in_addr_t		network;     // Host byte order
+		in_addr_t		netmask;     // Host byte order
+		std::string		password;    // Empty = any password the server accepts
+		size_t			recvQ;
+		size_t			sendQ;
+		unsigned int	floodBurst;
+		unsigned int	floodRate;
+		unsigned int	maxClients;
+		bool			exempt;
+
+	public:
+		ConnectionClass();
+		ConnectionClass(const std::string& name);
+		ConnectionClass(const ConnectionClass& right);
+		ConnectionClass& operator=(const ConnectionClass& right);
+		~ConnectionClass();
+
+		// Getters
+		const std::string&	getName(void) const;
+		const std::string&	getPassword(void) const;
+		size_t				getRecvQ(void) const;
+		size_t				getSendQ(void) const;
+		unsigned int		getFloodBurst(void) const;
+		unsigned int		getFloodRate(void) const;
+		unsigned int		getMaxClients(void) const;
+		bool				isExempt(void) const;
+
+		// Setters
+		bool	setCidr(const std::string& cidr);
+		void	setPassword(const std::string& nPassword);
+		void	setRecvQ(size_t nRecvQ);
+		void	setSendQ(size_t nSendQ);
+		void	setFloodBurst(unsigned int nFloodBurst);
+		void	setFloodRate(unsigned int nFloodRate);
+		void	setMaxClients(unsigned int nMaxClients);
+		void	setExempt(bool nExempt);
+
+		bool	matchesAddress(in_addr_t address) const;
+		bool	matches(in_addr_t address, const std::string& pass) const;
+};
+
+#endif
@@ -26,9 +26,259 @@
 	const int MAX_PORTS = 65535;
 	const int BUFFER_SIZE = 1024;
 
+	/**
+		Output queue tuning. Large replies (WHO, NAMES, LIST) are generated
+		by a cursor only while the client's queue is below the low watermark,
+		and at most CURSOR_LINES_PER_TURN lines per client per loop iteration.
+
+		@author Hamad
+	*/
+	const size_t SENDQ_LOW_WATERMARK = 8192;
+	const unsigned int CURSOR_LINES_PER_TURN = 64;
+	const size_t NAMES_LINE_LENGTH = 400;
+
+	/**
+		Defaults of the connection class every client falls in when no
+		other class matches. The flood bucket allows DEFAULT_FLOOD_BURST
+		commands back to back and gives back DEFAULT_FLOOD_RATE per second,
+		a command costs one token plus one per FLOOD_PENALTY_BYTES of line
+		(penalty accounting as described in RFC 1459 8.10).
+
+		@author Hamad
+	*/
+	const std::string DEFAULT_CLASS_NAME("default");
+	const std::string DEFAULT_CLASS_CIDR("0.0.0.0/0");
+	const size_t DEFAULT_RECVQ = 8192;
+	const size_t DEFAULT_SENDQ = 262144;
+	const unsigned int DEFAULT_FLOOD_BURST = 10;
+	const unsigned int DEFAULT_FLOOD_RATE = 2;
+	const size_t FLOOD_PENALTY_BYTES = 120;
+	//poll() timeout used while a throttled client still has commands waiting.
+	const int FLOOD_POLL_TIMEOUT = 50;
+
+	//Commands run for one client before the scheduler moves to the next one.
+	const unsigned int COMMANDS_PER_TURN = 4;
+
+	//Maximum number of comma separated targets of one PRIVMSG/NOTICE (TARGMAX).
+	const unsigned int MAX_MESSAGE_TARGETS = 8;
+
+	/**
+		Binary upgrade (SIGUSR2). The running server re-executes itself and
+		hands its sockets and state to the new process over a Unix socket
+		whose fd is passed in UPGRADE_ENV. File descriptors go in batches
+		below the kernel's per message limit (SCM_MAX_FD, 253).
+
+		@author Hamad
+	*/
+	const std::string UPGRADE_ENV("HAI_UPGRADE_FD");
+	const std::string UPGRADE_MAGIC("HAI-UPGRADE-6");
+	const int UPGRADE_TIMEOUT = 5;
+	const size_t UPGRADE_FDS_PER_MESSAGE = 200;
+
+	/**
+		Channel metadata persistence (state_dir in the config file). The
+		journal is folded into the snapshot once it grows past
+		JOURNAL_COMPACT_BYTES.
+
+		@author Hamad
+	*/
+	const std::string CHANNEL_SNAPSHOT_FILE("channels.snapshot");
+	const std::string CHANNEL_JOURNAL_FILE("channels.journal");
+	const std::string CHANNEL_SNAPSHOT_MAGIC("HAI-CHANNELS-1");
+	const size_t JOURNAL_COMPACT_BYTES = 1048576;
+
+	/**
+		Server links. Users on other servers get ids from REMOTE_ID_BASE up
+		in the client map, far above any fd. Links run more commands per
+		turn than users (a burst is thousands of lines) and are never
+		throttled, LINK_SENDQ bounds what may wait for a slow peer.
+
+		@author Hamad
+	*/
+	const std::string DEFAULT_SERVER_NAME("irc.hai.local");
+	const int REMOTE_ID_BASE = 1000000000;
+	const unsigned int LINK_COMMANDS_PER_TURN = 256;
+	const size_t LINK_SENDQ = 16777216;
+	const unsigned long LINK_RETRY_MS = 10000;
+	const std::string LINK_PROTOCOL_VERSION("0210");
+
+	/**
+		Channel history (CHATHISTORY). Every channel keeps its last
+		HISTORY_LENGTH messages, all channels together at most HISTORY_BUDGET
+		bytes: past it the oldest message of the whole server goes first, so
+		quiet channels give their room to busy ones. A request returns at
+		most CHATHISTORY_LIMIT messages.
+
+		@author Hamad
+	*/
+	const size_t HISTORY_LENGTH = 1024;
+	const size_t HISTORY_BUDGET = 16777216;
+	const size_t CHATHISTORY_LIMIT = 100;
+
+	/**
+		Channel logs (log_dir in the config file). The event loop hands the
+		lines to the writer thread through a LOG_QUEUE_BYTES ring (a power
+		of two), the writer commits what it finds every LOG_FLUSH_MS and
+		starts a new segment file once one reaches LOG_SEGMENT_BYTES.
+
+		@author Hamad
+	*/
+	const size_t LOG_QUEUE_BYTES = 8388608;
+	const unsigned int LOG_FLUSH_MS = 20;
+	const size_t LOG_SEGMENT_BYTES = 67108864;
+
+	/**
+		Search of the channel logs (SEARCH). A background thread brings the
+		index of every segment up to date each INDEX_INTERVAL_MS. The index
+		file of a segment still being written is replaced once it lags
+		INDEX_TAIL_BYTES behind (or the channel goes quiet), searches scan
+		that lag directly. Words are cut at INDEX_WORD_LENGTH characters and
+		a search returns at most SEARCH_LIMIT lines. Searches run on that
+		thread too, the loop polls every SEARCH_POLL_TIMEOUT while one is
+		out to hand the result over.
+
+		@author Hamad
+	*/
+	const unsigned int INDEX_INTERVAL_MS = 2000;
+	const size_t INDEX_TAIL_BYTES = 4194304;
+	const size_t INDEX_WORD_LENGTH = 32;
+	const size_t SEARCH_LIMIT = 50;
+	const int SEARCH_POLL_TIMEOUT = 20;
+
 	//The CLDR is used to tell the client that this is the end of the message.
 	const std::string CLDR("\r\n");
 
+	/**
+		Keepalive. The pollfd slots are spread over KEEPALIVE_SLOTS buckets
+		of a timing wheel turning once per PING_INTERVAL_MS, so a connection
+		silent for a whole interval gets a PING and is dropped if it is still
+		silent one turn later. PING_LINE and PONG_PREFIX are built once, a
+		PONG only appends the token.
+
+		@author Hamad
+	*/
+	const unsigned long PING_INTERVAL_MS = 90000;
+	const unsigned int KEEPALIVE_SLOTS = 64;
+	const std::string PING_LINE("PING :" + SERVER_NAME + CLDR);
+	const std::string PONG_PREFIX(":" + SERVER_NAME + " PONG " + SERVER_NAME + " :");
+	const std::string MSG_PING_TIMEOUT("Ping timeout");
+
+	/**
+		Session resumption (session_grace in the config file, disabled at
+		0). A client with the resume capability gets a random token of
+		SESSION_TOKEN_BYTES once registered. When its connection drops the
+		user stays on the network for the grace period under an id from
+		DETACHED_ID_BASE up, above the remote users, and RESUME <token>
+		on a new connection takes it back.
+
+		@author Hamad
+	*/
+	const unsigned long DEFAULT_SESSION_GRACE = 0;
+	const int DETACHED_ID_BASE = 2000000000;
+	const size_t SESSION_TOKEN_BYTES = 16;
+	const std::string MSG_SESSION_EXPIRED("Session expired");
+
+	/**
+		Metrics page (metrics <address> <port> in the config file),
+		OpenMetrics text over HTTP/1.0. The listener and up to
+		METRICS_CONNECTIONS scrapers sit in METRICS_SLOTS pollfds after the
+		client slots. A scraper has METRICS_TIMEOUT_MS for its request and
+		response. The latency of the commands of METRIC_COMMANDS is kept
+		per command, the others share one histogram so a client can't make
+		up new series. Bounds are in microseconds (bytes for the sendq).
+
+		@author Hamad
+	*/
+	const size_t CACHE_LINE_BYTES = 64;
+	const unsigned int METRICS_CONNECTIONS = 4;
+	const size_t METRICS_SLOTS = METRICS_CONNECTIONS + 1;
+	const unsigned long METRICS_TIMEOUT_MS = 5000;
+	const size_t METRICS_REQUEST_BYTES = 8192;
+	const std::string METRICS_PATH("/metrics");
+	const std::string METRICS_CONTENT_TYPE("application/openmetrics-text; version=1.0.0; charset=utf-8");
+	const std::string METRIC_COMMANDS[] = {
+		"PASS", "NICK", "USER", "CAP", "PING", "PONG", "JOIN", "PART", "PRIVMSG",
+		"NOTICE", "TAGMSG", "MODE", "TOPIC", "KICK", "INVITE", "WHO", "NAMES",
+		"LIST", "AWAY", "QUIT", "CHATHISTORY", "OPER", "SEARCH", "RESUME"
+	};
+	const size_t NUM_METRIC_COMMANDS = sizeof(METRIC_COMMANDS) / sizeof(METRIC_COMMANDS[0]);
+	const unsigned long LATENCY_BUCKETS[] = {
+		10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+	};
+	const unsigned long MEMBER_BUCKETS[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+	const unsigned long SENDQ_BUCKETS[] = {0, 512, 4096, 16384, 65536, 262144, 1048576, 4194304};
+	const size_t NUM_LATENCY_BUCKETS = sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]);
+	const size_t NUM_MEMBER_BUCKETS = sizeof(MEMBER_BUCKETS) / sizeof(MEMBER_BUCKETS[0]);
+	const size_t NUM_SENDQ_BUCKETS = sizeof(SENDQ_BUCKETS) / sizeof(SENDQ_BUCKETS[0]);
+
+	/**
+		Admin socket (admin_socket <path> in the config file), a Unix socket
+		with a line protocol for whoever runs the server. The listener and up
+		to ADMIN_CONNECTIONS consoles sit in ADMIN_SLOTS pollfds after the
+		metrics ones. Every loop iteration a console gets ADMIN_TURNS turns,
+		one command or ADMIN_ROWS_PER_TURN rows of a table each, and none
+		while more than ADMIN_OUTPUT_HIGH bytes wait for it. Rates are shown
+		in lines per second over RATE_WINDOW_MS.
+
+		@author Hamad
+	*/
+	const unsigned int ADMIN_CONNECTIONS = 2;
+	const size_t ADMIN_SLOTS = ADMIN_CONNECTIONS + 1;
+	const size_t SERVICE_SLOTS = METRICS_SLOTS + ADMIN_SLOTS;
+	const unsigned int ADMIN_TURNS = 4;
+	const unsigned int ADMIN_ROWS_PER_TURN = 64;
+	const size_t ADMIN_OUTPUT_HIGH = 65536;
+	const size_t ADMIN_LINE_BYTES = 1024;
+	const unsigned long RATE_WINDOW_MS = 10000;
+
+	/**
+		Traffic capture (see TrafficCapture.hpp). Records are buffered and
+		written once CAPTURE_FLUSH_BYTES are waiting, or CAPTURE_FLUSH_MS
+		after the last write.
+
+		@author Hamad
+	*/
+	const std::string CAPTURE_MAGIC("HAI-CAPTURE-1");
+	const size_t CAPTURE_FLUSH_BYTES = 65536;
+	const unsigned long CAPTURE_FLUSH_MS = 1000;
+
+	/**
+		Memory budget (memory_budget in the config file, see
+		ServerMemory.cpp). The server measures itself every MEMORY_CHECK_MS,
+		past the budget it sheds load: history goes first, then new
+		connections are refused, then the clients with more than
+		MEMORY_SHED_SENDQ bytes waiting are dropped, largest first.
+
+		@author Hamad
+	*/
+	const unsigned long MEMORY_CHECK_MS = 1000;
+	const size_t MEMORY_SHED_SENDQ = 65536;
+
+	/**
+		Scratch strings of the loop (see ScratchArena.hpp). reset() keeps
+		SCRATCH_STRINGS of them, each up to SCRATCH_STRING_BYTES of
+		capacity, the rest is given back.
+
+		@author Hamad
+	*/
+	const size_t SCRATCH_STRINGS = 256;
+	const size_t SCRATCH_STRING_BYTES = 4096;
+
+	/**
+		Pull fan-out (see ChannelRing.hpp). Channels with at least
+		DEFAULT_FANOUT_RING members (fanout_ring in the config file, 0 to
+		never use it) queue their messages once in a ring of
+		FANOUT_RING_LINES lines, about what a default sendq holds, and go
+		back to push below half of it. A member whose queue is under
+		SENDQ_LOW_WATERMARK gets up to FANOUT_BATCH_BYTES of the ring per
+		loop iteration.
+
+		@author Hamad
+	*/
+	const size_t DEFAULT_FANOUT_RING = 1000;
+	const size_t FANOUT_RING_LINES = 8192;
+	const size_t FANOUT_BATCH_BYTES = 131072;
+
 	/**
 		This is going to be using in the send() function since
 		the socket is already non blocking we dont want to send
@@ -51,6 +301,11 @@
 	const std::string MSG_INVALID_PASSWORD("Password is invalid");
 	const std::string MSG_SOMETHING_WENT_WRONG("Something went wrong!");
 	const std::string MSG_NICKNAME_TAKEN("Nickname is already in use");
+	const std::string MSG_EXCESS_FLOOD("Excess Flood");
+	const std::string MSG_SENDQ_EXCEEDED("SendQ exceeded");
+	const std::string MSG_MEMORY_BUDGET("Server memory budget exceeded");
+	const std::string MSG_FANOUT_GAP("messages skipped, your connection is too slow to keep up");
+	const std::string MSG_CLASS_FULL("Too many connections in your class");
 	//Client Roles
 	const std::string CLIENT_ROLE_REGULAR("Regular");
 	const std::string CLIENT_ROLE_OPERATOR("Operator");
@@ -67,6 +322,11 @@
 	const std::string SOCKET_NONBLOCKING_FAIL("The server failed to make the socket non blocking");
 	const std::string SOCKET_OPTIONS_FAIL("The server failed to setup options for its socket");
 	
+	const std::string UPGRADE_FAIL("The server failed to take over from the previous process");
+	const std::string STATE_CORRUPT("The saved server state is corrupt");
+	const std::string METRICS_FAIL("The server failed to open the metrics port");
+	const std::string ADMIN_FAIL("The server failed to open the admin socket");
+
 	const std::string POLLFD_INIT_FAIL("The server failed to allocate memorey for pollfd.");
 
 	//Weechat constants
@@ -82,12 +342,57 @@
 	const std::string WEECHAT_PONG("PONG");
 	const std::string WEECHAT_JOIN("JOIN");
 	const std::string WEECHAT_PRIVMSG("PRIVMSG");
+	const std::string WEECHAT_NOTICE("NOTICE");
 	const std::string WEECHAT_CHANNEL_PREFIX("&#!+"); //According to the protocol manual
 	const std::string WEECHAT_TOPIC("TOPIC");
 	const std::string WEECHAT_KICK("KICK");
 	const std::string WEECHAT_PART("PART");
 	const std::string WEECHAT_MODE("MODE");
 	const std::string WEECHAT_INVITE("INVITE");
+	const std::string WEECHAT_ERROR("ERROR");
+	const std::string WEECHAT_SERVER("SERVER");
+	const std::string WEECHAT_NJOIN("NJOIN");
+	const std::string WEECHAT_SQUIT("SQUIT");
+	const std::string WEECHAT_KILL("KILL");
+	const std::string WEECHAT_CHATHISTORY("CHATHISTORY");
+	const std::string WEECHAT_BATCH("BATCH");
+	const std::string WEECHAT_FAIL("FAIL");
+	const std::string WEECHAT_OPER("OPER");
+	const std::string WEECHAT_SEARCH("SEARCH");
+	const std::string WEECHAT_MEMSTATS("MEMSTATS");
+	const std::string WEECHAT_CAP("CAP");
+	const std::string WEECHAT_AWAY("AWAY");
+	const std::string WEECHAT_TAGMSG("TAGMSG");
+	const std::string WEECHAT_RESUME("RESUME");
+
+	/**
+		IRCv3 capabilities a client enables with CAP REQ, kept as a bitset
+		on the Client. CAPABILITY_NAMES[i] is the name of bit 1 << i. Only
+		message-tags and server-time change the tags of a line, so a tagged
+		line has TAG_VARIANTS renderings at most. '@' is the only membership
+		prefix, multi-prefix doesn't change NAMES and WHO. The resume
+		capability is only offered when session_grace is set.
+
+		@author Hamad
+	*/
+	enum CAPABILITY {
+		CAP_MESSAGE_TAGS = 1 << 0,
+		CAP_SERVER_TIME = 1 << 1,
+		CAP_MULTI_PREFIX = 1 << 2,
+		CAP_AWAY_NOTIFY = 1 << 3,
+		CAP_ECHO_MESSAGE = 1 << 4,
+		CAP_RESUME = 1 << 5
+	};
+	const std::string CAPABILITY_NAMES[] = {
+		"message-tags",
+		"server-time",
+		"multi-prefix",
+		"away-notify",
+		"echo-message",
+		"draft/resume-0.5"
+	};
+	const unsigned int NUM_CAPABILITIES = 6;
+	const size_t TAG_VARIANTS = 4;
 
 	enum WEECHAT_HANDSHAKE {
 		PASSWORD = 1 << 0,
@@ -119,16 +424,27 @@
 	const std::string RPL_YOURHOST("002");
 	const std::string RPL_CREATED("003");
 	const std::string RPL_MYINFO("004");
+	const std::string RPL_ISUPPORT("005");
+	const std::string RPL_AWAY("301");
+	const std::string RPL_UNAWAY("305");
+	const std::string RPL_NOWAWAY("306");
+	const std::string RPL_ENDOFWHO("315");
 	const std::string RPL_LIST("322");
 	const std::string RPL_LISTEND("323");
 	const std::string RPL_NOTOPIC("331");
 	const std::string RPL_TOPIC("332");
 	const std::string RPL_TOPICSET("333");
 	const std::string RPL_INVITE("341");
+	const std::string RPL_WHOREPLY("352");
+	const std::string RPL_NAMREPLY("353");
+	const std::string RPL_ENDOFNAMES("366");
+	const std::string RPL_YOUREOPER("381");
 
 	// Missing/invalid service
+	const std::string ERR_TOOMANYTARGETS("407");
 	const std::string ERR_NOSUCHSERVICE("408");
 	const std::string ERR_NOORIGIN("409");
+	const std::string ERR_INVALIDCAPCMD("410");
 
 	// Nickname issues
 	const std::string ERR_NICKNAMEINUSE("433");
@@ -141,6 +457,8 @@
 	const std::string ERR_NOSUCHCHANNEL("403");
 	const std::string ERR_CANNOTSENDTOCHAN("404");
 	const std::string ERR_TOOMANYCHANNELS("405");
+	const std::string ERR_NORECIPIENT("411");
+	const std::string ERR_NOTEXTTOSEND("412");
 	const std::string ERR_UNKNOWNCOMMAND("421");
 	const std::string ERR_NONICKNAMEGIVEN("431");
 	const std::string ERR_ERRONEUSNICKNAME("432");
@@ -154,7 +472,9 @@
 	const std::string ERR_INVITEONLYCHAN("473");
 	const std::string ERR_BADCHANNELKEY("475");
 	const std::string ERR_BADCHANMASK("476");
+	const std::string ERR_NOPRIVILEGES("481");
 	const std::string ERR_CHANOPRIVSNEEDED("482");
+	const std::string ERR_NOOPERHOST("491");
 
 	// Hardcoded channels
 	const std::string DEFAULT_CHANNEL_1("#general");
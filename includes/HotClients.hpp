@@ -0,0 +1,72 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   HotClients.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/04 11:12:30 by hamalmar          #+#    #+#             */
+/*   Updated: 2026/01/04 11:12:30 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef HOTCLIENTS_HPP
+# define HOTCLIENTS_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Client.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief What a channel broadcast reads of a recipient: whether it is
+ * remote (link), which variant it gets (capabilities), and where its
+ * output queue is.
+ */
+struct HotClient {
+	int				id;
+	int				link;
+	unsigned int	capabilities;
+	Client			*client;
+};
+
+/**
+ * @brief The hot part of every client, one record each in a single vector
+ * instead of one std::map node per client.
+ *
+ * A channel keeps the slot of each member next to its id (see
+ * Channel::broadcast), so a broadcast goes from one record to the next in
+ * this vector and only follows the Client pointer of the members that get
+ * the line, to append to their queue.
+ *
+ * Records are made on the first find() of a client and stay until
+ * erase(), which the server calls wherever a client leaves clientMap.
+ * link and capabilities are copies, refresh() after changing either.
+ * A freed slot is reused; a stale slot is caught by the id check in
+ * find() and looked up again. The pointers find() returns are good until
+ * the next find(), which may grow the vector.
+ *
+ * @author Hamad
+ */
+class HotClients {
+	private:
+		std::map<int, Client>&	clientMap;
+		std::vector<HotClient>	records;
+		std::vector<size_t>		freeSlots;
+		std::map<int, size_t>	slots;
+
+		HotClients(const HotClients& right);
+		HotClients& operator=(const HotClients& right);
+
+	public:
+		static const size_t	NO_SLOT = static_cast<size_t>(-1);
+
+		explicit HotClients(std::map<int, Client>& clientMap);
+		~HotClients();
+
+		HotClient*	find(int id, size_t& slot);
+		void		refresh(int id);
+		void		erase(int id);
+		size_t		getMemoryUsage(void) const;
+};
+
+#endif
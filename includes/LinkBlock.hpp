@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LinkBlock.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/16 19:02:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/16 19:02:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef LINKBLOCK_HPP
+# define LINKBLOCK_HPP
+
+# include "UtilityHeaders.hpp"
+
+/**
+ * @brief A server this one may link with (link line of the config file).
+ * Both ends list each other with the same password. The end marked
+ * autoconnect opens the link, and reopens it after a split.
+ *
+ * @author Hamad
+ */
+class LinkBlock {
+	private:
+		std::string	name;
+		std::string	host;        // IPv4 address
+		int			port;
+		std::string	password;
+		bool		autoconnect;
+
+	public:
+		LinkBlock();
+		LinkBlock(const std::string& name, const std::string& host, int port, const std::string& password, bool autoconnect);
+		LinkBlock(const LinkBlock& right);
+		LinkBlock& operator=(const LinkBlock& right);
+		~LinkBlock();
+
+		const std::string&	getName(void) const;
+		const std::string&	getHost(void) const;
+		int					getPort(void) const;
+		const std::string&	getPassword(void) const;
+		bool				isAutoconnect(void) const;
+};
+
+#endif
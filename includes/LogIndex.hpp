@@ -0,0 +1,129 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LogIndex.hpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/20 10:05:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/20 10:05:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef LOGINDEX_HPP
+# define LOGINDEX_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "UtilitiyFunctions.hpp"
+# include "ChannelLogger.hpp"
+
+/**
+ * @brief Inverted index of the channel logs (see ChannelLogger.hpp), one
+ * index file next to each segment, so SEARCH never reads whole logs.
+ *
+ * A background thread looks at log_dir every INDEX_INTERVAL_MS and only
+ * indexes the lines added since its last pass. The index of the segment a
+ * channel is still writing is kept in memory by that thread, <segment>.idx
+ * is replaced with rename() so a search sees the old or the new file,
+ * never a partial one:
+ *
+ *     [magic][bytes of the segment covered][term count][posting count]
+ *     [terms: word offset, first posting, word length, posting count]
+ *     [postings: offsets of the lines in the segment, ascending]
+ *     [words, sorted]
+ *
+ * A search maps the index files, finds every word with a binary search and
+ * intersects the postings, then scans the lines written after the index.
+ * Only the nick and the text of a line are indexed, in lowercase.
+ *
+ * Searches run on the same thread, so the event loop never reads the logs:
+ * the loop submit()s a search and gets a ticket, the indexer takes the
+ * searches between two chunks or two naps, and the loop collect()s the
+ * results by ticket. The two queues are the only state shared with the
+ * loop, under lock.
+ *
+ * @author Hamad
+ */
+class LogIndex {
+	public:
+		struct Match {
+			std::string	channel;
+			std::string	line;
+		};
+
+		struct Result {
+			unsigned long		ticket;
+			std::vector<Match>	matches;
+		};
+
+	private:
+		// Offsets fit in 32 bits, segments stop growing at LOG_SEGMENT_BYTES
+		typedef std::map<std::string, std::vector<unsigned int> >	Postings;
+
+		struct Pending {
+			unsigned long	covered;   // Bytes of the segment indexed
+			unsigned long	written;   // Bytes covered by the index file
+			Postings		postings;
+		};
+
+		struct Request {
+			unsigned long	ticket;
+			std::string		channel;
+			std::string		text;
+			size_t			limit;
+		};
+
+		std::string		directory;
+		bool			running;
+		bool			started;
+		pthread_t		thread;
+
+		// Shared with the loop, under lock
+		pthread_mutex_t			lock;
+		std::deque<Request>		requests;
+		std::vector<Result>		results;
+		unsigned long			nextTicket;   // Loop only
+		size_t					outstanding;  // Loop only, submitted and not collected
+
+		std::map<std::string, Pending>			pending;   // Indexer only, by segment path
+		std::map<std::string, unsigned long>	complete;  // Indexer only, finished segments and their size
+
+		LogIndex(const LogIndex& right);
+		LogIndex& operator=(const LogIndex& right);
+
+		static void	*run(void *self);
+		void		indexerLoop(void);
+		void		indexPass(void);
+		void		indexSegment(const std::string& path, bool active);
+		bool		loadIndex(const std::string& path, Pending& index) const;
+		void		writeIndex(const std::string& path, Pending& index) const;
+		void		serveSearches(void);
+		size_t		search(const std::string& channel, const std::string& text, size_t limit, std::vector<Match>& matches) const;
+		void		searchSegment(const std::string& path, const std::string& channel,
+						const std::vector<std::string>& terms, size_t limit, std::vector<Match>& matches) const;
+
+	public:
+		LogIndex();
+		~LogIndex();
+
+		void	open(const std::string& dir);
+		void	stop(void);
+		bool	isEnabled(void) const;
+		unsigned long	submit(const std::string& channel, const std::string& text, size_t limit);
+		void	collect(std::vector<Result>& done);
+		bool	hasOutstanding(void) const;
+
+		static void	splitWords(const char *text, size_t length, std::vector<std::string>& words);
+
+		class LogIndexException: public std::exception{
+			private:
+				std::string message;
+			public:
+				LogIndexException(const std::string& message);
+				~LogIndexException() throw();
+				const char	*what() const throw();
+		};
+};
+
+#endif
@@ -0,0 +1,52 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MemoryUsage.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/30 14:12:36 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/30 14:12:36 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MEMORYUSAGE_HPP
+# define MEMORYUSAGE_HPP
+
+# include "UtilityHeaders.hpp"
+
+/**
+ * @brief Heap bytes held by the server, by subsystem, as measured by
+ * Server::measureMemory() (see ServerMemory.cpp).
+ *
+ * The figures are computed from the containers: string and vector
+ * capacities, one block per tree node, each block rounded the way malloc
+ * rounds it. Fixed size parts (the Server object, the metrics) are left
+ * out. heapInUse is malloc's own count of the bytes it handed out, 0 where
+ * the C library doesn't say, to see how far off the estimate is.
+ *
+ * @var connections Local connections, clients and links.
+ *
+ * @author Hamad
+ */
+struct MemoryUsage {
+	enum Subsystem {CONNECTIONS, INPUT, OUTPUT, CHANNELS, HISTORY, SERVICES, NUM_SUBSYSTEMS};
+
+	size_t	bytes[NUM_SUBSYSTEMS];
+	size_t	connections;
+	size_t	heapInUse;
+
+	MemoryUsage();
+
+	size_t				total(void) const;
+	size_t				perConnection(void) const;
+	static const char	*name(Subsystem subsystem);
+};
+
+size_t	allocationBytes(size_t requested);
+size_t	stringBytes(const std::string& value);
+size_t	treeNodeBytes(size_t valueSize);
+size_t	dequeBytes(size_t count, size_t elementSize);
+size_t	mallocInUse(void);
+
+#endif
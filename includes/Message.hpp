@@ -15,43 +15,58 @@
 # define MESSAGE_HPP
 
 # include "UtilityHeaders.hpp"
+# include "Probes.hpp"
 
 /**
  * @brief Represents a parsed IRC message according to RFC 2812
  * 
- * IRC Message Format: [":prefix "] command [params] \r\n
+ * IRC Message Format: ["@tags "] [":prefix "] command [params] \r\n
  * - Messages are max 512 chars (including \r\n)
  * - Prefix is optional, indicates message origin
  * - Command is either a word or 3-digit numeric
  * - Up to 15 parameters, last can have spaces if prefixed with ':'
  * 
+ * The server parses every line into the same Message: parse() reuses the
+ * strings of the previous line, so their capacity is kept from one line
+ * to the next.
+ * 
  * @author aboudi
  */
 class Message {
 	private:
+		std::string tags;                      // IRCv3 message tags, without the '@'
 		std::string prefix;                    // Optional message prefix (origin)
 		std::string command;                   // IRC command (NICK, JOIN, PRIVMSG, etc.)
 		std::vector<std::string> parameters;   // Command parameters (max 15)
+		std::vector<std::string> spare;        // Parameter strings of earlier lines, for reuse
 		std::string rawMessage;                // Original raw message
 		bool valid;                            // Whether parsing succeeded
 
+		bool parseLine(const std::string& rawMsg);
+		std::string& nextParameter();
+
 	public:
 		Message();
 		Message(const std::string& rawMsg);
 		Message(const Message& right);
 		Message& operator=(const Message& right);
+# if __cplusplus >= 201103L
+		Message(Message&& right) = default;
+		Message& operator=(Message&& right) = default;
+# endif
 		~Message();
 
 		// Parsing
 		bool parse(const std::string& rawMsg);
 		
 		// Getters
-		std::string getPrefix() const;
-		std::string getCommand() const;
-		std::vector<std::string> getParameters() const;
+		const std::string& getTags() const;
+		const std::string& getPrefix() const;
+		const std::string& getCommand() const;
+		const std::vector<std::string>& getParameters() const;
 		std::string getParameter(size_t index) const;
 		size_t getParameterCount() const;
-		std::string getRawMessage() const;
+		const std::string& getRawMessage() const;
 		bool isValid() const;
 
 		// Utility
@@ -0,0 +1,102 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/26 16:40:03 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/26 16:40:03 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef METRICS_HPP
+# define METRICS_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+
+/**
+ * @brief A counter written by one thread only, padded to a whole cache line
+ * so that two threads' counters never share one. The writer adds with a
+ * relaxed store (a plain mov), the metrics page reads with a relaxed load:
+ * a scrape never takes a lock or bounces the writer's line.
+ *
+ * @author Hamad
+ */
+struct MetricCell {
+	unsigned long	value;
+	char			padding[CACHE_LINE_BYTES - sizeof(unsigned long)];
+
+	MetricCell() : value(0) {}
+	void			add(unsigned long amount) {__atomic_store_n(&this->value, this->value + amount, __ATOMIC_RELAXED);}
+	unsigned long	load(void) const {return (__atomic_load_n(&this->value, __ATOMIC_RELAXED));}
+};
+
+//A connection to the metrics port: its request, then the response going out.
+struct MetricsScrape {
+	std::string		request;
+	std::string		response;
+	size_t			sent;
+	unsigned long	deadline;
+};
+
+/**
+ * @brief Fixed bucket histogram, one count per bucket (value <= bound) and
+ * one past the last bound (+Inf). Buckets are cumulated when written.
+ *
+ * @author Hamad
+ */
+class Histogram {
+	private:
+		const unsigned long			*bounds;
+		size_t						size;
+		std::vector<unsigned long>	counts;
+		unsigned long				sum;
+		unsigned long				count;
+
+	public:
+		Histogram(const unsigned long *bounds, size_t size);
+		Histogram(const Histogram& right);
+		Histogram& operator=(const Histogram& right);
+		~Histogram();
+
+		void	observe(unsigned long value);
+		void	write(std::ostringstream& out, const std::string& name, const std::string& labels, bool inSeconds, bool gauge) const;
+};
+
+/**
+ * @brief What the event loop counts for the metrics page (see
+ * ServerMetrics.cpp): messages and bytes in and out, how long each loop
+ * iteration takes and how long each command runs, in microseconds. Only the
+ * event loop touches it, the counters are MetricCells all the same so the
+ * page reads every counter the same way, these and the log writer's.
+ *
+ * @author Hamad
+ */
+class Metrics {
+	public:
+		enum Counter {MESSAGES_IN, BYTES_IN, MESSAGES_OUT, BYTES_OUT, FANOUT_SKIPPED, NUM_COUNTERS};
+
+	private:
+		MetricCell				counters[NUM_COUNTERS];
+		Histogram				loopIteration;
+		std::vector<Histogram>	commandLatency;  // METRIC_COMMANDS, then every other command
+
+		Metrics(const Metrics& right);
+		Metrics& operator=(const Metrics& right);
+
+	public:
+		Metrics();
+		~Metrics();
+
+		void			add(Counter counter, unsigned long amount);
+		unsigned long	get(Counter counter) const;
+		void			observeIteration(unsigned long micros);
+		void			observeCommand(const std::string& command, unsigned long micros);
+		void			write(std::ostringstream& out) const;
+
+		static void		writeFamily(std::ostringstream& out, const std::string& name, const std::string& type, const std::string& help);
+};
+
+#endif
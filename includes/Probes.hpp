@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Probes.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/24 10:12:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/24 10:12:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef PROBES_HPP
+# define PROBES_HPP
+
+/**
+ * @brief Static tracepoints (USDT) of provider "hai", for bpftrace and perf.
+ * They are only built with `make re USDT=1`, which needs <sys/sdt.h>
+ * (systemtap-sdt-dev). A built probe is a nop until a tracer attaches to it,
+ * without USDT=1 there is nothing at all and the arguments are not even
+ * evaluated.
+ *
+ *     accept         fd, IPv4 address        a connection was accepted
+ *     recv           fd, bytes               input read from a connection
+ *     frame          fd, length              a complete line was cut from it
+ *     parse_begin    length                  Message starts parsing a line
+ *     parse_end      valid, command
+ *     command_begin  fd, command             a command is dispatched
+ *     command_end    fd, command             and returned
+ *     broadcast      channel, recipients     a line was queued to the members
+ *     close          fd                      cleanClient() forgets a connection
+ *
+ * Strings are char pointers, read them with str(argN) in bpftrace. The
+ * scripts in tools/ are examples.
+ *
+ * @author Hamad
+ */
+# ifdef HAI_USDT
+#  include <sys/sdt.h>
+#  define HAI_PROBE1(name, a) DTRACE_PROBE1(hai, name, a)
+#  define HAI_PROBE2(name, a, b) DTRACE_PROBE2(hai, name, a, b)
+# else
+#  define HAI_PROBE1(name, a) ((void)sizeof(a))
+#  define HAI_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+# endif
+
+#endif
@@ -0,0 +1,47 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RateMeter.hpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/27 11:20:14 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/27 11:20:14 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef RATEMETER_HPP
+# define RATEMETER_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+
+/**
+ * @brief Counts events (lines of a client, deliveries of a channel) and
+ * their rate over windows of RATE_WINDOW_MS. The rate shown is the one of
+ * the last full window, or of the time since, if that is longer: a meter
+ * nothing was added to for a while goes down on its own. A new meter shows
+ * the rate of its first window so far.
+ *
+ * @author Hamad
+ */
+class RateMeter {
+	private:
+		unsigned long	total;
+		unsigned long	windowStart;
+		unsigned long	windowCount;
+		unsigned long	lastRate;     // Tenths of an event per second
+
+	public:
+		RateMeter();
+		RateMeter(const RateMeter& right);
+		RateMeter& operator=(const RateMeter& right);
+		~RateMeter();
+
+		void			add(unsigned long amount, unsigned long nowMs);
+		unsigned long	getTotal(void) const;
+		unsigned long	getRate(unsigned long nowMs) const;
+		std::string		formatRate(unsigned long nowMs) const;
+};
+
+#endif
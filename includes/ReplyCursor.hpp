@@ -0,0 +1,71 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ReplyCursor.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/05 18:10:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/05 18:10:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef REPLYCURSOR_HPP
+# define REPLYCURSOR_HPP
+
+# include <set>
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "Client.hpp"
+# include "Channel.hpp"
+
+/**
+ * @brief Resumable generator for the replies that grow with the size of the
+ * server (WHO, NAMES and LIST).
+ *
+ * Instead of building the whole answer inside processCommand the server keeps
+ * a cursor per connection and asks it for a few more lines every time the
+ * client's output queue drains. The cursor only remembers where it stopped
+ * (the last fd or channel name it emitted) so members joining or leaving in
+ * between are handled naturally.
+ *
+ * @author Hamad
+ */
+class ReplyCursor {
+	public:
+		enum Kind {
+			WHO,
+			NAMES,
+			LIST
+		};
+
+	private:
+		Kind		kind;
+		std::string	target;        // Channel name for WHO/NAMES, unused for LIST
+		int			phase;         // NAMES: 0 operators, 1 regular members
+		int			lastFd;        // Last member emitted, -1 before the first one
+		std::string	lastChannel;   // Last channel emitted by LIST
+		bool		started;
+
+		bool	resumeWho(const std::string& nickname, const std::map<int, Client>& clientMap,
+					const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget);
+		bool	resumeNames(const std::string& nickname, const std::map<int, Client>& clientMap,
+					const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget);
+		bool	resumeList(const std::string& nickname,
+					const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget);
+
+	public:
+		ReplyCursor();
+		ReplyCursor(Kind kind, const std::string& target);
+		ReplyCursor(const ReplyCursor& right);
+		ReplyCursor& operator=(const ReplyCursor& right);
+		~ReplyCursor();
+
+		Kind				getKind(void) const;
+		const std::string&	getTarget(void) const;
+
+		bool	resume(const std::string& nickname, const std::map<int, Client>& clientMap,
+					const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget);
+};
+
+#endif
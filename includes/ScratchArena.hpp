@@ -0,0 +1,57 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ScratchArena.hpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/31 10:27:44 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/31 10:27:44 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef SCRATCHARENA_HPP
+# define SCRATCHARENA_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief The strings one loop iteration builds and throws away: the line
+ * being run, the upper case command, the replies being put together.
+ *
+ * take() hands out the next string, empty but with the capacity it had
+ * in the earlier iterations, reset() at the end of the iteration takes
+ * them all back. Once the strings have grown to the size of the lines,
+ * building them no longer calls malloc.
+ *
+ * A string taken stays valid until reset() (the deque doesn't move them),
+ * or until release() of a mark() taken before it: processInput() releases
+ * what each command took once it ran, so the pool only grows to what one
+ * command needs, however many commands the iteration runs. reset() gives
+ * back the strings past SCRATCH_STRINGS and those grown past
+ * SCRATCH_STRING_BYTES, a burst doesn't keep its memory.
+ *
+ * @author Hamad
+ */
+class ScratchArena {
+	private:
+		std::deque<std::string>	strings;
+		size_t					used;
+
+		ScratchArena(const ScratchArena& right);
+		ScratchArena& operator=(const ScratchArena& right);
+
+	public:
+		ScratchArena();
+		~ScratchArena();
+
+		std::string&	take(void);
+		size_t			mark(void) const;
+		void			release(size_t mark);
+		void			reset(void);
+		size_t			getMemoryUsage(void) const;
+};
+
+#endif
@@ -21,6 +21,20 @@
 # include "Message.hpp"
 # include <sstream>
 # include "Channel.hpp"
+# include "ReplyCursor.hpp"
+# include "ConnectionClass.hpp"
+# include "Config.hpp"
+# include "StateStream.hpp"
+# include "ChannelStore.hpp"
+# include "ChannelLogger.hpp"
+# include "LogIndex.hpp"
+# include "Probes.hpp"
+# include "Metrics.hpp"
+# include "AdminConsole.hpp"
+# include "TrafficCapture.hpp"
+# include "MemoryUsage.hpp"
+# include "ScratchArena.hpp"
+# include "HotClients.hpp"
 
 class Server{
 
@@ -53,6 +67,28 @@ class Server{
 		//This will hold the server password.
 		std::string password;
 
+		/*
+			Settings coming from the config file (see Config.hpp). configPath
+			is empty when the server runs on the compile time defaults.
+		*/
+		std::string configPath;
+		std::string listenAddress;
+		size_t maxClients;
+		int pollTimeout;
+		std::vector<char> recvBuffer;
+
+		//Set by SIGHUP, the config is reloaded at the top of the event loop.
+		volatile sig_atomic_t reloadRequested;
+
+		/*
+			Set by SIGUSR2, the server hands over to a fresh exec of
+			programPath (argv[0] resolved at startup) with programArguments
+			(its own command line) at the top of the loop.
+		*/
+		volatile sig_atomic_t upgradeRequested;
+		std::vector<std::string> programArguments;
+		std::string programPath;
+
 		/**
 		 * @brief pollfd is going to be used by the @var pollManager where cli-
 		 * -ent is gonna have the size of the constant NUMBER_OF_CLIENTS which
@@ -74,12 +110,150 @@ class Server{
 		//This map will be used to store the client object relative to his file descriptor.
 		std::map<int, Client> clientMap;
 
+		/*
+			What a channel broadcast reads of each client (see HotClients.hpp),
+			in one vector. A client's record goes with hotClients.erase()
+			wherever it leaves clientMap, and refresh() follows a change of
+			its capabilities.
+		*/
+		HotClients hotClients;
+
 		//This map will be used to store the channels reative to the channel name.
 		std::map<std::string, Channel> channels;
 
+		/*
+			Server links (see ServerLink.cpp). knownServers maps every server
+			of the network to the fd of the link it is behind, linkBlocks are
+			the servers we may link with.
+		*/
+		std::string serverName;
+		std::vector<LinkBlock> linkBlocks;
+		std::map<std::string, int> knownServers;
+		int nextRemoteId;
+		size_t remoteUserCount;
+		unsigned long lastLinkAttempt;
+
+		/*
+			Channel history (see ServerHistory.cpp). historyOldest holds the
+			oldest msgid of every channel with history, its first element is
+			the message evicted when historyBytes goes past HISTORY_BUDGET.
+		*/
+		unsigned long nextMsgid;
+		unsigned long lastHistoryTime;
+		size_t historyBytes;
+		std::set<std::pair<unsigned long, std::string> > historyOldest;
+
+		//Snapshot and journal of the channel metadata, disabled without state_dir.
+		ChannelStore channelStore;
+		std::string stateDir;
+
+		//Transcripts of the channels marked "log", disabled without log_dir.
+		ChannelLogger channelLogger;
+		std::string logDir;
+		std::set<std::string> loggedChannels;
+
+		//Index of those transcripts for SEARCH, running whenever channelLogger is.
+		LogIndex logIndex;
+
+		/*
+			SEARCHes the indexer is running, by ticket: the fd and the nick
+			that asked, and when. The result goes to that fd only if the
+			same operator is still there.
+		*/
+		std::map<unsigned long, std::pair<std::pair<int, std::string>, unsigned long> > searches;
+
+		//Names and passwords accepted by OPER.
+		std::map<std::string, std::string> operators;
+
+		/*
+			Session resumption (see ServerSession.cpp). sessionTokens maps
+			every token to its user, detachedSessions the users without a
+			connection to when they expire.
+		*/
+		unsigned long sessionGrace;
+		std::map<std::string, int> sessionTokens;
+		std::map<int, unsigned long> detachedSessions;
+		int nextDetachedId;
+
+		/*
+			Metrics page (see ServerMetrics.cpp). The listener and the
+			scrapers use the METRICS_SLOTS pollfds after the client slots,
+			metricsSocket is -1 without a metrics line in the config.
+		*/
+		int metricsSocket;
+		Metrics metrics;
+		std::map<int, MetricsScrape> scrapes;
+		/*
+			Admin console (see ServerAdmin.cpp). The listener and the
+			consoles use the ADMIN_SLOTS pollfds after the metrics ones,
+			adminSocket is -1 without admin_socket in the config. adminPath
+			is the socket file, removed on exit.
+		*/
+		int adminSocket;
+		std::string adminPath;
+		std::map<int, AdminConsole> consoles;
+
+		//Recording of the client traffic for tools/replay, off unless started.
+		TrafficCapture capture;
+
+		/*
+			Memory budget (see ServerMemory.cpp), 0 for none. sheddingLoad
+			is set while the last measure was over it.
+		*/
+		size_t memoryBudget;
+		unsigned long nextMemoryCheck;
+		bool sheddingLoad;
+
+		/*
+			Pull fan-out (see ServerFanout.cpp): channels from fanoutRing
+			members on use a ring, 0 for never. fanoutChannels are the
+			channels using one. fanoutWake is set when a queue went under
+			SENDQ_LOW_WATERMARK: besides the rings that got a line, only then
+			do the rings have something to hand out.
+		*/
+		size_t fanoutRing;
+		std::set<std::string> fanoutChannels;
+		bool fanoutWake;
+
 		//This will hold the buffer of the client when we will be using recv.
 		std::map<int, std::string> clientBuffer;
 
+		/*
+			Temporaries of the loop (see ScratchArena.hpp): every line is
+			parsed into parsed, the lines and replies are built in scratch
+			strings, reset at the end of each iteration.
+		*/
+		Message parsed;
+		ScratchArena scratch;
+
+		/*
+			Pending WHO/NAMES/LIST replies of each client, in the order they
+			were requested. While a client has one, its further commands wait
+			in clientBuffer so the replies are never interleaved.
+		*/
+		std::map<int, std::deque<ReplyCursor> > replyCursors;
+
+		//Connection classes, the first one matching a client is used.
+		std::vector<ConnectionClass> connectionClasses;
+
+		//Slots of the clients whose commands are held back by flood control.
+		std::vector<unsigned int> throttledClients;
+
+		/*
+			Round robin run queue of the pollfd slots that have complete
+			commands waiting. Every turn a client runs at most
+			COMMANDS_PER_TURN of them and goes back to the end of the queue.
+		*/
+		std::deque<unsigned int> readyClients;
+		std::vector<bool> scheduledClients;
+
+		/*
+			Keepalive timing wheel (see sweepKeepalive): the bucket swept next
+			and when, one bucket every PING_INTERVAL_MS / KEEPALIVE_SLOTS.
+		*/
+		unsigned int keepaliveBucket;
+		unsigned long nextKeepaliveSweep;
+
 		//This will be used for the event loop.
 		bool isRunning;
 
@@ -95,23 +269,128 @@ class Server{
 		Server& operator=(const Server&  right);
 		//Hamad Functions
 		void	closeClientConnection(pollfd& client);
+		void	growCapacity(size_t capacity);
+		void	reloadConfig(void);
 		void	rejectClient(int clientSocket);
+		bool	acceptConnection(int clientSocket, in_addr_t address, unsigned long now);
 		bool	isNicknameTaken(std::string& nickname);
-		void	cleanClient(pollfd& client);
+		void	cleanClient(pollfd& client, bool announce = true);
+		void	disconnectClient(pollfd& client, const std::string& reason);
+		int		findConnectionClass(in_addr_t address, const std::string& pass) const;
+		bool	assignConnectionClass(int clientFd, int classIndex);
+		void	queueMessage(int clientFd, const std::string& message);
+		bool	flushClient(pollfd& client);
+		bool	processInput(pollfd& client, unsigned int maxCommands);
+		bool	hasPendingCommand(int clientFd) const;
+		bool	isPriorityInput(int clientFd);
+		void	scheduleInput(unsigned int slot);
+		void	runScheduler(void);
+		void	queueReplyCursor(int clientFd, const ReplyCursor& cursor);
+		bool	hasReplyCursor(int clientFd) const;
+		void	resumeReplyCursors(void);
+		void	finishReplyCursors(void);
+		void	sweepKeepalive(unsigned long now);
+		void	loadSettings(const Config& config);
+		void	initializeState(const Config& config);
+		bool	upgrade(void);
+		void	serializeState(StateWriter& writer, std::vector<int>& fds);
+		void	restoreState(StateReader& reader, const std::vector<int>& fds);
 
 		//Abood Functions
 		void	handleMessage(pollfd& client, const std::string& rawMessage);
-		void	processCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params);
+		void	processCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params, const std::string& tags);
 		void	sendNumericReply(pollfd& client, const std::string& numeric, const std::string& message);
 		void	sendWelcomeMessages(pollfd& client);
 		bool	isNicknameValid(const std::string& nickname);
 		bool	isNicknameInUse(const std::string& nickname);
+		int		findClientByNickname(const std::string& nickname) const;
+		void	joinChannel(pollfd& client, const std::string& channelName, const std::string& key);
+		void	partChannel(pollfd& client, const std::string& channelName, const std::string& reason);
+		void	handleMessageCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params, const std::string& tags);
+
+		//Server links
+		void	connectLinks(void);
+		void	acceptLink(pollfd& client, const std::vector<std::string>& params);
+		void	sendBurst(int linkFd);
+		std::string	introduction(const Client& user, int hopcount) const;
+		void	propagate(const std::string& line, int exceptLink);
+		void	propagateToChannel(const Channel& chan, const std::string& line, int exceptLink);
+		void	introduceUser(int clientFd);
+		void	splitLink(int linkFd, const std::string& reason);
+		void	removeRemoteUser(int userId, const std::string& quitLine);
+		void	quitChannels(int userId, const std::string& quitLine);
+		void	killUser(int userId, const std::string& reason, int exceptLink);
+		bool	resolveNickCollision(int existingId, unsigned long incomingTs, const std::string& incomingNick, pollfd& link);
+		void	applyRemoteModes(Channel& chan, const std::vector<std::string>& params);
+		void	processServerMessage(pollfd& link, const Message& msg);
+		void	remoteJoin(int userId, const std::string& channelName, bool asOperator);
+
+		//Channel history
+		void	recordHistory(Channel& chan, const std::string& line, unsigned long time, unsigned long msgid);
+		void	evictHistory(size_t budget);
+		void	chatHistory(pollfd& client, const std::vector<std::string>& params);
+		void	logChannel(const Channel& chan, const std::string& line);
+		void	searchLogs(pollfd& client, const std::vector<std::string>& params);
+		void	deliverSearches(void);
+
+		//Capabilities and away
+		void			negotiateCapabilities(pollfd& client, const std::vector<std::string>& params);
+		void			setAway(pollfd& client, const std::vector<std::string>& params);
+		void			notifyAway(int userId, const std::string& line);
+		void			announceAway(Channel& chan, int userId);
+		unsigned long	stampMessage(unsigned long& time);
+
+		//Session resumption
+		void	updateSessionToken(int clientFd);
+		bool	detachClient(pollfd& client);
+		void	resumeSession(pollfd& client, const std::vector<std::string>& params);
+		void	moveUser(int fromId, int toId);
+		void	expireSessions(unsigned long now);
+		void	endSession(int userId, const std::string& reason, bool announce);
+
+		//Metrics page
+		void		openMetrics(const std::string& address, int metricsPort);
+		void		serveMetrics(unsigned long now);
+		void		answerScrape(MetricsScrape& scrape) const;
+		std::string	renderMetrics(void) const;
+		void		closeScrape(pollfd& scraper);
+		//Admin console
+		void		openAdmin(const std::string& path);
+		void		serveAdmin(unsigned long now);
+		void		runAdmin(AdminConsole& console, unsigned long now);
+		void		adminCommand(AdminConsole& console, const std::string& line, unsigned long now);
+		void		listRows(AdminConsole& console, unsigned long now);
+		std::string	adminClientRow(int userId, const Client& user, unsigned long now) const;
+		std::string	adminClass(const std::vector<std::string>& words);
+		std::string	adminSet(const std::string& setting, const std::string& value);
+		void		closeConsole(pollfd& console);
+
+		//Memory accounting
+		void		measureMemory(MemoryUsage& usage) const;
+		void		checkMemory(unsigned long now);
+		std::string	memoryReport(void) const;
+		void		memoryStats(pollfd& client);
+
+		//Pull fan-out
+		void		fanOut(Channel& chan, TaggedLine& line, int excludeId);
+		void		drainFanout(void);
+		void		finishFanout(void);
+		void		catchUpMember(Channel& chan, int id);
+		bool		hasFanoutLines(void) const;
+		void		countSkipped(unsigned long skipped);
 
 		public:
 			~Server();
-			Server(int port, const std::string& password);
+			Server(int port, const std::string& password, const Config& config);
+			explicit Server(int upgradeSocket);
+			Server(const std::string& password, const Config& config);
 			void	start(void);
+			bool	runIteration(int timeout);
+			int		openLocalConnection(in_addr_t address);
 			void	shutdown(void);
+			void	requestReload(void);
+			void	requestUpgrade(void);
+			void	setProgramArguments(char **av);
 
 			class EmptyPasswordException: public std::exception{
 				public:
@@ -156,6 +435,21 @@ class Server{
 				public:
 					const char	*what() const throw();
 			};
+
+			class FailedToUpgradeException: public std::exception{
+				public:
+					const char	*what() const throw();
+			};
+
+			class FailedToOpenMetricsException: public std::exception{
+				public:
+					const char	*what() const throw();
+			};
+
+			class FailedToOpenAdminException: public std::exception{
+				public:
+					const char	*what() const throw();
+			};
 };
 
 #endif
\ No newline at end of file
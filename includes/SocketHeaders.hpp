@@ -20,8 +20,10 @@
 # include <sys/socket.h>
 # include <sys/types.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 # include <arpa/inet.h>
 # include <netdb.h>
 # include <poll.h>
+# include <sys/un.h>
 
 #endif
\ No newline at end of file
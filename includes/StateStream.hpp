@@ -0,0 +1,78 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   StateStream.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/12 14:40:02 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/12 14:40:02 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef STATESTREAM_HPP
+# define STATESTREAM_HPP
+
+# include "UtilityHeaders.hpp"
+
+/**
+ * @brief Compact binary encoding of the server state. Numbers are 8 bytes
+ * big endian and strings are a number (the length) followed by the bytes,
+ * so any content (spaces, CRLF, NUL) round trips.
+ *
+ * The compact forms, for files holding many small records (see
+ * TrafficCapture.hpp), write a number 7 bits per byte, lowest first, with
+ * the high bit set on every byte but the last.
+ *
+ * @author Hamad
+ */
+class StateWriter {
+	private:
+		std::string	data;
+
+	public:
+		StateWriter();
+		StateWriter(const StateWriter& right);
+		StateWriter& operator=(const StateWriter& right);
+		~StateWriter();
+
+		void				putNumber(unsigned long value);
+		void				putSigned(long value);
+		void				putBool(bool value);
+		void				putString(const std::string& value);
+		void				putCompact(unsigned long value);
+		void				putCompactString(const std::string& value);
+		const std::string&	getData(void) const;
+		void				clear(void);
+};
+
+class StateReader {
+	private:
+		const char	*data;
+		size_t		length;
+		size_t		position;
+
+		StateReader();
+
+	public:
+		StateReader(const char *data, size_t length);
+		StateReader(const StateReader& right);
+		StateReader& operator=(const StateReader& right);
+		~StateReader();
+
+		unsigned long	getNumber(void);
+		long			getSigned(void);
+		bool			getBool(void);
+		std::string		getString(void);
+		unsigned long	getCompact(void);
+		std::string		getCompactString(void);
+		bool			atEnd(void) const;
+		size_t			getPosition(void) const;
+
+		class CorruptStateException: public std::exception{
+			public:
+				const char	*what() const throw();
+		};
+};
+
+#endif
@@ -0,0 +1,60 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TaggedLine.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/21 14:22:09 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/21 14:22:09 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef TAGGEDLINE_HPP
+# define TAGGEDLINE_HPP
+
+# include "UtilityHeaders.hpp"
+# include "Constants.hpp"
+# include "UtilitiyFunctions.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief A message going to many clients, whose IRCv3 tags depend on the
+ * capabilities each recipient enabled:
+ *
+ *     server-time    @time=2025-12-21T14:22:09.123Z
+ *     message-tags   @msgid=...;+client=tags
+ *
+ * The variants only differ by the tags in front of the line. Each one is
+ * rendered the first time a recipient needs it and shared with every other
+ * recipient with the same capabilities, so a broadcast to any number of
+ * members renders at most TAG_VARIANTS lines.
+ *
+ * @author Hamad
+ */
+class TaggedLine {
+	private:
+		std::string		line;        // Without tags, CRLF included
+		std::string		clientTags;  // The sender's +tags, ';' separated
+		unsigned long	time;
+		unsigned long	msgid;
+		bool			tagsOnly;    // TAGMSG: nothing to send without message-tags
+		std::string		variants[TAG_VARIANTS];
+		bool			rendered[TAG_VARIANTS];
+
+	public:
+		TaggedLine(const std::string& line, unsigned long time, unsigned long msgid);
+		TaggedLine(const TaggedLine& right);
+		TaggedLine& operator=(const TaggedLine& right);
+		~TaggedLine();
+
+		void				setClientTags(const std::string& tags);
+		void				setTagsOnly(bool value);
+		const std::string&	getLine(void) const;
+		const std::string&	render(unsigned int capabilities);
+		size_t				getMemoryUsage(void) const;
+
+		static std::string	clientOnlyTags(const std::string& tags);
+};
+
+#endif
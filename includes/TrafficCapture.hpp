@@ -0,0 +1,108 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TrafficCapture.hpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/29 09:41:07 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/29 09:41:07 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef TRAFFICCAPTURE_HPP
+# define TRAFFICCAPTURE_HPP
+
+# include "UtilityHeaders.hpp"
+# include "SocketHeaders.hpp"
+# include "Constants.hpp"
+# include "UtilitiyFunctions.hpp"
+# include "StateStream.hpp"
+# include "MemoryUsage.hpp"
+
+/**
+ * @brief Records what the clients send, with its timing, so tools/replay
+ * can play the same sessions against a server again. Started with the
+ * capture directive of the config or CAPTURE on the admin console, it
+ * only follows the connections accepted after it started.
+ *
+ * The file is CAPTURE_MAGIC and the wall clock start time in ms
+ * (StateWriter encoding), then one record per event, compact encoding:
+ *
+ *     [kind][session][ms since the previous record][address | line]
+ *
+ * OPEN carries the IPv4 address of the connection, LINE one line as the
+ * server read it without its CRLF, CLOSE nothing. Sessions are numbered
+ * from 1 in the order they opened. Credentials are not kept: the
+ * parameters of PASS and RESUME and the password of OPER become "*".
+ *
+ * Records are buffered and written by commit() at the end of the loop
+ * iteration, without fsync, a capture is not worth waiting on the disk.
+ * An upgrade ends the capture, the old process closes the file on exit.
+ *
+ * @author Hamad
+ */
+class TrafficCapture {
+	public:
+		enum Kind {OPEN = 1, LINE = 2, CLOSE = 3};
+
+		/**
+		 * @brief One record, as next() decodes it.
+		 * @var time ms since the capture started.
+		 */
+		struct Event {
+			Kind			kind;
+			unsigned long	session;
+			unsigned long	time;
+			in_addr_t		address;
+			std::string		line;
+		};
+
+	private:
+		std::string		path;
+		int				fd;
+		StateWriter		pending;
+		unsigned long	lastRecord;
+		unsigned long	lastWrite;
+		unsigned long	nextSession;
+		unsigned long	records;
+		unsigned long	bytesWritten;
+		std::map<int, unsigned long>	sessions;  // fd to session
+
+		TrafficCapture(const TrafficCapture& right);
+		TrafficCapture& operator=(const TrafficCapture& right);
+
+		void	putRecord(Kind kind, unsigned long session);
+
+	public:
+		TrafficCapture();
+		~TrafficCapture();
+
+		void				start(const std::string& file);
+		void				stop(void);
+		bool				isEnabled(void) const;
+		const std::string&	getPath(void) const;
+		unsigned long		getSessionCount(void) const;
+		unsigned long		getRecords(void) const;
+		unsigned long		getBytesWritten(void) const;
+		size_t				getMemoryUsage(void) const;
+		void				openSession(int clientFd, in_addr_t address);
+		void				recordLine(int clientFd, const std::string& line);
+		void				closeSession(int clientFd);
+		void				commit(unsigned long nowMs);
+
+		static std::string	redact(const std::string& line);
+		static unsigned long	readHeader(StateReader& reader);
+		static void			next(StateReader& reader, Event& event);
+
+		class TrafficCaptureException: public std::exception{
+			private:
+				std::string message;
+			public:
+				TrafficCaptureException(const std::string& message);
+				~TrafficCaptureException() throw();
+				const char	*what() const throw();
+		};
+};
+
+#endif
@@ -4,7 +4,17 @@
 # include "SocketHeaders.hpp"
 # include "Constants.hpp"
 
-std::string	recieveData(pollfd& client);
+std::string	recieveData(pollfd& client, std::vector<char>& buffer);
 void        sendMessage(pollfd& client, const std::string& message);
 void        channelSendMessage(int clientFd, const std::string& message);
+unsigned long				currentTimeMs(void);
+unsigned long				currentTimeUs(void);
+unsigned long				wallTimeMs(void);
+std::string					formatServerTime(unsigned long ms);
+bool						parseServerTime(const std::string& text, unsigned long& ms);
+std::vector<std::string>	splitList(const std::string& list, char delimiter, bool keepEmpty = false);
+bool						writeAll(int fd, const char *data, size_t length);
+bool						readAll(int fd, char *data, size_t length);
+std::string					randomHex(size_t bytes);
+std::string					capabilityList(unsigned int capabilities);
 #endif
\ No newline at end of file
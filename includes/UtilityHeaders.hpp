@@ -24,14 +24,38 @@
 # include <algorithm>
 # include <fcntl.h>
 # include <unistd.h>
+# include <sys/wait.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <dirent.h>
 # include <signal.h>
 # include <limits>
 # include <map>
 # include <vector>
+# include <deque>
 # include <fstream>
 # include <iomanip>
 # include <ctime>
 # include <cstring>
+# include <cstdlib>
+# include <cstdio>
+# include <pthread.h>
+# include <set>
 # include <cerrno>
+# ifdef __GLIBC__
+#  include <malloc.h>
+# endif
+
+/*
+	The default build is C++98, make re MODERN=1 builds in C++17. There
+	HAI_MOVE(value) hands value over with std::move, where it was copied:
+	use it on a value that is not used again.
+*/
+# if __cplusplus >= 201103L
+#  include <utility>
+#  define HAI_MOVE(value) std::move(value)
+# else
+#  define HAI_MOVE(value) (value)
+# endif
 
 #endif
@@ -18,11 +18,15 @@ Channel::Channel() :
     createdAt(""),
     invitedUsers(),
     channelMembers(),
+    memberSlots(),
     inviteOnly(false),
     topicRestricted(true),
     key(""),
     userLimit(-1),
-    operators()
+    operators(),
+    history(),
+    deliveries(),
+    ring()
 {}
 
 Channel::Channel(const std::string& name) : 
@@ -31,11 +35,15 @@ Channel::Channel(const std::string& name) :
     createdAt(""),
     invitedUsers(),
     channelMembers(),
+    memberSlots(),
     inviteOnly(false),
     topicRestricted(true),
     key(""),
     userLimit(-1),
-    operators()
+    operators(),
+    history(),
+    deliveries(),
+    ring()
 {
     std::time_t currentTime = std::time(NULL); 
     std::ostringstream oss;
@@ -54,11 +62,15 @@ Channel& Channel::operator=(const Channel& right){
         this->createdAt = right.createdAt;
         this->invitedUsers = right.invitedUsers;
         this->channelMembers = right.channelMembers;
+        this->memberSlots = right.memberSlots;
         this->inviteOnly = right.inviteOnly;           
         this->topicRestricted = right.topicRestricted;
         this->key = right.key;
         this->userLimit = right.userLimit;
         this->operators = right.operators;
+        this->history = right.history;
+        this->deliveries = right.deliveries;
+        this->ring = right.ring;
 	}
 	return (*this);
 }
@@ -75,7 +87,11 @@ Channel::~Channel(){}
  * @note add client fd to channelMembers set (list).
  */
 void Channel::addMember(int clientFd) {
-    channelMembers.insert(clientFd);
+    if (!channelMembers.insert(clientFd).second)
+        return;
+    Member member = {clientFd, HotClients::NO_SLOT, ring.getNextSeq()};
+    memberSlots.insert(memberSlots.begin() + memberIndex(clientFd), member);
+    ring.addReader();
 }
 
 /**
@@ -84,7 +100,11 @@ void Channel::addMember(int clientFd) {
  * @note If no operators remain in channel, the first member is promoted to operator.
  */
 int Channel::removeMember(int clientFd) {
-    channelMembers.erase(clientFd);
+    if (channelMembers.erase(clientFd)) {
+        std::vector<Member>::iterator member = memberSlots.begin() + memberIndex(clientFd);
+        ring.removeReader(clientFd, member->next);
+        memberSlots.erase(member);
+    }
     operators.erase(clientFd);
     invitedUsers.erase(clientFd);
     
@@ -108,6 +128,23 @@ bool Channel::hasMember(int clientFd) const {
     return found;
 }
 
+/**
+ * @brief Where a member is, or would go, in memberSlots (binary search on id).
+ */
+size_t Channel::memberIndex(int id) const {
+    size_t low = 0;
+    size_t high = memberSlots.size();
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (memberSlots[middle].id < id)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
 //Getter for private variable channelMembers.
 const std::set<int>& Channel::getMembers() const {
     return channelMembers;
@@ -121,6 +158,32 @@ size_t Channel::getMemberCount() const {
     return channelMembers.size();
 }
 
+/**
+ * @brief Give a member a new id, keeping its operator status and invite.
+ * @param oldId The id the member had.
+ * @param newId Its new id (e.g. the fd of the connection that resumed it).
+ */
+void Channel::replaceMember(int oldId, int newId) {
+    std::set<int>* sets[3] = {&channelMembers, &operators, &invitedUsers};
+    for (int i = 0; i < 3; i++) {
+        if (sets[i]->erase(oldId))
+            sets[i]->insert(newId);
+    }
+    size_t index = memberIndex(oldId);
+    if (index == memberSlots.size() || memberSlots[index].id != oldId)
+        return;
+    unsigned long next = memberSlots[index].next;
+    memberSlots.erase(memberSlots.begin() + index);
+    index = memberIndex(newId);
+    if (index < memberSlots.size() && memberSlots[index].id == newId) {
+        ring.removeReader(oldId, next);
+        return;
+    }
+    Member member = {newId, HotClients::NO_SLOT, next};
+    memberSlots.insert(memberSlots.begin() + index, member);
+    ring.replaceReader(oldId, newId, next);
+}
+
 /* ---------------------------------------------- */
 /*         Invitation Management                  */
 /* ---------------------------------------------- */
@@ -152,6 +215,11 @@ void Channel::removeInvite(int clientFd) {
     invitedUsers.erase(clientFd);
 }
 
+//Getter for private variable invitedUsers.
+const std::set<int>& Channel::getInvitedUsers() const {
+    return invitedUsers;
+}
+
 /* ---------------------------------------------- */
 /*          Operator Management                   */
 /* ---------------------------------------------- */
@@ -182,94 +250,362 @@ size_t Channel::getOperatorCount() const {
 /*            Broadcasting Messages               */
 /* ---------------------------------------------- */
 
+/*
+    A broadcast walks memberSlots, each member with the slot of its record
+    in HotClients: who gets the line (local, not excluded, which variant)
+    is decided from the records, one vector, and only the Client of an
+    actual recipient is touched, for its output queue. A slot gone stale
+    (the client left, its slot was reused) is looked up again by id and
+    kept for the next broadcast.
+
+    A channel in pull fan-out appends every broadcast to its ring instead,
+    in the order they come, with the members it is not for (see
+    ChannelRing.hpp). The delivered sets are filled at once, as if the
+    line had been queued.
+*/
+
 /**
- * @brief Sends a message to every member in the channel.
+ * @brief Queues a message for every member in the channel.
+ * @param clients The server's hot client records, through which the output queues are reached.
  * @param message The message to broadcast.
+ * @note Nothing is written here, the server flushes the queues once per loop.
+ * Members on other servers are skipped, the server relays to their links.
  */
-void Channel::broadcast(const std::string& message) {
-    std::set<int>::iterator it = channelMembers.begin();
-    std::set<int>::iterator end = channelMembers.end();
-
-    while (it != end) {
-        int clientfd = *it;
-        const char *msg = message.c_str();
-        channelSendMessage(clientfd, msg);
-        ++it;
-    }
+void Channel::broadcast(HotClients& clients, const std::string& message) {
+    broadcast(clients, message, -1);
 }
 
 
 /**
- * @brief Sends a message to every member in the channel except one (the sender obv)
+ * @brief Queues a message for every member in the channel except one (the sender obv)
+ * @param clients The server's hot client records, through which the output queues are reached.
  * @param message The message to broadcast.
  * @param excludeFd The file descriptor of the client to exclude.
  */
-void Channel::broadcast(const std::string& message, int excludeFd) {
-    std::set<int>::iterator it = channelMembers.begin();
-    std::set<int>::iterator end = channelMembers.end();
+void Channel::broadcast(HotClients& clients, const std::string& message, int excludeFd) {
+    size_t recipients = 0;
 
-    while (it != end) {
-        int clientfd = *it;
+    if (ring.isActive()) {
+        ring.append(TaggedLine(message, 0, 0), false, excludeFd);
+        return;
+    }
+    for (size_t i = 0; i < memberSlots.size(); i++) {
+        Member& member = memberSlots[i];
+
+        if (member.id != excludeFd) {
+            HotClient* hot = clients.find(member.id, member.slot);
+            if (hot && hot->link < 0) {
+                hot->client->queueOutput(message);
+                recipients++;
+            }
+        }
+    }
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+}
 
-        if (clientfd != excludeFd) {
-            const char *msg = message.c_str();
-            channelSendMessage(clientfd, msg);
+/**
+ * @brief Queues a message for every member that has not received it yet.
+ * @param clients The server's hot client records, through which the output queues are reached.
+ * @param message The message to broadcast.
+ * @param delivered Fds that already got the message, updated with the new ones.
+ * @note Used by multi-target PRIVMSG/NOTICE so a client in several of the
+ * targets gets the message once.
+ */
+void Channel::broadcast(HotClients& clients, const std::string& message, std::set<int>& delivered) {
+    size_t recipients = 0;
+
+    if (ring.isActive()) {
+        std::vector<int> excluded;
+        for (size_t i = 0; i < memberSlots.size(); i++) {
+            if (!delivered.insert(memberSlots[i].id).second)
+                excluded.push_back(memberSlots[i].id);
         }
-        ++it;
+        ring.append(TaggedLine(message, 0, 0), false, 0, excluded);
+        return;
     }
+    for (size_t i = 0; i < memberSlots.size(); i++) {
+        Member& member = memberSlots[i];
+        if (!delivered.insert(member.id).second)
+            continue;
+        HotClient* hot = clients.find(member.id, member.slot);
+        if (hot && hot->link < 0) {
+            hot->client->queueOutput(message);
+            recipients++;
+        }
+    }
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+}
+
+/**
+ * @brief Queues a message for every member with a capability that has not
+ * received it yet (e.g. AWAY for away-notify).
+ * @param clients The server's hot client records, through which the output queues are reached.
+ * @param message The message to broadcast.
+ * @param delivered Fds that already got the message, updated with the new ones.
+ * @param capability The CAP_* bit a member needs.
+ */
+void Channel::broadcast(HotClients& clients, const std::string& message, std::set<int>& delivered, unsigned int capability) {
+    std::vector<int> excluded;
+    size_t recipients = 0;
+
+    for (size_t i = 0; i < memberSlots.size(); i++) {
+        Member& member = memberSlots[i];
+        HotClient* hot = clients.find(member.id, member.slot);
+        if (!hot || hot->link >= 0 || !(hot->capabilities & capability))
+            continue;
+        if (!delivered.insert(member.id).second)
+            excluded.push_back(member.id);
+        else if (!ring.isActive()) {
+            hot->client->queueOutput(message);
+            recipients++;
+        }
+    }
+    if (ring.isActive()) {
+        ring.append(TaggedLine(message, 0, 0), false, capability, excluded);
+        return;
+    }
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+}
+
+/**
+ * @brief Queues a tagged message for every member that has not received it
+ * yet, each getting the variant for its capabilities.
+ * @param clients The server's hot client records, through which the output queues are reached.
+ * @param line The message, its variants are rendered on first use.
+ * @param delivered Fds that already got the message, updated with the new ones.
+ */
+void Channel::broadcast(HotClients& clients, TaggedLine& line, std::set<int>& delivered) {
+    size_t recipients = 0;
+
+    if (ring.isActive()) {
+        std::vector<int> excluded;
+        for (size_t i = 0; i < memberSlots.size(); i++) {
+            if (!delivered.insert(memberSlots[i].id).second)
+                excluded.push_back(memberSlots[i].id);
+        }
+        ring.append(line, true, 0, excluded);
+        return;
+    }
+    for (size_t i = 0; i < memberSlots.size(); i++) {
+        Member& member = memberSlots[i];
+        if (!delivered.insert(member.id).second)
+            continue;
+        HotClient* hot = clients.find(member.id, member.slot);
+        if (!hot || hot->link >= 0)
+            continue;
+        const std::string& rendered = line.render(hot->capabilities);
+        if (!rendered.empty()) {
+            hot->client->queueOutput(rendered);
+            recipients++;
+        }
+    }
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+}
+
+/**
+ * @brief Queues a tagged message for every member except one, each getting
+ * the variant for its capabilities.
+ * @param clients The server's hot client records, through which the output queues are reached.
+ * @param line The message, its variants are rendered on first use.
+ * @param excludeFd The file descriptor of the client to exclude.
+ * @note For a message with a single target, nobody can get it twice and
+ * there is no delivered set to fill.
+ */
+void Channel::broadcast(HotClients& clients, TaggedLine& line, int excludeFd) {
+    size_t recipients = 0;
+
+    if (ring.isActive()) {
+        ring.append(line, true, excludeFd);
+        return;
+    }
+    for (size_t i = 0; i < memberSlots.size(); i++) {
+        Member& member = memberSlots[i];
+        if (member.id == excludeFd)
+            continue;
+        HotClient* hot = clients.find(member.id, member.slot);
+        if (!hot || hot->link >= 0)
+            continue;
+        const std::string& rendered = line.render(hot->capabilities);
+        if (!rendered.empty()) {
+            hot->client->queueOutput(rendered);
+            recipients++;
+        }
+    }
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
 }
 
 /* ---------------------------------------------- */
-/*         Channel Info & Replies                 */
+/*            Pull Fan-out                        */
 /* ---------------------------------------------- */
 
 /**
- * @brief Generate the list of usernames with operators marked with @ prefix.
- * @param clientMap A map of client FDs with their Client objects with nicknames.
- * @return The formatted NAMES reply string.
- * @note Operators are prefixed with '@' in the reply e.g. @bob.
+ * @brief Switch to pull fan-out, the members read from the next message on.
  */
-std::string Channel::getNamesReply(const std::map<int, Client>& clientMap) const {
-    std::string names;
-    
-    // Loop through all operators first
-    for (std::set<int>::const_iterator it = operators.begin(); it != operators.end(); ++it) {
-        std::map<int, Client>::const_iterator clientIt = clientMap.find(*it);
-        if (clientIt != clientMap.end()) {
-            if (!names.empty()) names += " ";
-            names += "@" + clientIt->second.getNickname(); // give nickname with @ prefix for ops
-        }
+void Channel::startRing() {
+    ring.start(memberSlots.size());
+    for (size_t i = 0; i < memberSlots.size(); i++)
+        memberSlots[i].next = ring.getNextSeq();
+}
+
+/**
+ * @brief Back to push fan-out. Each member gets what it has not read yet,
+ * up to FANOUT_BATCH_BYTES more in its queue, and is told how many lines
+ * past that it missed.
+ * @param clients The server's hot client records.
+ * @return How many lines were skipped.
+ */
+unsigned long Channel::stopRing(HotClients& clients) {
+    size_t recipients = 0;
+    unsigned long skipped = 0;
+
+    for (size_t i = 0; i < memberSlots.size() && !ring.isCaughtUp(); i++) {
+        Member& member = memberSlots[i];
+        if (member.next >= ring.getNextSeq())
+            continue;
+        HotClient* hot = clients.find(member.id, member.slot);
+        size_t limit = hot ? hot->client->getOutputSize() + FANOUT_BATCH_BYTES : 0;
+        if (drainReader(hot, member, limit, recipients, skipped))
+            continue;
+        unsigned long missed = ring.skipAll(member.next);
+        noticeGap(*hot->client, missed);
+        skipped += missed;
     }
-    
-    // Regular members (exclude operators)
-    for (std::set<int>::const_iterator it = channelMembers.begin(); it != channelMembers.end(); ++it) {
-        if (operators.find(*it) != operators.end())
-            continue;  // Skip operators, already added
-        
-        std::map<int, Client>::const_iterator clientIt = clientMap.find(*it);
-        if (clientIt != clientMap.end()) {
-            if (!names.empty()) names += " ";
-            names += clientIt->second.getNickname(); // give nickname without @ prefix for reg
+    ring.stop();
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+    return (skipped);
+}
+
+// A local member whose queue is not under SENDQ_LOW_WATERMARK yet, it waits in the ring
+static bool isWaiting(const HotClient* hot) {
+    return (hot && hot->link < 0 && hot->client->getOutputSize() >= SENDQ_LOW_WATERMARK);
+}
+
+/**
+ * @brief Queue the ring lines the members have not read yet. A member only
+ * gets lines when its queue is under SENDQ_LOW_WATERMARK, up to
+ * FANOUT_BATCH_BYTES: it is served as fast as it reads, the others wait in
+ * the ring. A member that fell off the ring skips to its oldest line and
+ * is told how many it missed.
+ *
+ * After a new line every member is walked and those left behind are kept
+ * as stalled, until the next line only they are walked again.
+ * @param clients The server's hot client records.
+ * @return How many lines the members that fell off missed.
+ * @note A detached session waits like a member whose queue is full, it
+ * reads the rest once resumed.
+ */
+unsigned long Channel::drainRing(HotClients& clients) {
+    if (!ring.isActive() || ring.isCaughtUp())
+        return (0);
+    std::set<int>& stalled = ring.getStalled();
+    size_t recipients = 0;
+    unsigned long skipped = 0;
+
+    if (ring.hasNewLines()) {
+        stalled.clear();
+        for (size_t i = 0; i < memberSlots.size(); i++) {
+            Member& member = memberSlots[i];
+            if (member.next == ring.getNextSeq())
+                continue;
+            HotClient* hot = clients.find(member.id, member.slot);
+            if (isWaiting(hot) || !drainReader(hot, member, FANOUT_BATCH_BYTES, recipients, skipped))
+                stalled.insert(stalled.end(), member.id);
+        }
+    } else {
+        for (std::set<int>::iterator id = stalled.begin(); id != stalled.end();) {
+            size_t index = memberIndex(*id);
+            if (index == memberSlots.size() || memberSlots[index].id != *id) {
+                stalled.erase(id++);
+                continue;
+            }
+            Member& member = memberSlots[index];
+            HotClient* hot = clients.find(member.id, member.slot);
+            if (!isWaiting(hot) && drainReader(hot, member, FANOUT_BATCH_BYTES, recipients, skipped))
+                stalled.erase(id++);
+            else
+                ++id;
         }
     }
-    
-    // Build the full NAMES reply with proper format
-    std::string reply;
-    
-    // RPL_NAMREPLY (353): :server 353 nick = #channel :names
-    reply += ":" + SERVER_NAME + " 353 = " + channelName + " :" + names + CLDR;
-    
-    // RPL_ENDOFNAMES (366): :server 366 nick #channel :End of /NAMES list
-    reply += ":" + SERVER_NAME + " 366 " + channelName + " :End of /NAMES list" + CLDR;
-    
-    return reply;
+    ring.markDrained();
+    ring.trim();
+    HAI_PROBE2(broadcast, channelName.c_str(), recipients);
+    deliveries.add(recipients, currentTimeMs());
+    return (skipped);
+}
+
+/**
+ * @brief Queue everything one member has not read yet, at most the ring:
+ * a member that joins gets its JOIN before the replies to it, one that is
+ * leaving gets its PART or KICK before it stops reading.
+ * @param clients The server's hot client records.
+ * @param id The member.
+ * @return How many lines it missed, if it had fallen off the ring.
+ */
+unsigned long Channel::catchUpMember(HotClients& clients, int id) {
+    size_t index = memberIndex(id);
+    size_t recipients = 0;
+    unsigned long skipped = 0;
+
+    if (!ring.isActive() || index == memberSlots.size() || memberSlots[index].id != id)
+        return (0);
+    Member& member = memberSlots[index];
+    if (member.next == ring.getNextSeq())
+        return (0);
+    if (drainReader(clients.find(member.id, member.slot), member, std::numeric_limits<size_t>::max(), recipients, skipped))
+        ring.getStalled().erase(id);
+    deliveries.add(recipients, currentTimeMs());
+    return (skipped);
+}
+
+/**
+ * @brief Queue what one member has not read yet, until its queue reaches
+ * limit (see drainRing()).
+ * @return true once the member read everything.
+ */
+bool Channel::drainReader(HotClient* hot, Member& member, size_t limit, size_t& recipients, unsigned long& skipped) {
+    if (!hot || hot->link >= 0) {
+        ring.catchUp(member.next);
+        return (true);
+    }
+    unsigned long missed = ring.skipGap(member.next);
+    if (missed > 0) {
+        noticeGap(*hot->client, missed);
+        skipped += missed;
+    }
+    recipients += ring.read(member.next, member.id, *hot, limit);
+    return (member.next == ring.getNextSeq());
 }
 
-std::string Channel::getName() const {
+/**
+ * @brief Tell a member how many lines of the channel it lost.
+ */
+void Channel::noticeGap(Client& member, unsigned long missed) const {
+    std::ostringstream notice;
+
+    notice << ":" << SERVER_NAME << " " << WEECHAT_NOTICE << " " << member.getNickname() << " :"
+        << channelName << ": " << missed << " " << MSG_FANOUT_GAP << CLDR;
+    member.queueOutput(notice.str());
+}
+
+const ChannelRing& Channel::getRing() const {
+    return ring;
+}
+
+/* ---------------------------------------------- */
+/*         Channel Info & Replies                 */
+/* ---------------------------------------------- */
+
+const std::string& Channel::getName() const {
     return channelName;
 }
 
-std::string Channel::getTopic() const {
+const std::string& Channel::getTopic() const {
     return topic;
 }
 
@@ -289,7 +625,7 @@ bool Channel::isTopicRestricted() const {
     return topicRestricted;
 }
 
-std::string Channel::getKey() const {
+const std::string& Channel::getKey() const {
     return key;
 }
 
@@ -319,4 +655,31 @@ void Channel::setUserLimit(int limit) {
 
 void Channel::setTopic(const std::string& newTopic) {
     topic = newTopic;
-}
\ No newline at end of file
+}
+
+void Channel::setCreationTime(const std::string& time) {
+    createdAt = time;
+}
+
+/* ---------------------------------------------- */
+/*            Message History                     */
+/* ---------------------------------------------- */
+
+ChannelHistory& Channel::getHistory() {
+    return history;
+}
+
+const ChannelHistory& Channel::getHistory() const {
+    return history;
+}
+
+const RateMeter& Channel::getDeliveries() const {
+    return deliveries;
+}
+
+size_t Channel::getMemoryUsage() const {
+    size_t members = invitedUsers.size() + channelMembers.size() + operators.size();
+    return (stringBytes(channelName) + stringBytes(topic) + stringBytes(createdAt) + stringBytes(key) +
+        members * treeNodeBytes(sizeof(int)) + allocationBytes(memberSlots.capacity() * sizeof(Member)) +
+        ring.getMemoryUsage());
+}
@@ -0,0 +1,159 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelHistory.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/18 10:12:05 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/18 10:12:05 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ChannelHistory.hpp"
+
+ChannelHistory::ChannelHistory() :
+slots(),
+head(0),
+count(0),
+arena(),
+arenaStart(0),
+arenaBase(0),
+liveBytes(0)
+{}
+
+ChannelHistory::ChannelHistory(const ChannelHistory& right) {
+	*this = right;
+}
+
+ChannelHistory& ChannelHistory::operator=(const ChannelHistory& right) {
+	if (this != &right) {
+		this->slots = right.slots;
+		this->head = right.head;
+		this->count = right.count;
+		this->arena = right.arena;
+		this->arenaStart = right.arenaStart;
+		this->arenaBase = right.arenaBase;
+		this->liveBytes = right.liveBytes;
+	}
+	return (*this);
+}
+
+ChannelHistory::~ChannelHistory() {}
+
+const ChannelHistory::Entry&	ChannelHistory::at(size_t index) const {
+	return (this->slots[(this->head + index) % this->slots.size()]);
+}
+
+/**
+ * @brief Add a line (without CRLF), dropping the oldest one if the ring is
+ * full.
+ * @param time Wall clock of the message in ms, never smaller than the last.
+ * @param msgid Id of the message, never smaller than the last.
+ * @param line The line as it was relayed.
+ */
+void	ChannelHistory::append(unsigned long time, unsigned long msgid, const std::string& line) {
+	if (this->slots.empty())
+		this->slots.resize(HISTORY_LENGTH);
+	if (this->count == this->slots.size())
+		dropOldest();
+
+	Entry& entry = this->slots[(this->head + this->count) % this->slots.size()];
+	entry.time = time;
+	entry.msgid = msgid;
+	entry.offset = this->arenaBase + this->arena.size();
+	entry.length = line.length();
+	this->arena.insert(this->arena.end(), line.begin(), line.end());
+	this->liveBytes += line.length();
+	this->count++;
+}
+
+void	ChannelHistory::dropOldest(void) {
+	if (this->count == 0)
+		return;
+	const Entry& oldest = this->slots[this->head];
+	this->arenaStart += oldest.length;
+	this->liveBytes -= oldest.length;
+	this->head = (this->head + 1) % this->slots.size();
+	this->count--;
+
+	if (this->count == 0) {
+		// A channel evicted by the budget gives its memory back
+		this->arenaBase += this->arena.size();
+		std::vector<char>().swap(this->arena);
+		std::vector<Entry>().swap(this->slots);
+		this->head = 0;
+		this->arenaStart = 0;
+	} else if (this->arenaStart > this->liveBytes) {
+		this->arena.erase(this->arena.begin(), this->arena.begin() + this->arenaStart);
+		this->arenaBase += this->arenaStart;
+		this->arenaStart = 0;
+	}
+}
+
+bool	ChannelHistory::isEmpty(void) const {return (this->count == 0);}
+size_t	ChannelHistory::getCount(void) const {return (this->count);}
+
+// What the entries hold, the figure charged against HISTORY_BUDGET
+size_t	ChannelHistory::getMemoryUsage(void) const {
+	return (this->liveBytes + this->count * sizeof(Entry));
+}
+
+// What the ring and the arena take from the heap, dead bytes included
+size_t	ChannelHistory::getHeapUsage(void) const {
+	return (allocationBytes(this->slots.capacity() * sizeof(Entry)) + allocationBytes(this->arena.capacity()));
+}
+
+unsigned long	ChannelHistory::getOldestMsgid(void) const {
+	return (this->count == 0 ? 0 : at(0).msgid);
+}
+
+/**
+ * @param index 0 is the oldest entry.
+ */
+const ChannelHistory::Entry&	ChannelHistory::getEntry(size_t index) const {
+	return (at(index));
+}
+
+std::string	ChannelHistory::getLine(size_t index) const {
+	const Entry& entry = at(index);
+	const char *start = &this->arena[entry.offset - this->arenaBase];
+	return (std::string(start, entry.length));
+}
+
+/**
+ * @brief Index of the first entry at or after time, getCount() if none.
+ */
+size_t	ChannelHistory::lowerBoundTime(unsigned long time) const {
+	size_t low = 0;
+	size_t high = this->count;
+
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (at(middle).time < time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return (low);
+}
+
+/**
+ * @brief Index of the entry with msgid, getCount() if it is not (or no
+ * longer) in the history.
+ */
+size_t	ChannelHistory::findMsgid(unsigned long msgid) const {
+	size_t low = 0;
+	size_t high = this->count;
+
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (at(middle).msgid < msgid)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low < this->count && at(low).msgid == msgid)
+		return (low);
+	return (this->count);
+}
@@ -0,0 +1,245 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelLogger.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/19 09:31:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/19 09:31:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ChannelLogger.hpp"
+
+// [record length][channel length][time], then the channel and the line
+static const size_t	RECORD_HEADER = 2 * sizeof(unsigned int) + sizeof(unsigned long);
+
+ChannelLogger::ChannelLogger() :
+directory(""),
+ring(),
+head(0),
+tail(0),
+running(false),
+started(false),
+thread(),
+dropped(0),
+linesWritten(),
+bytesWritten(),
+dropping(false),
+segments()
+{}
+
+ChannelLogger::~ChannelLogger() {
+	stop();
+}
+
+/**
+ * @brief Create the log directory and start the writer thread.
+ * @param dir The log directory.
+ * @throw ChannelLoggerException if the directory can't be created or the
+ * thread can't be started.
+ */
+void	ChannelLogger::open(const std::string& dir) {
+	if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)
+		throw (ChannelLogger::ChannelLoggerException("Cannot create log directory " + dir + ": " + std::strerror(errno)));
+	this->directory = dir;
+	this->ring.assign(LOG_QUEUE_BYTES, 0);
+	this->head = 0;
+	this->tail = 0;
+	this->running = true;
+
+	// Signals must reach the event loop, where they interrupt poll()
+	sigset_t all;
+	sigset_t previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	int error = pthread_create(&this->thread, NULL, &ChannelLogger::run, this);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (error != 0)
+		throw (ChannelLogger::ChannelLoggerException(std::string("Cannot start the log writer: ") + std::strerror(error)));
+	this->started = true;
+}
+
+/**
+ * @brief Let the writer commit what is queued and wait for it to finish.
+ */
+void	ChannelLogger::stop(void) {
+	if (!this->started)
+		return;
+	__atomic_store_n(&this->running, false, __ATOMIC_RELEASE);
+	pthread_join(this->thread, NULL);
+	this->started = false;
+	for (std::map<std::string, Segment>::iterator it = this->segments.begin(); it != this->segments.end(); ++it) {
+		if (it->second.fd >= 0)
+			close(it->second.fd);
+	}
+	this->segments.clear();
+	if (this->dropped > 0)
+		std::cerr << "Channel logs: " << this->dropped << " lines dropped (queue full)" << std::endl;
+}
+
+bool			ChannelLogger::isEnabled(void) const {return (this->started);}
+unsigned long	ChannelLogger::getDropped(void) const {return (this->dropped);}
+unsigned long	ChannelLogger::getLinesWritten(void) const {return (this->linesWritten.load());}
+unsigned long	ChannelLogger::getBytesWritten(void) const {return (this->bytesWritten.load());}
+
+/**
+ * @brief Queue a line of a channel. Never blocks: a full queue drops the
+ * line. Only called from the event loop.
+ * @param channel The channel.
+ * @param line The line, without CRLF.
+ * @return false if the line was dropped.
+ */
+bool	ChannelLogger::append(const std::string& channel, const std::string& line) {
+	if (!this->started)
+		return (false);
+	size_t needed = RECORD_HEADER + channel.length() + line.length();
+	unsigned long freed = __atomic_load_n(&this->head, __ATOMIC_ACQUIRE);
+	if (needed > this->ring.size() - (this->tail - freed)) {
+		if (!this->dropping)
+			std::cerr << "Channel logs: queue full, dropping lines" << std::endl;
+		this->dropping = true;
+		this->dropped++;
+		return (false);
+	}
+	this->dropping = false;
+
+	char header[RECORD_HEADER];
+	unsigned int recordLength = needed;
+	unsigned int channelLength = channel.length();
+	unsigned long time = wallTimeMs();
+	std::memcpy(header, &recordLength, sizeof(recordLength));
+	std::memcpy(header + sizeof(recordLength), &channelLength, sizeof(channelLength));
+	std::memcpy(header + 2 * sizeof(unsigned int), &time, sizeof(time));
+
+	const char *parts[3] = {header, channel.data(), line.data()};
+	size_t lengths[3] = {RECORD_HEADER, channel.length(), line.length()};
+	unsigned long position = this->tail;
+	for (int i = 0; i < 3; i++) {
+		size_t offset = position & (this->ring.size() - 1);
+		size_t first = std::min(lengths[i], this->ring.size() - offset);
+		std::memcpy(&this->ring[offset], parts[i], first);
+		std::memcpy(&this->ring[0], parts[i] + first, lengths[i] - first);
+		position += lengths[i];
+	}
+	__atomic_store_n(&this->tail, position, __ATOMIC_RELEASE);
+	return (true);
+}
+
+void	ChannelLogger::copyOut(unsigned long position, char *data, size_t length) const {
+	size_t offset = position & (this->ring.size() - 1);
+	size_t first = std::min(length, this->ring.size() - offset);
+	std::memcpy(data, &this->ring[offset], first);
+	std::memcpy(data + first, &this->ring[0], length - first);
+}
+
+void	*ChannelLogger::run(void *self) {
+	static_cast<ChannelLogger *>(self)->writerLoop();
+	return (NULL);
+}
+
+void	ChannelLogger::writerLoop(void) {
+	while (true) {
+		// Read before committing: whatever was queued before stop() is committed below
+		bool stopping = !__atomic_load_n(&this->running, __ATOMIC_ACQUIRE);
+		if (commitQueued() == 0) {
+			if (stopping)
+				break;
+			usleep(LOG_FLUSH_MS * 1000);
+		}
+	}
+}
+
+/**
+ * @brief The name of a channel in its segment files, <name>.<start ms>.log.
+ */
+std::string	ChannelLogger::fileName(const std::string& channel) {
+	std::string name = channel;
+	for (size_t i = 0; i < name.length(); i++) {
+		if (name[i] == '/' || static_cast<unsigned char>(name[i]) < 32)
+			name[i] = '_';
+	}
+	return (name);
+}
+
+/**
+ * @brief The segment a channel's next lines go to, starting a new one when
+ * they would not fit in the current one.
+ */
+ChannelLogger::Segment&	ChannelLogger::segmentFor(const std::string& channel, size_t incoming) {
+	std::map<std::string, Segment>::iterator it = this->segments.find(channel);
+	if (it != this->segments.end() && it->second.size > 0 && it->second.size + incoming > LOG_SEGMENT_BYTES) {
+		if (it->second.fd >= 0)
+			close(it->second.fd);
+		this->segments.erase(it);
+		it = this->segments.end();
+	}
+	if (it != this->segments.end())
+		return (it->second);
+
+	std::ostringstream path;
+	path << this->directory << "/" << fileName(channel) << "." << wallTimeMs() << ".log";
+	Segment segment;
+	segment.fd = ::open(path.str().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	segment.size = 0;
+	if (segment.fd < 0)
+		std::cerr << "Channel logs: cannot open " << path.str() << ": " << std::strerror(errno) << std::endl;
+	return (this->segments[channel] = segment);
+}
+
+/**
+ * @brief Take everything queued and commit it: one write() and one
+ * fdatasync() per channel, however many lines arrived since the last round.
+ * @return The number of lines committed.
+ */
+size_t	ChannelLogger::commitQueued(void) {
+	unsigned long end = __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE);
+	unsigned long position = this->head;
+	std::map<std::string, std::string> batches;
+	size_t records = 0;
+
+	while (position < end) {
+		char header[RECORD_HEADER];
+		unsigned int recordLength;
+		unsigned int channelLength;
+		unsigned long time;
+		copyOut(position, header, RECORD_HEADER);
+		std::memcpy(&recordLength, header, sizeof(recordLength));
+		std::memcpy(&channelLength, header + sizeof(recordLength), sizeof(channelLength));
+		std::memcpy(&time, header + 2 * sizeof(unsigned int), sizeof(time));
+
+		std::string channel(channelLength, '\0');
+		std::string line(recordLength - RECORD_HEADER - channelLength, '\0');
+		copyOut(position + RECORD_HEADER, &channel[0], channelLength);
+		if (!line.empty())
+			copyOut(position + RECORD_HEADER + channelLength, &line[0], line.length());
+		batches[channel] += "[" + formatServerTime(time) + "] " + line + "\n";
+		position += recordLength;
+		records++;
+	}
+	// The loop gets the room back before the disk work starts
+	__atomic_store_n(&this->head, position, __ATOMIC_RELEASE);
+
+	for (std::map<std::string, std::string>::iterator it = batches.begin(); it != batches.end(); ++it) {
+		Segment& segment = segmentFor(it->first, it->second.length());
+		if (segment.fd >= 0 && !writeAll(segment.fd, it->second.data(), it->second.length()))
+			std::cerr << "Channel logs: write failed for " << it->first << ": " << std::strerror(errno) << std::endl;
+		segment.size += it->second.length();
+		this->bytesWritten.add(it->second.length());
+	}
+	this->linesWritten.add(records);
+	for (std::map<std::string, std::string>::iterator it = batches.begin(); it != batches.end(); ++it) {
+		const Segment& segment = this->segments[it->first];
+		if (segment.fd >= 0)
+			fdatasync(segment.fd);
+	}
+	return (records);
+}
+
+ChannelLogger::ChannelLoggerException::ChannelLoggerException(const std::string& message) : message(message) {}
+ChannelLogger::ChannelLoggerException::~ChannelLoggerException() throw() {}
+
+const char* ChannelLogger::ChannelLoggerException::what() const throw() {
+	return (this->message.c_str());
+}
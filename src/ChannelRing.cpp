@@ -0,0 +1,253 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelRing.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/05 14:05:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2026/01/05 14:05:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ChannelRing.hpp"
+
+ChannelRing::Entry::Entry(const TaggedLine& line, bool tagged, unsigned int capability) :
+line(line), tagged(tagged), capability(capability), excluded() {}
+
+ChannelRing::ChannelRing() :
+entries(),
+firstSeq(0),
+active(false),
+readers(0),
+lagging(0),
+stalled(),
+appended(false)
+{}
+
+ChannelRing::ChannelRing(const ChannelRing& right) :
+entries(right.entries),
+firstSeq(right.firstSeq),
+active(right.active),
+readers(right.readers),
+lagging(right.lagging),
+stalled(right.stalled),
+appended(right.appended)
+{}
+
+ChannelRing& ChannelRing::operator=(const ChannelRing& right) {
+	if (this != &right) {
+		this->entries = right.entries;
+		this->firstSeq = right.firstSeq;
+		this->active = right.active;
+		this->readers = right.readers;
+		this->lagging = right.lagging;
+		this->stalled = right.stalled;
+		this->appended = right.appended;
+	}
+	return (*this);
+}
+
+ChannelRing::~ChannelRing() {}
+
+bool			ChannelRing::isActive(void) const {return (this->active);}
+bool			ChannelRing::isCaughtUp(void) const {return (this->lagging == 0);}
+unsigned long	ChannelRing::getNextSeq(void) const {return (this->firstSeq + this->entries.size());}
+size_t			ChannelRing::getLength(void) const {return (this->entries.size());}
+size_t			ChannelRing::getLagging(void) const {return (this->lagging);}
+std::set<int>&	ChannelRing::getStalled(void) {return (this->stalled);}
+bool			ChannelRing::hasNewLines(void) const {return (this->appended);}
+void			ChannelRing::markDrained(void) {this->appended = false;}
+
+/**
+ * @brief Heap bytes of the lines, their rendered variants and exclusions,
+ * and the stalled readers.
+ */
+size_t	ChannelRing::getMemoryUsage(void) const {
+	size_t bytes = this->stalled.size() * treeNodeBytes(sizeof(int)) + dequeBytes(this->entries.size(), sizeof(Entry));
+
+	for (size_t i = 0; i < this->entries.size(); i++)
+		bytes += this->entries[i].line.getMemoryUsage() + allocationBytes(this->entries[i].excluded.capacity() * sizeof(int));
+	return (bytes);
+}
+
+/**
+ * @brief Switch the channel to pull fan-out, every member starts reading
+ * at the next line (see Channel::startRing()).
+ * @param readers How many members read the ring.
+ */
+void	ChannelRing::start(size_t readers) {
+	this->active = true;
+	this->readers = readers;
+	this->lagging = 0;
+	this->stalled.clear();
+	this->appended = false;
+}
+
+/**
+ * @brief Back to push fan-out. The lines not read yet are dropped, the
+ * channel hands them out first (see Channel::stopRing()).
+ */
+void	ChannelRing::stop(void) {
+	this->active = false;
+	this->firstSeq = getNextSeq();
+	this->entries.clear();
+	this->readers = 0;
+	this->lagging = 0;
+	this->stalled.clear();
+	this->appended = false;
+}
+
+/**
+ * @brief Add a line for every reader but excludeId (-1 for nobody).
+ */
+void	ChannelRing::append(const TaggedLine& line, bool tagged, int excludeId) {
+	std::vector<int> excluded;
+
+	if (excludeId >= 0)
+		excluded.push_back(excludeId);
+	append(line, tagged, 0, excluded);
+}
+
+/**
+ * @brief Add a line for the readers with capability (0 for all) that are
+ * not in excluded. The oldest line goes when the ring is full.
+ * @param excluded Reader ids, sorted.
+ */
+void	ChannelRing::append(const TaggedLine& line, bool tagged, unsigned int capability, const std::vector<int>& excluded) {
+	if (this->entries.size() == FANOUT_RING_LINES) {
+		this->entries.pop_front();
+		this->firstSeq++;
+	}
+	this->entries.push_back(Entry(line, tagged, capability));
+	this->entries.back().excluded = excluded;
+	// Nobody read past the previous last line, everybody is behind this one
+	this->lagging = this->readers;
+	this->appended = true;
+}
+
+/**
+ * @brief A new member, it reads from the next line on.
+ */
+void	ChannelRing::addReader(void) {
+	if (this->active)
+		this->readers++;
+}
+
+/**
+ * @brief A member leaves, with what it had not read.
+ * @param next The seq it would have read next.
+ */
+void	ChannelRing::removeReader(int id, unsigned long next) {
+	if (!this->active)
+		return;
+	this->readers--;
+	if (next < getNextSeq())
+		this->lagging--;
+	this->stalled.erase(id);
+}
+
+/**
+ * @brief Give a reader a new id (see Channel::replaceMember()): the lines
+ * it has not read yet that were not for it still aren't.
+ * @param next The seq it reads next.
+ */
+void	ChannelRing::replaceReader(int oldId, int newId, unsigned long next) {
+	for (unsigned long seq = std::max(next, this->firstSeq); seq < getNextSeq(); seq++) {
+		std::vector<int>& excluded = this->entries[seq - this->firstSeq].excluded;
+		std::vector<int>::iterator it = std::lower_bound(excluded.begin(), excluded.end(), oldId);
+		if (it == excluded.end() || *it != oldId)
+			continue;
+		excluded.erase(it);
+		excluded.insert(std::lower_bound(excluded.begin(), excluded.end(), newId), newId);
+	}
+	if (this->stalled.erase(oldId) > 0)
+		this->stalled.insert(newId);
+}
+
+/**
+ * @brief Move a reader that fell off the ring to the oldest line kept.
+ * @param next The reader's next seq, updated.
+ * @return How many lines it lost, 0 if it lost none.
+ */
+unsigned long	ChannelRing::skipGap(unsigned long& next) {
+	if (next >= this->firstSeq)
+		return (0);
+	unsigned long missed = this->firstSeq - next;
+	next = this->firstSeq;
+	if (next == getNextSeq())
+		this->lagging--;
+	return (missed);
+}
+
+/**
+ * @brief Queue the lines a reader has not read yet, in order, until its
+ * output queue reaches limit. skipGap() must have been called first.
+ * @param next The reader's next seq, updated.
+ * @param reader The reader's id, the lines excluding it are skipped.
+ * @param client The reader, gets the variant for its capabilities.
+ * @param limit Output queue size to stop at.
+ * @return How many lines were queued.
+ */
+unsigned long	ChannelRing::read(unsigned long& next, int reader, HotClient& client, size_t limit) {
+	unsigned long last = getNextSeq();
+	unsigned long lines = 0;
+
+	if (next >= last)
+		return (0);
+	while (next < last && client.client->getOutputSize() < limit) {
+		Entry& entry = this->entries[next - this->firstSeq];
+		next++;
+		if (entry.capability != 0 && !(client.capabilities & entry.capability))
+			continue;
+		if (!entry.excluded.empty() && std::binary_search(entry.excluded.begin(), entry.excluded.end(), reader))
+			continue;
+		const std::string& rendered = entry.tagged ? entry.line.render(client.capabilities) : entry.line.getLine();
+		if (!rendered.empty()) {
+			client.client->queueOutput(rendered);
+			lines++;
+		}
+	}
+	if (next == last)
+		this->lagging--;
+	return (lines);
+}
+
+/**
+ * @brief Drop what a reader has not read yet, when the channel goes back
+ * to push and the reader couldn't take it (see Channel::stopRing()).
+ * @param next The reader's next seq, updated.
+ * @return How many lines it lost.
+ */
+unsigned long	ChannelRing::skipAll(unsigned long& next) {
+	unsigned long last = getNextSeq();
+
+	if (next >= last)
+		return (0);
+	unsigned long missed = last - next;
+	this->lagging--;
+	next = last;
+	return (missed);
+}
+
+/**
+ * @brief Mark every line read without queueing them, for a reader that
+ * has no queue on this server (a remote user, reached through its link).
+ */
+void	ChannelRing::catchUp(unsigned long& next) {
+	unsigned long last = getNextSeq();
+
+	if (next < last)
+		this->lagging--;
+	next = last;
+}
+
+/**
+ * @brief Let the lines go once every reader has them.
+ */
+void	ChannelRing::trim(void) {
+	if (this->lagging != 0 || this->entries.empty())
+		return;
+	this->firstSeq = getNextSeq();
+	this->entries.clear();
+}
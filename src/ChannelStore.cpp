@@ -0,0 +1,374 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelStore.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/14 11:25:37 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/14 11:25:37 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ChannelStore.hpp"
+
+ChannelStore::ChannelStore() :
+directory(""),
+journalFd(-1),
+journalSize(0),
+dirtyChannels(),
+jobs(),
+busy(false),
+running(false),
+started(false),
+thread()
+{
+	pthread_mutex_init(&this->lock, NULL);
+	pthread_cond_init(&this->wakeup, NULL);
+	pthread_cond_init(&this->idle, NULL);
+}
+
+ChannelStore::~ChannelStore() {
+	stop();
+	pthread_cond_destroy(&this->idle);
+	pthread_cond_destroy(&this->wakeup);
+	pthread_mutex_destroy(&this->lock);
+	if (this->journalFd >= 0)
+		close(this->journalFd);
+}
+
+std::string	ChannelStore::filePath(const std::string& name) const {
+	return (this->directory + "/" + name);
+}
+
+bool	ChannelStore::isEnabled(void) const {return (this->journalFd >= 0);}
+
+static void	writeChannel(StateWriter& writer, const Channel& chan) {
+	writer.putString(chan.getName());
+	writer.putString(chan.getTopic());
+	writer.putString(chan.getCreationTime());
+	writer.putBool(chan.isInviteOnly());
+	writer.putBool(chan.isTopicRestricted());
+	writer.putString(chan.getKey());
+	writer.putSigned(chan.getUserLimit());
+}
+
+// Every field is read before the channel is touched, a cut record changes nothing
+static void	readChannel(StateReader& reader, std::map<std::string, Channel>& channels) {
+	std::string	name = reader.getString();
+	std::string	topic = reader.getString();
+	std::string	createdAt = reader.getString();
+	bool		inviteOnly = reader.getBool();
+	bool		topicRestricted = reader.getBool();
+	std::string	key = reader.getString();
+	int			userLimit = static_cast<int>(reader.getSigned());
+
+	std::map<std::string, Channel>::iterator it = channels.find(name);
+	if (it == channels.end())
+		it = channels.insert(std::make_pair(name, Channel(name))).first;
+	Channel& chan = it->second;
+	chan.setTopic(topic);
+	chan.setCreationTime(createdAt);
+	chan.setInviteOnly(inviteOnly);
+	chan.setTopicRestricted(topicRestricted);
+	chan.setKey(key);
+	chan.setUserLimit(userLimit);
+}
+
+/*
+	Read only private mapping of a whole file, NULL for an empty or missing
+	one. Parsing straight from the page cache avoids copying the file.
+*/
+static const char	*mapFile(const std::string& path, size_t& size) {
+	size = 0;
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return (NULL);
+	struct stat info;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		size = static_cast<size_t>(info.st_size);
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) {
+		size = 0;
+		return (NULL);
+	}
+	return (static_cast<const char *>(data));
+}
+
+/**
+ * @brief Use stateDirectory for the snapshot and the journal, creating it
+ * if needed, and start the writer thread.
+ * @throw ChannelStoreException if the directory or the journal can't be
+ * opened or the thread can't be started.
+ */
+void	ChannelStore::open(const std::string& stateDirectory) {
+	if (mkdir(stateDirectory.c_str(), 0700) < 0 && errno != EEXIST)
+		throw (ChannelStore::ChannelStoreException("Cannot create state directory " + stateDirectory + ": " + std::strerror(errno)));
+	this->directory = stateDirectory;
+	this->journalFd = ::open(filePath(CHANNEL_JOURNAL_FILE).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (this->journalFd < 0)
+		throw (ChannelStore::ChannelStoreException("Cannot open " + filePath(CHANNEL_JOURNAL_FILE) + ": " + std::strerror(errno)));
+	struct stat info;
+	this->journalSize = (fstat(this->journalFd, &info) == 0) ? static_cast<size_t>(info.st_size) : 0;
+	this->running = true;
+
+	// Signals must reach the event loop, where they interrupt poll()
+	sigset_t all;
+	sigset_t previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	int error = pthread_create(&this->thread, NULL, &ChannelStore::run, this);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (error != 0)
+		throw (ChannelStore::ChannelStoreException(std::string("Cannot start the channel store writer: ") + std::strerror(error)));
+	this->started = true;
+}
+
+/**
+ * @brief Let the writer write what is queued and wait for it to finish.
+ */
+void	ChannelStore::stop(void) {
+	if (!this->started)
+		return;
+	pthread_mutex_lock(&this->lock);
+	this->running = false;
+	pthread_cond_signal(&this->wakeup);
+	pthread_mutex_unlock(&this->lock);
+	pthread_join(this->thread, NULL);
+	this->started = false;
+}
+
+/**
+ * @brief Wait until everything queued is on disk, before another process
+ * reads the files (see Server::upgrade()).
+ */
+void	ChannelStore::sync(void) {
+	if (!this->started)
+		return;
+	pthread_mutex_lock(&this->lock);
+	while (!this->jobs.empty() || this->busy)
+		pthread_cond_wait(&this->idle, &this->lock);
+	pthread_mutex_unlock(&this->lock);
+}
+
+/**
+ * @brief Apply the snapshot then the journal to channels. Channels that are
+ * not in the config are created.
+ * @return How many channel records were applied.
+ * @throw ChannelStoreException if the snapshot is corrupt, nothing is
+ * compacted over it then.
+ */
+size_t	ChannelStore::load(std::map<std::string, Channel>& channels) {
+	size_t	applied = 0;
+	size_t	size;
+
+	if (!isEnabled())
+		return (0);
+	const char *snapshot = mapFile(filePath(CHANNEL_SNAPSHOT_FILE), size);
+	if (snapshot) {
+		try {
+			StateReader reader(snapshot, size);
+			if (reader.getString() != CHANNEL_SNAPSHOT_MAGIC)
+				throw (StateReader::CorruptStateException());
+			size_t count = reader.getNumber();
+			for (; applied < count; applied++)
+				readChannel(reader, channels);
+		} catch (StateReader::CorruptStateException& err) {
+			munmap(const_cast<char *>(snapshot), size);
+			throw (ChannelStore::ChannelStoreException(filePath(CHANNEL_SNAPSHOT_FILE) + ": " + err.what()));
+		}
+		munmap(const_cast<char *>(snapshot), size);
+	}
+	return (applied + replayJournal(channels));
+}
+
+/*
+	Replay the framed records of the journal in order. Runs before anything
+	is queued, the writer doesn't touch the journal yet. A record cut by a
+	crash ends the replay and is cut off the file, so later appends don't
+	land behind garbage.
+*/
+size_t	ChannelStore::replayJournal(std::map<std::string, Channel>& channels) {
+	size_t	applied = 0;
+	size_t	size;
+	size_t	valid = 0;
+
+	const char *journal = mapFile(filePath(CHANNEL_JOURNAL_FILE), size);
+	if (!journal)
+		return (0);
+	StateReader frames(journal, size);
+	try {
+		while (!frames.atEnd()) {
+			std::string record = frames.getString();
+			StateReader reader(record.data(), record.size());
+			readChannel(reader, channels);
+			valid = frames.getPosition();
+			applied++;
+		}
+	} catch (StateReader::CorruptStateException&) {
+		std::cerr << filePath(CHANNEL_JOURNAL_FILE) << ": dropped a truncated record" << std::endl;
+		if (ftruncate(this->journalFd, valid) == 0)
+			this->journalSize = valid;
+	}
+	munmap(const_cast<char *>(journal), size);
+	return (applied);
+}
+
+void	ChannelStore::markDirty(const std::string& channelName) {
+	if (isEnabled())
+		this->dirtyChannels.insert(channelName);
+}
+
+/**
+ * @brief Queue the channels changed since the last commit for the journal,
+ * as a single job. Called once per loop iteration, after the replies have
+ * been flushed. Queues a snapshot instead once the journal is larger than
+ * JOURNAL_COMPACT_BYTES.
+ * @param channels The server's channels.
+ */
+void	ChannelStore::commit(const std::map<std::string, Channel>& channels) {
+	if (this->dirtyChannels.empty())
+		return;
+	StateWriter journal;
+	for (std::set<std::string>::iterator it = this->dirtyChannels.begin(); it != this->dirtyChannels.end(); ++it) {
+		std::map<std::string, Channel>::const_iterator chanIt = channels.find(*it);
+		if (chanIt == channels.end())
+			continue;
+		StateWriter record;
+		writeChannel(record, chanIt->second);
+		journal.putString(record.getData());
+	}
+	this->dirtyChannels.clear();
+	if (journal.getData().empty())
+		return;
+	enqueue(false, journal.getData());
+	this->journalSize += journal.getData().size();
+	if (this->journalSize > JOURNAL_COMPACT_BYTES)
+		compact(channels);
+}
+
+/**
+ * @brief Queue every channel as a new snapshot, the writer then empties
+ * the journal.
+ * @param channels The server's channels.
+ */
+void	ChannelStore::compact(const std::map<std::string, Channel>& channels) {
+	if (!isEnabled())
+		return;
+	StateWriter snapshot;
+	snapshot.putString(CHANNEL_SNAPSHOT_MAGIC);
+	snapshot.putNumber(channels.size());
+	for (std::map<std::string, Channel>::const_iterator it = channels.begin(); it != channels.end(); ++it)
+		writeChannel(snapshot, it->second);
+	enqueue(true, snapshot.getData());
+	this->journalSize = 0;
+	this->dirtyChannels.clear();
+}
+
+/*
+	Hand a job to the writer, the lock is only held for the push. Without
+	a writer (it failed to start, or stopped) the job is written here.
+*/
+void	ChannelStore::enqueue(bool snapshot, const std::string& data) {
+	Job job;
+	job.snapshot = snapshot;
+	job.data = data;
+	if (!this->started) {
+		writeJobs(std::vector<Job>(1, job));
+		return;
+	}
+	pthread_mutex_lock(&this->lock);
+	this->jobs.push_back(job);
+	pthread_cond_signal(&this->wakeup);
+	pthread_mutex_unlock(&this->lock);
+}
+
+void	*ChannelStore::run(void *self) {
+	static_cast<ChannelStore *>(self)->writerLoop();
+	return (NULL);
+}
+
+void	ChannelStore::writerLoop(void) {
+	pthread_mutex_lock(&this->lock);
+	while (true) {
+		while (this->jobs.empty() && this->running)
+			pthread_cond_wait(&this->wakeup, &this->lock);
+		// Whatever was queued before stop() is written first
+		if (this->jobs.empty())
+			break;
+		std::vector<Job> batch;
+		batch.swap(this->jobs);
+		this->busy = true;
+		pthread_mutex_unlock(&this->lock);
+		writeJobs(batch);
+		pthread_mutex_lock(&this->lock);
+		this->busy = false;
+		pthread_cond_broadcast(&this->idle);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+/**
+ * @brief Write a round of jobs, in the order they were queued. The records
+ * queued before the last snapshot are in it: once it is written they are
+ * dropped, and what came after goes to the emptied journal with one write
+ * and one fdatasync.
+ */
+void	ChannelStore::writeJobs(const std::vector<Job>& batch) {
+	size_t first = 0;
+	for (size_t i = batch.size(); i-- > 0; ) {
+		if (batch[i].snapshot) {
+			if (writeSnapshot(batch[i].data))
+				first = i + 1;
+			break;
+		}
+	}
+	std::string records;
+	for (size_t i = first; i < batch.size(); i++) {
+		if (!batch[i].snapshot)
+			records += batch[i].data;
+	}
+	if (records.empty())
+		return;
+	if (!writeAll(this->journalFd, records.data(), records.size()) || fdatasync(this->journalFd) < 0)
+		std::cerr << "\033[1;31mChannel journal write failed: " << std::strerror(errno) << "\033[0m" << std::endl;
+}
+
+/**
+ * @brief Replace the snapshot and empty the journal. The snapshot is
+ * replaced with rename(), so a crash leaves the old snapshot and the
+ * journal, never half a file.
+ * @return false if the snapshot could not be written, the journal is kept.
+ */
+bool	ChannelStore::writeSnapshot(const std::string& data) {
+	std::string path = filePath(CHANNEL_SNAPSHOT_FILE);
+	std::string temporary = path + ".tmp";
+	int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	bool written = fd >= 0 && writeAll(fd, data.data(), data.size()) && fsync(fd) == 0;
+	if (fd >= 0)
+		close(fd);
+	if (!written || rename(temporary.c_str(), path.c_str()) < 0) {
+		std::cerr << "\033[1;31mChannel snapshot write failed: " << std::strerror(errno) << "\033[0m" << std::endl;
+		unlink(temporary.c_str());
+		return (false);
+	}
+	// The rename itself must be on disk before the journal goes
+	int dirFd = ::open(this->directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (dirFd >= 0) {
+		fsync(dirFd);
+		close(dirFd);
+	}
+	if (ftruncate(this->journalFd, 0) < 0)
+		std::cerr << "\033[1;31mChannel journal truncate failed: " << std::strerror(errno) << "\033[0m" << std::endl;
+	return (true);
+}
+
+ChannelStore::ChannelStoreException::ChannelStoreException(const std::string& message) : message(message) {}
+ChannelStore::ChannelStoreException::~ChannelStoreException() throw() {}
+
+const char* ChannelStore::ChannelStoreException::what() const throw() {
+	return (this->message.c_str());
+}
@@ -13,49 +13,120 @@
 # include "../includes/Client.hpp"
 
 Client::Client() :
+link(-1),
+capabilities(0),
+prefix("!"),
+outputQueue(""),
+passwordAuthenticated(false),
+nicknameSet(false),
+userSet(false),
+capNegotiating(false),
+pingSent(false),
+serverOperator(false),
 username(""),
 nickname(""),
 realname(""),
 hostname(""),
-passwordAuthenticated(false),
-nicknameSet(false),
-userSet(false)
-{}
+address(0),
+connectionClass(0),
+floodTokens(0),
+lastFloodRefill(0),
+awayMessage(""),
+sessionToken(""),
+lastActivity(0),
+linesIn(),
+linesOut(),
+linkState(LINK_NONE),
+serverName(""),
+linkPassword(""),
+nicknameTs(0)
+{
+# if __cplusplus >= 201103L
+	static_assert(offsetof(Client, outputQueue) < CACHE_LINE_BYTES, "the fields a broadcast reads must start in the first cache line");
+# endif
+}
 
 Client::~Client(){}
 
 Client::Client(const Client& right) :
+link(right.link),
+capabilities(right.capabilities),
+prefix(right.prefix),
+outputQueue(right.outputQueue),
+passwordAuthenticated(right.passwordAuthenticated),
+nicknameSet(right.nicknameSet),
+userSet(right.userSet),
+capNegotiating(right.capNegotiating),
+pingSent(right.pingSent),
+serverOperator(right.serverOperator),
 username(right.username),
 nickname(right.nickname),
 realname(right.realname),
 hostname(right.hostname),
-passwordAuthenticated(right.passwordAuthenticated),
-nicknameSet(right.nicknameSet),
-userSet(right.userSet)
+address(right.address),
+connectionClass(right.connectionClass),
+floodTokens(right.floodTokens),
+lastFloodRefill(right.lastFloodRefill),
+awayMessage(right.awayMessage),
+sessionToken(right.sessionToken),
+lastActivity(right.lastActivity),
+linesIn(right.linesIn),
+linesOut(right.linesOut),
+linkState(right.linkState),
+serverName(right.serverName),
+linkPassword(right.linkPassword),
+nicknameTs(right.nicknameTs)
 {}
 
 Client& Client::operator=(const Client& right){
 	if (this != &right){
+		this->link = right.link;
+		this->capabilities = right.capabilities;
+		this->prefix = right.prefix;
+		this->outputQueue = right.outputQueue;
+		this->passwordAuthenticated = right.passwordAuthenticated;
+		this->nicknameSet = right.nicknameSet;
+		this->userSet = right.userSet;
+		this->capNegotiating = right.capNegotiating;
+		this->pingSent = right.pingSent;
+		this->serverOperator = right.serverOperator;
 		this->username = right.username;
 		this->nickname = right.nickname;
 		this->realname = right.realname;
 		this->hostname = right.hostname;
-		this->passwordAuthenticated = right.passwordAuthenticated;
-		this->nicknameSet = right.nicknameSet;
-		this->userSet = right.userSet;
+		this->address = right.address;
+		this->connectionClass = right.connectionClass;
+		this->floodTokens = right.floodTokens;
+		this->lastFloodRefill = right.lastFloodRefill;
+		this->awayMessage = right.awayMessage;
+		this->sessionToken = right.sessionToken;
+		this->lastActivity = right.lastActivity;
+		this->linesIn = right.linesIn;
+		this->linesOut = right.linesOut;
+		this->linkState = right.linkState;
+		this->serverName = right.serverName;
+		this->linkPassword = right.linkPassword;
+		this->nicknameTs = right.nicknameTs;
 	}
 	return (*this);
 }
 
 // Getters
-std::string	Client::getNickname(void) const {return (this->nickname);}
-std::string	Client::getUsername(void) const {return (this->username);}
-std::string	Client::getRealname(void) const {return (this->realname);}
-std::string	Client::getHostname(void) const {return (this->hostname);}
-
-// Setters
-void	Client::setNickname(const std::string &nNickname) {this->nickname = nNickname;}
-void	Client::setUsername(const std::string &nUsername) {this->username = nUsername;}
+const std::string&	Client::getNickname(void) const {return (this->nickname);}
+const std::string&	Client::getUsername(void) const {return (this->username);}
+const std::string&	Client::getRealname(void) const {return (this->realname);}
+const std::string&	Client::getHostname(void) const {return (this->hostname);}
+const std::string&	Client::getPrefix(void) const {return (this->prefix);}
+
+// Setters, the prefix follows the nickname and the username
+void	Client::setNickname(const std::string &nNickname) {
+	this->nickname = nNickname;
+	this->prefix = this->nickname + "!" + this->username;
+}
+void	Client::setUsername(const std::string &nUsername) {
+	this->username = nUsername;
+	this->prefix = this->nickname + "!" + this->username;
+}
 void	Client::setRealname(const std::string &nRealname) {this->realname = nRealname;}
 void	Client::setHostname(const std::string &nHostname) {this->hostname = nHostname;}
 
@@ -71,5 +142,95 @@ bool	Client::isUserSet(void) const {return (this->userSet);}
 
 // Check if client has completed full registration (PASS + NICK + USER)
 bool	Client::isFullyRegistered(void) const {
-	return (this->passwordAuthenticated && this->nicknameSet && this->userSet);
+	return (this->passwordAuthenticated && this->nicknameSet && this->userSet && !this->capNegotiating);
+}
+
+// Connection class
+in_addr_t	Client::getAddress(void) const {return (this->address);}
+void		Client::setAddress(in_addr_t nAddress) {this->address = nAddress;}
+size_t		Client::getConnectionClass(void) const {return (this->connectionClass);}
+void		Client::setConnectionClass(size_t nConnectionClass) {this->connectionClass = nConnectionClass;}
+
+/**
+ * @brief Token bucket flood control. The bucket holds at most burst commands
+ * and regains rate commands per second. A command is let through as long as
+ * one whole token is left and then costs its full penalty, so a long line can
+ * put the client in debt (RFC 1459 8.10 style penalty).
+ * @param nowMs The current monotonic time in milliseconds.
+ * @param rate Commands regained per second.
+ * @param burst Bucket size in commands.
+ * @param cost Penalty of the command in whole tokens.
+ * @return false if the command must wait.
+ */
+bool	Client::takeFloodTokens(unsigned long nowMs, unsigned int rate, unsigned int burst, unsigned int cost) {
+	long capacity = static_cast<long>(burst) * 1000;
+
+	if (this->lastFloodRefill == 0)
+		this->floodTokens = capacity;
+	else
+		this->floodTokens += static_cast<long>((nowMs - this->lastFloodRefill) * rate);
+	if (this->floodTokens > capacity)
+		this->floodTokens = capacity;
+	this->lastFloodRefill = nowMs;
+	if (this->floodTokens < 1000)
+		return (false);
+	this->floodTokens -= static_cast<long>(cost) * 1000;
+	return (true);
+}
+
+// Output queue, drained by the server whenever the socket is writable
+void				Client::queueOutput(const std::string &message) {this->outputQueue += message;}
+const std::string&	Client::getOutput(void) const {return (this->outputQueue);}
+void				Client::consumeOutput(size_t bytes) {this->outputQueue.erase(0, bytes);}
+size_t				Client::getOutputSize(void) const {return (this->outputQueue.size());}
+bool				Client::hasPendingOutput(void) const {return (!this->outputQueue.empty());}
+
+// Capabilities and away
+unsigned int		Client::getCapabilities(void) const {return (this->capabilities);}
+void				Client::setCapabilities(unsigned int nCapabilities) {this->capabilities = nCapabilities;}
+bool				Client::hasCapability(unsigned int capability) const {return ((this->capabilities & capability) != 0);}
+bool				Client::isCapNegotiating(void) const {return (this->capNegotiating);}
+void				Client::setCapNegotiating(bool negotiating) {this->capNegotiating = negotiating;}
+const std::string&	Client::getAwayMessage(void) const {return (this->awayMessage);}
+void				Client::setAwayMessage(const std::string &nAwayMessage) {this->awayMessage = nAwayMessage;}
+bool				Client::isAway(void) const {return (!this->awayMessage.empty());}
+const std::string&	Client::getSessionToken(void) const {return (this->sessionToken);}
+void				Client::setSessionToken(const std::string &nSessionToken) {this->sessionToken = nSessionToken;}
+
+// Keepalive, any input answers a PING
+void				Client::markActive(unsigned long nowMs) {
+	this->lastActivity = nowMs;
+	this->pingSent = false;
+}
+unsigned long		Client::getLastActivity(void) const {return (this->lastActivity);}
+bool				Client::isPingSent(void) const {return (this->pingSent);}
+void				Client::setPingSent(bool sent) {this->pingSent = sent;}
+
+// Traffic
+void				Client::countLinesIn(unsigned long lines, unsigned long nowMs) {this->linesIn.add(lines, nowMs);}
+void				Client::countLinesOut(unsigned long lines, unsigned long nowMs) {this->linesOut.add(lines, nowMs);}
+const RateMeter&	Client::getLinesIn(void) const {return (this->linesIn);}
+const RateMeter&	Client::getLinesOut(void) const {return (this->linesOut);}
+
+// Server links
+Client::LinkState	Client::getLinkState(void) const {return (this->linkState);}
+void				Client::setLinkState(LinkState nLinkState) {this->linkState = nLinkState;}
+bool				Client::isServer(void) const {return (this->linkState != LINK_NONE);}
+int					Client::getLink(void) const {return (this->link);}
+void				Client::setLink(int nLink) {this->link = nLink;}
+bool				Client::isRemote(void) const {return (this->link >= 0);}
+const std::string&	Client::getServerName(void) const {return (this->serverName);}
+void				Client::setServerName(const std::string &nServerName) {this->serverName = nServerName;}
+const std::string&	Client::getLinkPassword(void) const {return (this->linkPassword);}
+void				Client::setLinkPassword(const std::string &nLinkPassword) {this->linkPassword = nLinkPassword;}
+unsigned long		Client::getNicknameTs(void) const {return (this->nicknameTs);}
+void				Client::setNicknameTs(unsigned long nNicknameTs) {this->nicknameTs = nNicknameTs;}
+
+bool				Client::isServerOperator(void) const {return (this->serverOperator);}
+void				Client::setServerOperator(bool nServerOperator) {this->serverOperator = nServerOperator;}
+
+size_t				Client::getMemoryUsage(void) const {
+	return (stringBytes(this->prefix) + stringBytes(this->username) + stringBytes(this->nickname) + stringBytes(this->realname) +
+		stringBytes(this->hostname) + stringBytes(this->awayMessage) + stringBytes(this->sessionToken) +
+		stringBytes(this->serverName) + stringBytes(this->linkPassword));
 }
@@ -0,0 +1,290 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/09 20:03:11 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/09 20:03:11 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Config.hpp"
+
+Config::Config() :
+path(""),
+listenAddress(SERVER_IP),
+maxClients(NUMBER_OF_CLIENTS),
+bufferSize(BUFFER_SIZE),
+pollTimeout(MS_TIMEOUT),
+stateDir(""),
+channels(),
+logDir(""),
+loggedChannels(),
+classes(),
+serverName(DEFAULT_SERVER_NAME),
+links(),
+operators(),
+sessionGrace(DEFAULT_SESSION_GRACE),
+metricsAddress(""),
+metricsPort(0),
+adminSocket(""),
+capture(""),
+memoryBudget(0),
+fanoutRing(DEFAULT_FANOUT_RING)
+{
+	this->channels.push_back("#general");
+	this->channels.push_back("#random");
+	this->channels.push_back("#help");
+	this->channels.push_back("#admins");
+
+	ConnectionClass defaultClass(DEFAULT_CLASS_NAME);
+	defaultClass.setCidr(DEFAULT_CLASS_CIDR);
+	this->classes.push_back(defaultClass);
+}
+
+Config::Config(const Config& right) {
+	*this = right;
+}
+
+Config& Config::operator=(const Config& right) {
+	if (this != &right) {
+		this->path = right.path;
+		this->listenAddress = right.listenAddress;
+		this->maxClients = right.maxClients;
+		this->bufferSize = right.bufferSize;
+		this->pollTimeout = right.pollTimeout;
+		this->stateDir = right.stateDir;
+		this->channels = right.channels;
+		this->logDir = right.logDir;
+		this->loggedChannels = right.loggedChannels;
+		this->classes = right.classes;
+		this->serverName = right.serverName;
+		this->links = right.links;
+		this->operators = right.operators;
+		this->sessionGrace = right.sessionGrace;
+		this->metricsAddress = right.metricsAddress;
+		this->metricsPort = right.metricsPort;
+		this->adminSocket = right.adminSocket;
+		this->capture = right.capture;
+		this->memoryBudget = right.memoryBudget;
+		this->fanoutRing = right.fanoutRing;
+	}
+	return (*this);
+}
+
+Config::~Config() {}
+
+static std::string	lineError(size_t lineNumber, const std::string& message) {
+	std::ostringstream oss;
+	oss << "Config line " << lineNumber << ": " << message;
+	return (oss.str());
+}
+
+static unsigned long	parseNumber(const std::string& word, size_t lineNumber) {
+	if (word.empty() || word.find_first_not_of("0123456789") != std::string::npos)
+		throw (Config::InvalidConfigException(lineError(lineNumber, "'" + word + "' is not a number")));
+	return (std::strtoul(word.c_str(), NULL, 10));
+}
+
+/**
+ * @brief Read the config file. Nothing is changed if the file is invalid,
+ * so a bad edit followed by SIGHUP keeps the running settings.
+ * @param filePath The config file.
+ * @throw InvalidConfigException if the file can't be read or is invalid.
+ */
+void	Config::load(const std::string& filePath) {
+	std::ifstream file(filePath.c_str());
+	if (!file.is_open())
+		throw (Config::InvalidConfigException("Cannot open config file " + filePath));
+
+	Config parsed;
+	parsed.path = filePath;
+	parsed.channels.clear();
+	parsed.classes.clear();
+
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		// Channel names start with '#' too, so only whole lines are comments
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+			continue;
+
+		std::vector<std::string> words;
+		std::istringstream iss(line);
+		std::string word;
+		while (iss >> word)
+			words.push_back(word);
+		if (!words.empty())
+			parsed.parseLine(words, lineNumber);
+	}
+	// Channels are only created from here, keep the defaults if none is listed
+	if (parsed.channels.empty())
+		parsed.channels = Config().channels;
+	if (parsed.classes.empty())
+		parsed.classes = Config().classes;
+	*this = parsed;
+}
+
+void	Config::parseLine(const std::vector<std::string>& words, size_t lineNumber) {
+	const std::string& directive = words[0];
+
+	if (directive == "class") {
+		parseClass(words, lineNumber);
+		return;
+	}
+	if (directive == "link") {
+		parseLink(words, lineNumber);
+		return;
+	}
+	// oper <name> <password>
+	if (directive == "oper") {
+		if (words.size() != 3)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "usage: oper <name> <password>")));
+		this->operators[words[1]] = words[2];
+		return;
+	}
+	// metrics <address> <port>
+	if (directive == "metrics") {
+		in_addr parsed;
+		if (words.size() != 3 || inet_aton(words[1].c_str(), &parsed) == 0)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "usage: metrics <address> <port>")));
+		unsigned long port = parseNumber(words[2], lineNumber);
+		if (port == 0 || port > static_cast<unsigned long>(MAX_PORTS))
+			throw (Config::InvalidConfigException(lineError(lineNumber, "invalid metrics port " + words[2])));
+		this->metricsAddress = words[1];
+		this->metricsPort = static_cast<int>(port);
+		return;
+	}
+	// channel <name> log
+	if (directive == "channel" && words.size() == 3 && words[2] == "log") {
+		this->loggedChannels.insert(words[1]);
+		parseLine(std::vector<std::string>(words.begin(), words.end() - 1), lineNumber);
+		return;
+	}
+	if (words.size() != 2)
+		throw (Config::InvalidConfigException(lineError(lineNumber, directive + " takes exactly one value")));
+	const std::string& value = words[1];
+
+	if (directive == "listen") {
+		in_addr parsed;
+		if (inet_aton(value.c_str(), &parsed) == 0)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "invalid listen address " + value)));
+		this->listenAddress = value;
+	} else if (directive == "max_clients") {
+		this->maxClients = parseNumber(value, lineNumber);
+		if (this->maxClients == 0)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "max_clients must be positive")));
+	} else if (directive == "buffer_size") {
+		this->bufferSize = parseNumber(value, lineNumber);
+		if (this->bufferSize < 2)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "buffer_size is too small")));
+	} else if (directive == "poll_timeout") {
+		this->pollTimeout = static_cast<int>(parseNumber(value, lineNumber));
+	} else if (directive == "server_name") {
+		if (value.find('.') == std::string::npos || value.find_first_of(":!@,") != std::string::npos)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "server_name needs a dot, e.g. irc1." + value)));
+		this->serverName = value;
+	} else if (directive == "session_grace") {
+		this->sessionGrace = parseNumber(value, lineNumber);
+	} else if (directive == "admin_socket") {
+		if (value.length() >= sizeof(sockaddr_un().sun_path))
+			throw (Config::InvalidConfigException(lineError(lineNumber, "admin_socket path is too long")));
+		this->adminSocket = value;
+	} else if (directive == "memory_budget") {
+		this->memoryBudget = parseNumber(value, lineNumber);
+	} else if (directive == "fanout_ring") {
+		this->fanoutRing = parseNumber(value, lineNumber);
+	} else if (directive == "capture") {
+		this->capture = value;
+	} else if (directive == "state_dir") {
+		this->stateDir = value;
+	} else if (directive == "log_dir") {
+		this->logDir = value;
+	} else if (directive == "channel") {
+		if (WEECHAT_CHANNEL_PREFIX.find(value[0]) == std::string::npos)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "invalid channel name " + value)));
+		this->channels.push_back(value);
+	} else
+		throw (Config::InvalidConfigException(lineError(lineNumber, "unknown directive " + directive)));
+}
+
+// class <name> <cidr> [key=value]...
+void	Config::parseClass(const std::vector<std::string>& words, size_t lineNumber) {
+	if (words.size() < 3)
+		throw (Config::InvalidConfigException(lineError(lineNumber, "class needs a name and a CIDR")));
+
+	ConnectionClass connectionClass(words[1]);
+	if (!connectionClass.setCidr(words[2]))
+		throw (Config::InvalidConfigException(lineError(lineNumber, "invalid CIDR " + words[2])));
+	for (size_t i = 3; i < words.size(); i++) {
+		size_t equal = words[i].find('=');
+		if (equal == std::string::npos)
+			throw (Config::InvalidConfigException(lineError(lineNumber, "expected key=value, got " + words[i])));
+		std::string key = words[i].substr(0, equal);
+		std::string value = words[i].substr(equal + 1);
+
+		if (key == "password")
+			connectionClass.setPassword(value);
+		else if (key == "recvq")
+			connectionClass.setRecvQ(parseNumber(value, lineNumber));
+		else if (key == "sendq")
+			connectionClass.setSendQ(parseNumber(value, lineNumber));
+		else if (key == "burst")
+			connectionClass.setFloodBurst(parseNumber(value, lineNumber));
+		else if (key == "rate")
+			connectionClass.setFloodRate(parseNumber(value, lineNumber));
+		else if (key == "max_clients")
+			connectionClass.setMaxClients(parseNumber(value, lineNumber));
+		else if (key == "exempt" && (value == "yes" || value == "no"))
+			connectionClass.setExempt(value == "yes");
+		else
+			throw (Config::InvalidConfigException(lineError(lineNumber, "invalid class option " + words[i])));
+	}
+	this->classes.push_back(connectionClass);
+}
+
+// link <server name> <ip> <port> <password> [autoconnect]
+void	Config::parseLink(const std::vector<std::string>& words, size_t lineNumber) {
+	if (words.size() != 5 && !(words.size() == 6 && words[5] == "autoconnect"))
+		throw (Config::InvalidConfigException(lineError(lineNumber, "usage: link <server name> <ip> <port> <password> [autoconnect]")));
+	in_addr parsed;
+	if (inet_aton(words[2].c_str(), &parsed) == 0)
+		throw (Config::InvalidConfigException(lineError(lineNumber, "invalid link address " + words[2])));
+	unsigned long port = parseNumber(words[3], lineNumber);
+	if (port == 0 || port > static_cast<unsigned long>(MAX_PORTS))
+		throw (Config::InvalidConfigException(lineError(lineNumber, "invalid link port " + words[3])));
+	this->links.push_back(LinkBlock(words[1], words[2], static_cast<int>(port), words[4], words.size() == 6));
+}
+
+// Getters
+const std::string&					Config::getPath(void) const {return (this->path);}
+const std::string&					Config::getListenAddress(void) const {return (this->listenAddress);}
+unsigned int						Config::getMaxClients(void) const {return (this->maxClients);}
+size_t								Config::getBufferSize(void) const {return (this->bufferSize);}
+int									Config::getPollTimeout(void) const {return (this->pollTimeout);}
+const std::string&					Config::getStateDir(void) const {return (this->stateDir);}
+const std::vector<std::string>&		Config::getChannels(void) const {return (this->channels);}
+const std::string&					Config::getLogDir(void) const {return (this->logDir);}
+const std::set<std::string>&		Config::getLoggedChannels(void) const {return (this->loggedChannels);}
+const std::vector<ConnectionClass>&	Config::getClasses(void) const {return (this->classes);}
+const std::string&					Config::getServerName(void) const {return (this->serverName);}
+const std::vector<LinkBlock>&		Config::getLinks(void) const {return (this->links);}
+const std::map<std::string, std::string>&	Config::getOperators(void) const {return (this->operators);}
+unsigned long						Config::getSessionGrace(void) const {return (this->sessionGrace);}
+const std::string&					Config::getMetricsAddress(void) const {return (this->metricsAddress);}
+int									Config::getMetricsPort(void) const {return (this->metricsPort);}
+const std::string&					Config::getAdminSocket(void) const {return (this->adminSocket);}
+const std::string&					Config::getCapture(void) const {return (this->capture);}
+size_t								Config::getMemoryBudget(void) const {return (this->memoryBudget);}
+size_t								Config::getFanoutRing(void) const {return (this->fanoutRing);}
+
+Config::InvalidConfigException::InvalidConfigException(const std::string& message) : message(message) {}
+Config::InvalidConfigException::~InvalidConfigException() throw() {}
+
+const char* Config::InvalidConfigException::what() const throw() {
+	return (this->message.c_str());
+}
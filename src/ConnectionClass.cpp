@@ -0,0 +1,123 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionClass.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/07 16:21:40 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/07 16:21:40 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ConnectionClass.hpp"
+
+ConnectionClass::ConnectionClass() :
+name(DEFAULT_CLASS_NAME),
+network(0),
+netmask(0),
+password(""),
+recvQ(DEFAULT_RECVQ),
+sendQ(DEFAULT_SENDQ),
+floodBurst(DEFAULT_FLOOD_BURST),
+floodRate(DEFAULT_FLOOD_RATE),
+maxClients(0),
+exempt(false)
+{}
+
+ConnectionClass::ConnectionClass(const std::string& name) :
+name(name),
+network(0),
+netmask(0),
+password(""),
+recvQ(DEFAULT_RECVQ),
+sendQ(DEFAULT_SENDQ),
+floodBurst(DEFAULT_FLOOD_BURST),
+floodRate(DEFAULT_FLOOD_RATE),
+maxClients(0),
+exempt(false)
+{}
+
+ConnectionClass::ConnectionClass(const ConnectionClass& right) {
+	*this = right;
+}
+
+ConnectionClass& ConnectionClass::operator=(const ConnectionClass& right) {
+	if (this != &right) {
+		this->name = right.name;
+		this->network = right.network;
+		this->netmask = right.netmask;
+		this->password = right.password;
+		this->recvQ = right.recvQ;
+		this->sendQ = right.sendQ;
+		this->floodBurst = right.floodBurst;
+		this->floodRate = right.floodRate;
+		this->maxClients = right.maxClients;
+		this->exempt = right.exempt;
+	}
+	return (*this);
+}
+
+ConnectionClass::~ConnectionClass() {}
+
+// Getters
+const std::string&	ConnectionClass::getName(void) const {return (this->name);}
+const std::string&	ConnectionClass::getPassword(void) const {return (this->password);}
+size_t				ConnectionClass::getRecvQ(void) const {return (this->recvQ);}
+size_t				ConnectionClass::getSendQ(void) const {return (this->sendQ);}
+unsigned int		ConnectionClass::getFloodBurst(void) const {return (this->floodBurst);}
+unsigned int		ConnectionClass::getFloodRate(void) const {return (this->floodRate);}
+unsigned int		ConnectionClass::getMaxClients(void) const {return (this->maxClients);}
+bool				ConnectionClass::isExempt(void) const {return (this->exempt);}
+
+// Setters
+void	ConnectionClass::setPassword(const std::string& nPassword) {this->password = nPassword;}
+void	ConnectionClass::setRecvQ(size_t nRecvQ) {this->recvQ = nRecvQ;}
+void	ConnectionClass::setSendQ(size_t nSendQ) {this->sendQ = nSendQ;}
+void	ConnectionClass::setFloodBurst(unsigned int nFloodBurst) {this->floodBurst = nFloodBurst;}
+void	ConnectionClass::setFloodRate(unsigned int nFloodRate) {this->floodRate = nFloodRate;}
+void	ConnectionClass::setMaxClients(unsigned int nMaxClients) {this->maxClients = nMaxClients;}
+void	ConnectionClass::setExempt(bool nExempt) {this->exempt = nExempt;}
+
+/**
+ * @brief Set the source addresses of the class, e.g. "10.0.0.0/8".
+ * A plain address means /32.
+ * @param cidr The network in CIDR notation.
+ * @return false if the string is not a valid IPv4 CIDR.
+ */
+bool	ConnectionClass::setCidr(const std::string& cidr) {
+	size_t slash = cidr.find('/');
+	std::string address = cidr.substr(0, slash);
+	int bits = 32;
+
+	if (slash != std::string::npos) {
+		std::string bitsStr = cidr.substr(slash + 1);
+		if (bitsStr.empty() || bitsStr.find_first_not_of("0123456789") != std::string::npos)
+			return (false);
+		bits = std::atoi(bitsStr.c_str());
+		if (bits > 32)
+			return (false);
+	}
+	in_addr parsed;
+	if (inet_aton(address.c_str(), &parsed) == 0)
+		return (false);
+	// Shifting a 32 bit value by 32 is undefined, /0 is handled apart
+	this->netmask = (bits == 0) ? 0 : (0xFFFFFFFFu << (32 - bits));
+	this->network = ntohl(parsed.s_addr) & this->netmask;
+	return (true);
+}
+
+bool	ConnectionClass::matchesAddress(in_addr_t address) const {
+	return ((address & this->netmask) == this->network);
+}
+
+/**
+ * @brief Whether a connection from address that sent pass belongs here.
+ * @param address The peer address in host byte order.
+ * @param pass The password given with PASS, empty before registration.
+ */
+bool	ConnectionClass::matches(in_addr_t address, const std::string& pass) const {
+	if (!matchesAddress(address))
+		return (false);
+	return (this->password.empty() || this->password == pass);
+}
@@ -0,0 +1,86 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   HotClients.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/04 11:12:30 by hamalmar          #+#    #+#             */
+/*   Updated: 2026/01/04 11:12:30 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/HotClients.hpp"
+
+HotClients::HotClients(std::map<int, Client>& clientMap) : clientMap(clientMap), records(), freeSlots(), slots() {}
+
+HotClients::~HotClients() {}
+
+/**
+ * @brief The record of a client, made from clientMap on first use.
+ * @param id The client's id.
+ * @param slot Where the caller last saw it, NO_SLOT if never; updated.
+ * @return The record, NULL (and slot NO_SLOT) for an id not in clientMap.
+ */
+HotClient*	HotClients::find(int id, size_t& slot) {
+	if (slot < this->records.size() && this->records[slot].id == id)
+		return (&this->records[slot]);
+	std::map<int, size_t>::iterator it = this->slots.find(id);
+	if (it != this->slots.end()){
+		slot = it->second;
+		return (&this->records[slot]);
+	}
+	std::map<int, Client>::iterator clientIt = this->clientMap.find(id);
+	if (clientIt == this->clientMap.end()){
+		slot = NO_SLOT;
+		return (NULL);
+	}
+	if (!this->freeSlots.empty()){
+		slot = this->freeSlots.back();
+		this->freeSlots.pop_back();
+	}
+	else {
+		slot = this->records.size();
+		this->records.push_back(HotClient());
+	}
+	HotClient& record = this->records[slot];
+	record.id = id;
+	record.link = clientIt->second.getLink();
+	record.capabilities = clientIt->second.getCapabilities();
+	record.client = &clientIt->second;
+	this->slots[id] = slot;
+	return (&record);
+}
+
+/**
+ * @brief Copy link and capabilities again after the client changed them.
+ */
+void	HotClients::refresh(int id) {
+	std::map<int, size_t>::iterator it = this->slots.find(id);
+	std::map<int, Client>::iterator clientIt = this->clientMap.find(id);
+
+	if (it == this->slots.end() || clientIt == this->clientMap.end())
+		return ;
+	this->records[it->second].link = clientIt->second.getLink();
+	this->records[it->second].capabilities = clientIt->second.getCapabilities();
+}
+
+/**
+ * @brief Drop the record of a client leaving clientMap, its slot is reused.
+ */
+void	HotClients::erase(int id) {
+	std::map<int, size_t>::iterator it = this->slots.find(id);
+
+	if (it == this->slots.end())
+		return ;
+	this->records[it->second].id = -1;
+	this->records[it->second].client = NULL;
+	this->freeSlots.push_back(it->second);
+	this->slots.erase(it);
+}
+
+size_t	HotClients::getMemoryUsage(void) const {
+	return (allocationBytes(this->records.capacity() * sizeof(HotClient))
+		+ allocationBytes(this->freeSlots.capacity() * sizeof(size_t))
+		+ this->slots.size() * treeNodeBytes(sizeof(std::pair<const int, size_t>)));
+}
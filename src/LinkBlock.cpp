@@ -0,0 +1,52 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LinkBlock.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/16 19:02:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/16 19:02:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/LinkBlock.hpp"
+
+LinkBlock::LinkBlock() :
+name(""),
+host(""),
+port(0),
+password(""),
+autoconnect(false)
+{}
+
+LinkBlock::LinkBlock(const std::string& name, const std::string& host, int port, const std::string& password, bool autoconnect) :
+name(name),
+host(host),
+port(port),
+password(password),
+autoconnect(autoconnect)
+{}
+
+LinkBlock::LinkBlock(const LinkBlock& right) {
+	*this = right;
+}
+
+LinkBlock& LinkBlock::operator=(const LinkBlock& right) {
+	if (this != &right) {
+		this->name = right.name;
+		this->host = right.host;
+		this->port = right.port;
+		this->password = right.password;
+		this->autoconnect = right.autoconnect;
+	}
+	return (*this);
+}
+
+LinkBlock::~LinkBlock() {}
+
+const std::string&	LinkBlock::getName(void) const {return (this->name);}
+const std::string&	LinkBlock::getHost(void) const {return (this->host);}
+int					LinkBlock::getPort(void) const {return (this->port);}
+const std::string&	LinkBlock::getPassword(void) const {return (this->password);}
+bool				LinkBlock::isAutoconnect(void) const {return (this->autoconnect);}
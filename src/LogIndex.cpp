@@ -0,0 +1,614 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LogIndex.cpp                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/20 10:05:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/20 10:05:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/LogIndex.hpp"
+
+static const char	INDEX_MAGIC[8] = {'H', 'A', 'I', 'I', 'D', 'X', '1', '\0'};
+
+// Lines are read from the segments this much at a time
+static const size_t	READ_CHUNK = 1048576;
+static const size_t	LINE_MAX_BYTES = 4096;
+
+struct IndexHeader {
+	char			magic[8];
+	unsigned long	covered;
+	unsigned long	terms;
+	unsigned long	postings;
+};
+
+struct IndexTerm {
+	unsigned long	word;    // Offset of the word in the file
+	unsigned long	first;   // Index of its first posting
+	unsigned int	length;
+	unsigned int	count;
+};
+
+// Segments of every channel, oldest first, by the channel's file name
+typedef std::map<std::string, std::vector<std::pair<unsigned long, std::string> > >	SegmentMap;
+
+LogIndex::LogIndex() :
+directory(""),
+running(false),
+started(false),
+thread(),
+requests(),
+results(),
+nextTicket(0),
+outstanding(0),
+pending(),
+complete()
+{
+	pthread_mutex_init(&this->lock, NULL);
+}
+
+LogIndex::~LogIndex() {
+	stop();
+	pthread_mutex_destroy(&this->lock);
+}
+
+/**
+ * @brief Start the indexer thread on a log directory.
+ * @param dir The log directory, created by the ChannelLogger.
+ * @throw LogIndexException if the thread can't be started.
+ */
+void	LogIndex::open(const std::string& dir) {
+	this->directory = dir;
+	this->running = true;
+
+	// Signals must reach the event loop, where they interrupt poll()
+	sigset_t all;
+	sigset_t previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &previous);
+	int error = pthread_create(&this->thread, NULL, &LogIndex::run, this);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (error != 0)
+		throw (LogIndex::LogIndexException(std::string("Cannot start the log indexer: ") + std::strerror(error)));
+	this->started = true;
+}
+
+/**
+ * @brief Stop the indexer, a pass in progress stops after its current
+ * chunk. What was not written yet is indexed again by the next run.
+ */
+void	LogIndex::stop(void) {
+	if (!this->started)
+		return;
+	__atomic_store_n(&this->running, false, __ATOMIC_RELEASE);
+	pthread_join(this->thread, NULL);
+	this->started = false;
+	this->pending.clear();
+	this->complete.clear();
+	// Searches still out are answered with nothing
+	this->requests.clear();
+	this->results.clear();
+	this->outstanding = 0;
+}
+
+bool	LogIndex::isEnabled(void) const {return (this->started);}
+bool	LogIndex::hasOutstanding(void) const {return (this->outstanding > 0);}
+
+/**
+ * @brief Hand a search to the indexer thread. Only called from the event
+ * loop.
+ * @param channel The channel, or "*".
+ * @param text The words to look for.
+ * @param limit The most lines to return.
+ * @return The ticket its result comes back with (see collect()).
+ */
+unsigned long	LogIndex::submit(const std::string& channel, const std::string& text, size_t limit) {
+	Request request;
+	request.ticket = ++this->nextTicket;
+	request.channel = channel;
+	request.text = text;
+	request.limit = limit;
+	pthread_mutex_lock(&this->lock);
+	this->requests.push_back(request);
+	pthread_mutex_unlock(&this->lock);
+	this->outstanding++;
+	return (request.ticket);
+}
+
+/**
+ * @brief Take the results of the searches the indexer finished since the
+ * last call. Only called from the event loop.
+ * @param done Receives the results.
+ */
+void	LogIndex::collect(std::vector<Result>& done) {
+	done.clear();
+	if (this->outstanding == 0)
+		return;
+	pthread_mutex_lock(&this->lock);
+	done.swap(this->results);
+	pthread_mutex_unlock(&this->lock);
+	this->outstanding -= done.size();
+}
+
+/**
+ * @brief Run the searches submitted so far, on the indexer thread.
+ */
+void	LogIndex::serveSearches(void) {
+	std::deque<Request> batch;
+
+	pthread_mutex_lock(&this->lock);
+	batch.swap(this->requests);
+	pthread_mutex_unlock(&this->lock);
+	for (size_t i = 0; i < batch.size(); i++) {
+		Result result;
+		result.ticket = batch[i].ticket;
+		search(batch[i].channel, batch[i].text, batch[i].limit, result.matches);
+		pthread_mutex_lock(&this->lock);
+		this->results.push_back(result);
+		pthread_mutex_unlock(&this->lock);
+	}
+}
+
+/**
+ * @brief Cut a text into lowercase words (runs of letters, digits and
+ * non ASCII bytes), each at most INDEX_WORD_LENGTH characters.
+ */
+void	LogIndex::splitWords(const char *text, size_t length, std::vector<std::string>& words) {
+	std::string word;
+
+	for (size_t i = 0; i <= length; i++) {
+		unsigned char c = (i < length) ? text[i] : ' ';
+		if (std::isalnum(c) || c >= 0x80) {
+			if (word.length() < INDEX_WORD_LENGTH)
+				word += static_cast<char>(std::tolower(c));
+		} else if (!word.empty()) {
+			words.push_back(word);
+			word.clear();
+		}
+	}
+}
+
+/**
+ * @brief The words of a logged line, sorted and unique: the nick and the
+ * text of "[time] :nick!user@host COMMAND params :text".
+ */
+static void	lineWords(const char *line, size_t length, std::vector<std::string>& words) {
+	std::string text(line, length);
+	size_t source = text.find("] :");
+
+	words.clear();
+	if (source == std::string::npos)
+		LogIndex::splitWords(line, length, words);
+	else {
+		source += 3;
+		size_t nickEnd = std::min(text.find_first_of("! ", source), length);
+		LogIndex::splitWords(line + source, nickEnd - source, words);
+		size_t trailing = text.find(" :", source);
+		if (trailing != std::string::npos)
+			LogIndex::splitWords(line + trailing + 2, length - trailing - 2, words);
+	}
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+}
+
+static void	listSegments(const std::string& directory, SegmentMap& segments) {
+	DIR *dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string file = entry->d_name;
+		if (file.length() < 4 || file.compare(file.length() - 4, 4, ".log") != 0)
+			continue;
+		std::string stem = file.substr(0, file.length() - 4);
+		size_t dot = stem.rfind('.');
+		if (dot == std::string::npos || dot == 0 || dot + 1 == stem.length()
+			|| stem.find_first_not_of("0123456789", dot + 1) != std::string::npos)
+			continue;
+		unsigned long start = std::strtoul(stem.c_str() + dot + 1, NULL, 10);
+		segments[stem.substr(0, dot)].push_back(std::make_pair(start, directory + "/" + file));
+	}
+	closedir(dir);
+	for (SegmentMap::iterator it = segments.begin(); it != segments.end(); ++it)
+		std::sort(it->second.begin(), it->second.end());
+}
+
+/**
+ * @brief Map the index file of a segment and check its header.
+ * @param path The segment.
+ * @param size Receives the size of the mapping.
+ * @return The mapping, NULL if there is no valid index.
+ */
+static const char	*mapIndex(const std::string& path, size_t& size) {
+	int fd = ::open((path + ".idx").c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return (NULL);
+	struct stat info;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(IndexHeader))
+		data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return (NULL);
+	size = info.st_size;
+
+	const IndexHeader *header = static_cast<const IndexHeader *>(data);
+	size_t tables = sizeof(IndexHeader);
+	bool valid = std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+		&& header->terms <= (size - tables) / sizeof(IndexTerm);
+	if (valid) {
+		tables += header->terms * sizeof(IndexTerm);
+		valid = header->postings <= (size - tables) / sizeof(unsigned int);
+	}
+	if (!valid) {
+		munmap(data, size);
+		return (NULL);
+	}
+	return (static_cast<const char *>(data));
+}
+
+static const IndexHeader	*indexHeader(const char *data) {
+	return (reinterpret_cast<const IndexHeader *>(data));
+}
+
+static const IndexTerm	*indexTerms(const char *data) {
+	return (reinterpret_cast<const IndexTerm *>(data + sizeof(IndexHeader)));
+}
+
+static const unsigned int	*indexPostings(const char *data) {
+	return (reinterpret_cast<const unsigned int *>(data + sizeof(IndexHeader) + indexHeader(data)->terms * sizeof(IndexTerm)));
+}
+
+// The term points inside the file, checked before it is used
+static bool	termValid(const char *data, size_t size, const IndexTerm& term) {
+	unsigned long postings = indexHeader(data)->postings;
+	return (term.first <= postings && term.count <= postings - term.first
+		&& term.word <= size && term.length <= size - term.word);
+}
+
+static const IndexTerm	*findTerm(const char *data, size_t size, const std::string& word) {
+	const IndexTerm *terms = indexTerms(data);
+	size_t low = 0;
+	size_t high = indexHeader(data)->terms;
+
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		const IndexTerm& term = terms[middle];
+		if (!termValid(data, size, term))
+			return (NULL);
+		int order = std::memcmp(data + term.word, word.data(), std::min<size_t>(term.length, word.length()));
+		if (order == 0 && term.length != word.length())
+			order = term.length < word.length() ? -1 : 1;
+		if (order == 0)
+			return (&term);
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return (NULL);
+}
+
+static bool	rarer(const IndexTerm *left, const IndexTerm *right) {
+	return (left->count < right->count);
+}
+
+void	*LogIndex::run(void *self) {
+	static_cast<LogIndex *>(self)->indexerLoop();
+	return (NULL);
+}
+
+void	LogIndex::indexerLoop(void) {
+	while (__atomic_load_n(&this->running, __ATOMIC_ACQUIRE)) {
+		indexPass();
+		// Short naps so stop() never waits a whole interval, nor a search
+		for (unsigned int slept = 0; slept < INDEX_INTERVAL_MS && __atomic_load_n(&this->running, __ATOMIC_ACQUIRE); slept += LOG_FLUSH_MS) {
+			serveSearches();
+			usleep(LOG_FLUSH_MS * 1000);
+		}
+	}
+}
+
+void	LogIndex::indexPass(void) {
+	SegmentMap segments;
+	std::set<std::string> present;
+
+	listSegments(this->directory, segments);
+	for (SegmentMap::iterator it = segments.begin(); it != segments.end(); ++it) {
+		for (size_t i = 0; i < it->second.size(); i++) {
+			// Only the newest segment of a channel still grows
+			indexSegment(it->second[i].second, i + 1 == it->second.size());
+			present.insert(it->second[i].second);
+		}
+	}
+	// Forget the segments removed from the directory
+	for (std::map<std::string, Pending>::iterator it = this->pending.begin(); it != this->pending.end();) {
+		if (present.find(it->first) == present.end())
+			this->pending.erase(it++);
+		else
+			++it;
+	}
+	for (std::map<std::string, unsigned long>::iterator it = this->complete.begin(); it != this->complete.end();) {
+		if (present.find(it->first) == present.end())
+			this->complete.erase(it++);
+		else
+			++it;
+	}
+}
+
+/**
+ * @brief Index the lines added to a segment since the last pass. The index
+ * file of a finished segment is written once, the one of the active segment
+ * when it lags INDEX_TAIL_BYTES behind or when the channel went quiet.
+ * @param path The segment.
+ * @param active true for the newest segment of its channel.
+ */
+void	LogIndex::indexSegment(const std::string& path, bool active) {
+	struct stat info;
+	if (stat(path.c_str(), &info) < 0)
+		return;
+	unsigned long size = info.st_size;
+	std::map<std::string, unsigned long>::iterator done = this->complete.find(path);
+	if (!active && done != this->complete.end() && done->second == size)
+		return;
+
+	std::map<std::string, Pending>::iterator it = this->pending.find(path);
+	if (it == this->pending.end() && !active) {
+		// Finished and indexed by an earlier run, the header is enough
+		size_t indexSize = 0;
+		const char *data = mapIndex(path, indexSize);
+		bool indexed = data != NULL && indexHeader(data)->covered == size;
+		if (data != NULL)
+			munmap(const_cast<char *>(data), indexSize);
+		if (indexed) {
+			this->complete[path] = size;
+			return;
+		}
+	}
+	if (it == this->pending.end()) {
+		Pending fresh;
+		fresh.covered = 0;
+		fresh.written = 0;
+		it = this->pending.insert(std::make_pair(path, fresh)).first;
+		// Carry on from an earlier pass or an earlier run
+		loadIndex(path, it->second);
+	}
+	Pending& index = it->second;
+
+	bool grew = false;
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		std::vector<char> chunk(READ_CHUNK);
+		std::vector<std::string> words;
+		while (index.covered < size && __atomic_load_n(&this->running, __ATOMIC_ACQUIRE)) {
+			// A search waits one chunk at most, not the whole pass
+			serveSearches();
+			ssize_t got = pread(fd, &chunk[0], std::min<unsigned long>(READ_CHUNK, size - index.covered), index.covered);
+			if (got <= 0)
+				break;
+			// Complete lines only, the writer may be in the middle of one
+			size_t end = got;
+			while (end > 0 && chunk[end - 1] != '\n')
+				end--;
+			if (end == 0) {
+				if (active && static_cast<size_t>(got) < READ_CHUNK)
+					break;
+				end = got;
+			}
+			for (size_t start = 0; start < end;) {
+				const char *newline = static_cast<const char *>(std::memchr(&chunk[start], '\n', end - start));
+				size_t lineEnd = (newline == NULL) ? end : newline - &chunk[0];
+				lineWords(&chunk[start], lineEnd - start, words);
+				for (size_t w = 0; w < words.size(); w++)
+					index.postings[words[w]].push_back(static_cast<unsigned int>(index.covered + start));
+				start = lineEnd + 1;
+			}
+			index.covered += end;
+			grew = true;
+		}
+		close(fd);
+	}
+
+	if (index.covered > index.written && (!active || !grew || index.covered - index.written >= INDEX_TAIL_BYTES))
+		writeIndex(path, index);
+	if (!active && index.covered >= size && index.written == index.covered) {
+		this->complete[path] = size;
+		this->pending.erase(it);
+	}
+}
+
+/**
+ * @brief Read the index file of a segment back into memory.
+ * @return false if there is no valid index file.
+ */
+bool	LogIndex::loadIndex(const std::string& path, Pending& index) const {
+	size_t size = 0;
+	const char *data = mapIndex(path, size);
+	if (data == NULL)
+		return (false);
+
+	const IndexHeader *header = indexHeader(data);
+	const IndexTerm *terms = indexTerms(data);
+	const unsigned int *postings = indexPostings(data);
+	bool valid = true;
+	for (unsigned long i = 0; i < header->terms && valid; i++) {
+		valid = termValid(data, size, terms[i]);
+		if (valid) {
+			std::vector<unsigned int>& list = index.postings.insert(index.postings.end(),
+				std::make_pair(std::string(data + terms[i].word, terms[i].length), std::vector<unsigned int>()))->second;
+			list.assign(postings + terms[i].first, postings + terms[i].first + terms[i].count);
+		}
+	}
+	if (valid) {
+		index.covered = header->covered;
+		index.written = header->covered;
+	} else
+		index.postings.clear();
+	munmap(const_cast<char *>(data), size);
+	return (valid);
+}
+
+/**
+ * @brief Replace the index file of a segment with the postings in memory.
+ */
+void	LogIndex::writeIndex(const std::string& path, Pending& index) const {
+	IndexHeader header;
+	std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.covered = index.covered;
+	header.terms = index.postings.size();
+	header.postings = 0;
+	for (Postings::const_iterator it = index.postings.begin(); it != index.postings.end(); ++it)
+		header.postings += it->second.size();
+
+	std::vector<IndexTerm> terms;
+	std::vector<unsigned int> postings;
+	std::string words;
+	terms.reserve(header.terms);
+	postings.reserve(header.postings);
+	unsigned long wordBase = sizeof(IndexHeader) + header.terms * sizeof(IndexTerm) + header.postings * sizeof(unsigned int);
+	for (Postings::const_iterator it = index.postings.begin(); it != index.postings.end(); ++it) {
+		IndexTerm term;
+		term.word = wordBase + words.length();
+		term.first = postings.size();
+		term.length = it->first.length();
+		term.count = it->second.size();
+		terms.push_back(term);
+		postings.insert(postings.end(), it->second.begin(), it->second.end());
+		words += it->first;
+	}
+
+	// A new run may index the same segment while the old one finishes
+	std::ostringstream temporary;
+	temporary << path << ".idx." << getpid() << ".tmp";
+	int fd = ::open(temporary.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	bool written = fd >= 0
+		&& writeAll(fd, reinterpret_cast<const char *>(&header), sizeof(header))
+		&& (terms.empty() || writeAll(fd, reinterpret_cast<const char *>(&terms[0]), terms.size() * sizeof(IndexTerm)))
+		&& (postings.empty() || writeAll(fd, reinterpret_cast<const char *>(&postings[0]), postings.size() * sizeof(unsigned int)))
+		&& writeAll(fd, words.data(), words.length());
+	if (fd >= 0)
+		close(fd);
+	if (!written || rename(temporary.str().c_str(), (path + ".idx").c_str()) < 0) {
+		std::cerr << "Log index: cannot write " << path << ".idx: " << std::strerror(errno) << std::endl;
+		unlink(temporary.str().c_str());
+		return;
+	}
+	index.written = index.covered;
+}
+
+/**
+ * @brief Lines of a channel (or of all channels with "*") that have every
+ * word of text, newest first. Runs on the indexer thread (see submit()).
+ * @param channel The channel, or "*".
+ * @param text The words to look for.
+ * @param limit The most lines to return.
+ * @param matches Receives the lines.
+ * @return The number of lines found.
+ */
+size_t	LogIndex::search(const std::string& channel, const std::string& text, size_t limit, std::vector<Match>& matches) const {
+	std::vector<std::string> terms;
+	splitWords(text.data(), text.length(), terms);
+	std::sort(terms.begin(), terms.end());
+	terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+	if (terms.empty())
+		return (0);
+
+	SegmentMap segments;
+	listSegments(this->directory, segments);
+	// Newest segments first, whichever channel they belong to
+	std::vector<std::pair<unsigned long, std::pair<std::string, std::string> > > order;
+	for (SegmentMap::iterator it = segments.begin(); it != segments.end(); ++it) {
+		if (channel != "*" && it->first != ChannelLogger::fileName(channel))
+			continue;
+		for (size_t i = 0; i < it->second.size(); i++)
+			order.push_back(std::make_pair(it->second[i].first, std::make_pair(it->first, it->second[i].second)));
+	}
+	std::sort(order.rbegin(), order.rend());
+
+	size_t before = matches.size();
+	for (size_t i = 0; i < order.size() && matches.size() - before < limit; i++)
+		searchSegment(order[i].second.second, order[i].second.first, terms, before + limit, matches);
+	return (matches.size() - before);
+}
+
+/**
+ * @brief Search one segment, newest lines first: the lines written after its
+ * index are scanned, the rest found through the index.
+ * @param limit Stop once matches holds this many lines.
+ */
+void	LogIndex::searchSegment(const std::string& path, const std::string& channel,
+	const std::vector<std::string>& terms, size_t limit, std::vector<Match>& matches) const {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	struct stat info;
+	if (fstat(fd, &info) < 0) {
+		close(fd);
+		return;
+	}
+	unsigned long size = info.st_size;
+	size_t indexSize = 0;
+	const char *data = mapIndex(path, indexSize);
+	unsigned long covered = (data == NULL) ? 0 : std::min(indexHeader(data)->covered, size);
+
+	std::string tail(size - covered, '\0');
+	if (!tail.empty() && pread(fd, &tail[0], tail.length(), covered) == static_cast<ssize_t>(tail.length())) {
+		std::vector<std::string> found;
+		std::vector<std::string> words;
+		size_t end;
+		// A last line without its newline is still being written
+		for (size_t start = 0; (end = tail.find('\n', start)) != std::string::npos; start = end + 1) {
+			lineWords(tail.data() + start, end - start, words);
+			if (std::includes(words.begin(), words.end(), terms.begin(), terms.end()))
+				found.push_back(tail.substr(start, end - start));
+		}
+		for (size_t i = found.size(); i > 0 && matches.size() < limit; i--) {
+			Match match;
+			match.channel = channel;
+			match.line = found[i - 1];
+			matches.push_back(match);
+		}
+	}
+
+	if (data != NULL) {
+		std::vector<const IndexTerm *> found;
+		for (size_t i = 0; i < terms.size(); i++) {
+			const IndexTerm *term = findTerm(data, indexSize, terms[i]);
+			if (term == NULL) {
+				found.clear();
+				break;
+			}
+			found.push_back(term);
+		}
+		// Walk the postings of the rarest word, look the others up in theirs
+		std::sort(found.begin(), found.end(), rarer);
+		const unsigned int *postings = indexPostings(data);
+		char line[LINE_MAX_BYTES];
+		for (unsigned long i = found.empty() ? 0 : found[0]->count; i > 0 && matches.size() < limit; i--) {
+			unsigned int offset = postings[found[0]->first + i - 1];
+			bool everyWord = offset < covered;
+			for (size_t j = 1; j < found.size() && everyWord; j++)
+				everyWord = std::binary_search(postings + found[j]->first, postings + found[j]->first + found[j]->count, offset);
+			ssize_t got = everyWord ? pread(fd, line, sizeof(line), offset) : 0;
+			if (got <= 0)
+				continue;
+			const char *newline = static_cast<const char *>(std::memchr(line, '\n', got));
+			Match match;
+			match.channel = channel;
+			match.line.assign(line, newline == NULL ? got : newline - line);
+			matches.push_back(match);
+		}
+		munmap(const_cast<char *>(data), indexSize);
+	}
+	close(fd);
+}
+
+LogIndex::LogIndexException::LogIndexException(const std::string& message) : message(message) {}
+LogIndex::LogIndexException::~LogIndexException() throw() {}
+
+const char* LogIndex::LogIndexException::what() const throw() {
+	return (this->message.c_str());
+}
@@ -0,0 +1,94 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   MemoryUsage.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/30 14:12:36 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/30 14:12:36 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/MemoryUsage.hpp"
+
+static const char	*SUBSYSTEM_NAMES[MemoryUsage::NUM_SUBSYSTEMS] = {
+	"connections", "input", "output", "channels", "history", "services"
+};
+
+MemoryUsage::MemoryUsage() : connections(0), heapInUse(0) {
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++)
+		this->bytes[i] = 0;
+}
+
+size_t	MemoryUsage::total(void) const {
+	size_t sum = 0;
+
+	for (size_t i = 0; i < NUM_SUBSYSTEMS; i++)
+		sum += this->bytes[i];
+	return (sum);
+}
+
+// What a connection costs: its client, its input buffer and its output queue
+size_t	MemoryUsage::perConnection(void) const {
+	if (this->connections == 0)
+		return (0);
+	return ((this->bytes[CONNECTIONS] + this->bytes[INPUT] + this->bytes[OUTPUT]) / this->connections);
+}
+
+const char	*MemoryUsage::name(Subsystem subsystem) {
+	return (SUBSYSTEM_NAMES[subsystem]);
+}
+
+/**
+ * @brief What malloc takes for a block of requested bytes: a size word,
+ * rounded up to 16 bytes, 32 at least (glibc on 64 bit).
+ */
+size_t	allocationBytes(size_t requested) {
+	if (requested == 0)
+		return (0);
+	size_t block = (requested + sizeof(size_t) + 15) & ~static_cast<size_t>(15);
+	return (block < 32 ? 32 : block);
+}
+
+/**
+ * @brief Heap bytes of a string. Short strings live inside the object
+ * (15 bytes with the C++11 string), reference counted strings carry a
+ * header, shared copies are counted by each owner.
+ */
+size_t	stringBytes(const std::string& value) {
+	if (sizeof(std::string) > sizeof(char *))
+		return (value.capacity() > 15 ? allocationBytes(value.capacity() + 1) : 0);
+	return (value.capacity() == 0 ? 0 : allocationBytes(value.capacity() + 1 + 3 * sizeof(size_t)));
+}
+
+/**
+ * @brief Heap bytes of a std::map or std::set node holding valueSize
+ * bytes: color, parent, left and right come first.
+ */
+size_t	treeNodeBytes(size_t valueSize) {
+	return (allocationBytes(4 * sizeof(void *) + valueSize));
+}
+
+/**
+ * @brief Heap bytes of a std::deque of count elements of elementSize
+ * bytes: blocks of 512 bytes (one element if it is larger) and the map of
+ * block pointers, 8 at least.
+ */
+size_t	dequeBytes(size_t count, size_t elementSize) {
+	size_t perBlock = elementSize < 512 ? 512 / elementSize : 1;
+	size_t blocks = count / perBlock + 1;
+	size_t mapSize = blocks + 2 < 8 ? 8 : blocks + 2;
+
+	return (allocationBytes(mapSize * sizeof(void *)) + blocks * allocationBytes(perBlock * elementSize));
+}
+
+// Bytes malloc handed out and not got back, 0 if the C library doesn't say
+size_t	mallocInUse(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+	return (info.uordblks + info.hblkhd);
+#else
+	return (0);
+#endif
+}
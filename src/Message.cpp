@@ -14,7 +14,7 @@
 
 Message::Message() : valid(false) {}
 
-Message::Message(const std::string& rawMsg) : rawMessage(rawMsg), valid(false) {
+Message::Message(const std::string& rawMsg) : valid(false) {
 	parse(rawMsg);
 }
 
@@ -24,6 +24,7 @@ Message::Message(const Message& right) {
 
 Message& Message::operator=(const Message& right) {
 	if (this != &right) {
+		this->tags = right.tags;
 		this->prefix = right.prefix;
 		this->command = right.command;
 		this->parameters = right.parameters;
@@ -38,7 +39,7 @@ Message::~Message() {}
 /**
  * @brief Parse an IRC message according to RFC 2812 format
  * 
- * Message format: [":prefix "] command [params] \r\n
+ * Message format: ["@tags "] [":prefix "] command [params] \r\n
  * params = *14( SPACE middle ) [ SPACE ":" trailing ]
  *        =/ 14( SPACE middle ) [ SPACE [ ":" ] trailing ]
  * 
@@ -46,22 +47,44 @@ Message::~Message() {}
  * @return true if parsing succeeded, false otherwise
  */
 bool Message::parse(const std::string& rawMsg) {
+	if (&rawMsg == &this->rawMessage) {
+		std::string copy(rawMsg);
+		return parse(copy);
+	}
+	HAI_PROBE1(parse_begin, rawMsg.length());
+	bool parsed = parseLine(rawMsg);
+	HAI_PROBE2(parse_end, this->valid, this->command.c_str());
+	return parsed;
+}
+
+bool Message::parseLine(const std::string& rawMsg) {
 	clear();
 	
 	if (rawMsg.empty()) {
 		return false;
 	}
 
-	this->rawMessage = rawMsg;
-	std::string msg = rawMsg;
+	this->rawMessage.assign(rawMsg);
+	const std::string& msg = this->rawMessage;
 	size_t pos = 0;
 
-	if (msg[0] == ':') {
-		size_t spacePos = msg.find(' ', 1);
+	if (msg[0] == '@') {
+		size_t spacePos = msg.find(' ');
 		if (spacePos == std::string::npos) {
 			return false;
 		}
-		this->prefix = msg.substr(1, spacePos - 1);
+		this->tags.assign(msg, 1, spacePos - 1);
+		pos = spacePos + 1;
+		while (pos < msg.length() && msg[pos] == ' ') {
+			pos++;
+		}
+	}
+	if (pos < msg.length() && msg[pos] == ':') {
+		size_t spacePos = msg.find(' ', pos);
+		if (spacePos == std::string::npos) {
+			return false;
+		}
+		this->prefix.assign(msg, pos + 1, spacePos - pos - 1);
 		pos = spacePos + 1;
 		while (pos < msg.length() && msg[pos] == ' ') {
 			pos++;
@@ -72,28 +95,28 @@ bool Message::parse(const std::string& rawMsg) {
 	}
 	size_t cmdEnd = msg.find(' ', pos);
 	if (cmdEnd == std::string::npos) {
-		this->command = msg.substr(pos);
+		this->command.assign(msg, pos, std::string::npos);
 		this->valid = true;
 		return true;
 	}
 
-	this->command = msg.substr(pos, cmdEnd - pos);
+	this->command.assign(msg, pos, cmdEnd - pos);
 	pos = cmdEnd + 1;
 	while (pos < msg.length() && msg[pos] == ' ') {
 		pos++;
 	}
 	while (pos < msg.length() && this->parameters.size() < 15) {
 		if (msg[pos] == ':') {
-			this->parameters.push_back(msg.substr(pos + 1));
+			nextParameter().assign(msg, pos + 1, std::string::npos);
 			break;
 		}
 		size_t nextSpace = msg.find(' ', pos);
 		if (nextSpace == std::string::npos) {
-			this->parameters.push_back(msg.substr(pos));
+			nextParameter().assign(msg, pos, std::string::npos);
 			break;
 		}
 
-		this->parameters.push_back(msg.substr(pos, nextSpace - pos));
+		nextParameter().assign(msg, pos, nextSpace - pos);
 		pos = nextSpace + 1;
 		while (pos < msg.length() && msg[pos] == ' ') {
 			pos++;
@@ -104,23 +127,45 @@ bool Message::parse(const std::string& rawMsg) {
 	return true;
 }
 
+/**
+ * @brief A new parameter, made of a string of an earlier line if there is one.
+ */
+std::string& Message::nextParameter() {
+	this->parameters.push_back(std::string());
+	if (!this->spare.empty()) {
+		this->parameters.back().swap(this->spare.back());
+		this->spare.pop_back();
+	}
+	return this->parameters.back();
+}
+
 void Message::clear() {
+	this->tags.clear();
 	this->prefix.clear();
 	this->command.clear();
-	this->parameters.clear();
+	// The strings go to the spare ones with their capacity
+	while (!this->parameters.empty()) {
+		this->spare.push_back(std::string());
+		this->spare.back().swap(this->parameters.back());
+		this->parameters.pop_back();
+	}
 	this->rawMessage.clear();
 	this->valid = false;
 }
 
-std::string Message::getPrefix() const {
+const std::string& Message::getTags() const {
+	return this->tags;
+}
+
+const std::string& Message::getPrefix() const {
 	return this->prefix;
 }
 
-std::string Message::getCommand() const {
+const std::string& Message::getCommand() const {
 	return this->command;
 }
 
-std::vector<std::string> Message::getParameters() const {
+const std::vector<std::string>& Message::getParameters() const {
 	return this->parameters;
 }
 
@@ -135,7 +180,7 @@ size_t Message::getParameterCount() const {
 	return this->parameters.size();
 }
 
-std::string Message::getRawMessage() const {
+const std::string& Message::getRawMessage() const {
 	return this->rawMessage;
 }
 
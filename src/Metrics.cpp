@@ -0,0 +1,154 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Metrics.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/26 16:40:03 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/26 16:40:03 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Metrics.hpp"
+
+Histogram::Histogram(const unsigned long *bounds, size_t size) :
+bounds(bounds),
+size(size),
+counts(size + 1, 0),
+sum(0),
+count(0)
+{}
+
+Histogram::Histogram(const Histogram& right) {
+	*this = right;
+}
+
+Histogram& Histogram::operator=(const Histogram& right) {
+	if (this != &right) {
+		this->bounds = right.bounds;
+		this->size = right.size;
+		this->counts = right.counts;
+		this->sum = right.sum;
+		this->count = right.count;
+	}
+	return (*this);
+}
+
+Histogram::~Histogram() {}
+
+void	Histogram::observe(unsigned long value) {
+	this->counts[std::lower_bound(this->bounds, this->bounds + this->size, value) - this->bounds]++;
+	this->sum += value;
+	this->count++;
+}
+
+// Microseconds as seconds, e.g. 2500 -> 0.0025
+static std::string	seconds(unsigned long micros) {
+	std::ostringstream out;
+
+	out << micros / 1000000;
+	if (micros % 1000000) {
+		std::ostringstream fraction;
+		fraction << std::setw(6) << std::setfill('0') << micros % 1000000;
+		std::string digits = fraction.str();
+		out << "." << digits.substr(0, digits.find_last_not_of('0') + 1);
+	}
+	return (out.str());
+}
+
+/**
+ * @brief Write the samples of the histogram (its family line excluded).
+ * @param out Receives the samples.
+ * @param name The metric name.
+ * @param labels Labels of every sample, e.g. command="JOIN", or empty.
+ * @param inSeconds Whether the values are microseconds shown as seconds.
+ * @param gauge A gaugehistogram (a snapshot, _gcount and _gsum).
+ */
+void	Histogram::write(std::ostringstream& out, const std::string& name, const std::string& labels, bool inSeconds, bool gauge) const {
+	std::string separator = labels.empty() ? "" : ",";
+	unsigned long cumulated = 0;
+
+	for (size_t i = 0; i <= this->size; i++) {
+		cumulated += this->counts[i];
+		out << name << "_bucket{" << labels << separator << "le=\"";
+		if (i == this->size)
+			out << "+Inf";
+		else if (inSeconds)
+			out << seconds(this->bounds[i]);
+		else
+			out << this->bounds[i];
+		out << "\"} " << cumulated << "\n";
+	}
+	std::string braces = labels.empty() ? "" : "{" + labels + "}";
+	out << name << (gauge ? "_gcount" : "_count") << braces << " " << this->count << "\n";
+	out << name << (gauge ? "_gsum" : "_sum") << braces << " ";
+	if (inSeconds)
+		out << seconds(this->sum);
+	else
+		out << this->sum;
+	out << "\n";
+}
+
+Metrics::Metrics() :
+loopIteration(LATENCY_BUCKETS, NUM_LATENCY_BUCKETS),
+commandLatency(NUM_METRIC_COMMANDS + 1, Histogram(LATENCY_BUCKETS, NUM_LATENCY_BUCKETS))
+{}
+
+Metrics::~Metrics() {}
+
+void			Metrics::add(Counter counter, unsigned long amount) {this->counters[counter].add(amount);}
+unsigned long	Metrics::get(Counter counter) const {return (this->counters[counter].load());}
+void			Metrics::observeIteration(unsigned long micros) {this->loopIteration.observe(micros);}
+
+/**
+ * @brief Count the run time of a command.
+ * @param command The command as received, in any case.
+ * @param micros How long processCommand() took.
+ */
+void	Metrics::observeCommand(const std::string& command, unsigned long micros) {
+	size_t index = 0;
+
+	for (; index < NUM_METRIC_COMMANDS; index++) {
+		const std::string& known = METRIC_COMMANDS[index];
+		size_t i = 0;
+		while (i < command.length() && i < known.length() && std::toupper(command[i]) == known[i])
+			i++;
+		if (i == command.length() && i == known.length())
+			break;
+	}
+	this->commandLatency[index].observe(micros);
+}
+
+void	Metrics::writeFamily(std::ostringstream& out, const std::string& name, const std::string& type, const std::string& help) {
+	out << "# TYPE " << name << " " << type << "\n";
+	out << "# HELP " << name << " " << help << "\n";
+}
+
+/**
+ * @brief Write the counters and histograms of the event loop.
+ * @param out Receives the metric families.
+ */
+void	Metrics::write(std::ostringstream& out) const {
+	static const char *counterNames[NUM_COUNTERS] = {"hai_messages_received", "hai_bytes_received", "hai_messages_sent", "hai_bytes_sent",
+		"hai_fanout_lines_skipped"};
+	static const char *counterHelp[NUM_COUNTERS] = {
+		"Lines received from connections.",
+		"Bytes received from connections.",
+		"Lines sent to connections.",
+		"Bytes sent to connections.",
+		"Channel lines skipped by members that fell behind a fan-out ring."
+	};
+
+	for (size_t i = 0; i < NUM_COUNTERS; i++) {
+		writeFamily(out, counterNames[i], "counter", counterHelp[i]);
+		out << counterNames[i] << "_total " << this->counters[i].load() << "\n";
+	}
+	writeFamily(out, "hai_loop_iteration_seconds", "histogram", "Time from poll() returning to the end of the event loop iteration.");
+	this->loopIteration.write(out, "hai_loop_iteration_seconds", "", true, false);
+	writeFamily(out, "hai_command_duration_seconds", "histogram", "Run time of the commands, the unlisted ones together as other.");
+	for (size_t i = 0; i <= NUM_METRIC_COMMANDS; i++) {
+		std::string command = i < NUM_METRIC_COMMANDS ? METRIC_COMMANDS[i] : "other";
+		this->commandLatency[i].write(out, "hai_command_duration_seconds", "command=\"" + command + "\"", true, false);
+	}
+}
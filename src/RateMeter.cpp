@@ -0,0 +1,79 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   RateMeter.cpp                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/27 11:20:14 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/27 11:20:14 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/RateMeter.hpp"
+
+RateMeter::RateMeter() :
+total(0),
+windowStart(0),
+windowCount(0),
+lastRate(0)
+{}
+
+RateMeter::RateMeter(const RateMeter& right) {
+	*this = right;
+}
+
+RateMeter& RateMeter::operator=(const RateMeter& right) {
+	if (this != &right) {
+		this->total = right.total;
+		this->windowStart = right.windowStart;
+		this->windowCount = right.windowCount;
+		this->lastRate = right.lastRate;
+	}
+	return (*this);
+}
+
+RateMeter::~RateMeter() {}
+
+/**
+ * @brief Count events, closing the current window if it is over.
+ * @param amount How many.
+ * @param nowMs currentTimeMs().
+ */
+void	RateMeter::add(unsigned long amount, unsigned long nowMs) {
+	unsigned long elapsed = nowMs - this->windowStart;
+
+	if (elapsed >= RATE_WINDOW_MS) {
+		this->lastRate = this->windowStart ? this->windowCount * 10000 / elapsed : 0;
+		this->windowStart = nowMs;
+		this->windowCount = 0;
+	}
+	this->total += amount;
+	this->windowCount += amount;
+}
+
+unsigned long	RateMeter::getTotal(void) const {return (this->total);}
+
+/**
+ * @brief Events per second, in tenths.
+ * @param nowMs currentTimeMs().
+ */
+unsigned long	RateMeter::getRate(unsigned long nowMs) const {
+	unsigned long elapsed = nowMs - this->windowStart;
+
+	if (elapsed >= RATE_WINDOW_MS)
+		return (this->windowCount * 10000 / elapsed);
+	// Still in the first window, there is no full one yet
+	if (this->total == this->windowCount)
+		return (this->windowCount * 10000 / std::max(elapsed, 1000UL));
+	return (this->lastRate);
+}
+
+// The rate with one decimal, e.g. 2.5
+std::string	RateMeter::formatRate(unsigned long nowMs) const {
+	std::ostringstream out;
+	unsigned long rate = getRate(nowMs);
+
+	out << rate / 10 << "." << rate % 10;
+	return (out.str());
+}
@@ -0,0 +1,175 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ReplyCursor.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/05 18:10:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/05 18:10:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ReplyCursor.hpp"
+
+ReplyCursor::ReplyCursor() :
+kind(LIST),
+target(""),
+phase(0),
+lastFd(-1),
+lastChannel(""),
+started(false)
+{}
+
+ReplyCursor::ReplyCursor(Kind kind, const std::string& target) :
+kind(kind),
+target(target),
+phase(0),
+lastFd(-1),
+lastChannel(""),
+started(false)
+{}
+
+ReplyCursor::ReplyCursor(const ReplyCursor& right) {
+	*this = right;
+}
+
+ReplyCursor& ReplyCursor::operator=(const ReplyCursor& right) {
+	if (this != &right) {
+		this->kind = right.kind;
+		this->target = right.target;
+		this->phase = right.phase;
+		this->lastFd = right.lastFd;
+		this->lastChannel = right.lastChannel;
+		this->started = right.started;
+	}
+	return (*this);
+}
+
+ReplyCursor::~ReplyCursor() {}
+
+ReplyCursor::Kind	ReplyCursor::getKind(void) const {return (this->kind);}
+const std::string&	ReplyCursor::getTarget(void) const {return (this->target);}
+
+/**
+ * @brief Append at most budget more reply lines to out.
+ * @param nickname The nickname of the client that asked for the reply.
+ * @param clientMap The server's clients, used to resolve member fds.
+ * @param channels The server's channels.
+ * @param out Where the generated lines are appended.
+ * @param budget How many lines may still be produced this turn, decremented
+ * for every line appended (the end numeric excluded).
+ * @return true once the end numeric has been appended and the cursor is done.
+ */
+bool	ReplyCursor::resume(const std::string& nickname, const std::map<int, Client>& clientMap,
+			const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget) {
+	if (this->kind == WHO)
+		return (resumeWho(nickname, clientMap, channels, out, budget));
+	if (this->kind == NAMES)
+		return (resumeNames(nickname, clientMap, channels, out, budget));
+	return (resumeList(nickname, channels, out, budget));
+}
+
+// RPL_WHOREPLY (352) per member, then RPL_ENDOFWHO (315)
+bool	ReplyCursor::resumeWho(const std::string& nickname, const std::map<int, Client>& clientMap,
+			const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget) {
+	std::map<std::string, Channel>::const_iterator chanIt = channels.find(this->target);
+	if (chanIt != channels.end()) {
+		const Channel& chan = chanIt->second;
+		const std::set<int>& members = chan.getMembers();
+		std::set<int>::const_iterator it = (this->lastFd < 0) ? members.begin() : members.upper_bound(this->lastFd);
+
+		for (; it != members.end() && budget > 0; ++it) {
+			this->lastFd = *it;
+			std::map<int, Client>::const_iterator memIt = clientMap.find(*it);
+			if (memIt == clientMap.end())
+				continue;
+			const Client& member = memIt->second;
+			std::string flags = chan.isOperator(*it) ? "@" : "";
+			out += ":" + SERVER_NAME + " " + RPL_WHOREPLY + " " + nickname +
+				" " + this->target + " " + member.getUsername() + " localhost " +
+				SERVER_NAME + " " + member.getNickname() + (member.isAway() ? " G" : " H") + flags +
+				" :0 " + member.getRealname() + CLDR;
+			budget--;
+		}
+		if (it != members.end())
+			return (false);
+	}
+	out += ":" + SERVER_NAME + " " + RPL_ENDOFWHO + " " + nickname +
+		" " + this->target + " :End of /WHO list" + CLDR;
+	return (true);
+}
+
+/*
+	RPL_NAMREPLY (353) lines of at most NAMES_LINE_LENGTH characters, operators
+	first with their '@' prefix, then RPL_ENDOFNAMES (366).
+*/
+bool	ReplyCursor::resumeNames(const std::string& nickname, const std::map<int, Client>& clientMap,
+			const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget) {
+	std::map<std::string, Channel>::const_iterator chanIt = channels.find(this->target);
+	if (chanIt != channels.end()) {
+		const Channel& chan = chanIt->second;
+
+		std::string names;
+
+		while (this->phase < 2 && budget > 0) {
+			const std::set<int>& pool = (this->phase == 0) ? chan.getOperators() : chan.getMembers();
+			std::set<int>::const_iterator it = (this->lastFd < 0) ? pool.begin() : pool.upper_bound(this->lastFd);
+			bool lineFull = false;
+
+			for (; it != pool.end(); ++it) {
+				if (this->phase == 1 && chan.isOperator(*it))
+					continue;  // Already listed with the operators
+				std::map<int, Client>::const_iterator clientIt = clientMap.find(*it);
+				if (clientIt == clientMap.end())
+					continue;
+				std::string entry = (this->phase == 0 ? "@" : "") + clientIt->second.getNickname();
+				if (!names.empty() && names.length() + entry.length() + 1 > NAMES_LINE_LENGTH) {
+					lineFull = true;
+					break;
+				}
+				if (!names.empty())
+					names += " ";
+				names += entry;
+				this->lastFd = *it;
+			}
+			if (it == pool.end()) {
+				this->phase++;
+				this->lastFd = -1;
+			}
+			// Operators and regular members share lines, a line is only cut when full
+			if ((lineFull || this->phase == 2) && !names.empty()) {
+				out += ":" + SERVER_NAME + " " + RPL_NAMREPLY + " " + nickname + " = " +
+					this->target + " :" + names + CLDR;
+				names.clear();
+				budget--;
+			}
+		}
+		if (this->phase < 2)
+			return (false);
+	}
+	out += ":" + SERVER_NAME + " " + RPL_ENDOFNAMES + " " + nickname + " " +
+		this->target + " :End of /NAMES list" + CLDR;
+	return (true);
+}
+
+// RPL_LIST (322) per channel, then RPL_LISTEND (323)
+bool	ReplyCursor::resumeList(const std::string& nickname,
+			const std::map<std::string, Channel>& channels, std::string& out, unsigned int& budget) {
+	std::map<std::string, Channel>::const_iterator it = this->started ? channels.upper_bound(this->lastChannel) : channels.begin();
+
+	for (; it != channels.end() && budget > 0; ++it) {
+		const Channel& chan = it->second;
+		std::ostringstream oss;
+		oss << chan.getMemberCount();
+		out += ":" + SERVER_NAME + " " + RPL_LIST + " " + nickname + " " +
+			chan.getName() + " " + oss.str() + " :" + chan.getTopic() + CLDR;
+		this->lastChannel = it->first;
+		this->started = true;
+		budget--;
+	}
+	if (it != channels.end())
+		return (false);
+	out += ":" + SERVER_NAME + " " + RPL_LISTEND + " " + nickname + " :End of /LIST" + CLDR;
+	return (true);
+}
@@ -0,0 +1,66 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ScratchArena.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/31 10:27:44 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/31 10:27:44 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/ScratchArena.hpp"
+
+ScratchArena::ScratchArena() : strings(), used(0) {}
+
+ScratchArena::~ScratchArena() {}
+
+/**
+ * @brief The next scratch string, empty.
+ * @return A reference valid until reset().
+ */
+std::string&	ScratchArena::take(void) {
+	if (this->used == this->strings.size())
+		this->strings.push_back(std::string());
+	std::string& scratch = this->strings[this->used++];
+	scratch.clear();
+	return (scratch);
+}
+
+/**
+ * @brief Where the strings taken from now on start, for release().
+ */
+size_t	ScratchArena::mark(void) const {
+	return (this->used);
+}
+
+/**
+ * @brief Take back the strings taken since mark, the earlier ones stay.
+ */
+void	ScratchArena::release(size_t mark) {
+	if (mark < this->used)
+		this->used = mark;
+}
+
+/**
+ * @brief Take every string back, at the end of the loop iteration.
+ */
+void	ScratchArena::reset(void) {
+	if (this->strings.size() > SCRATCH_STRINGS)
+		this->strings.resize(SCRATCH_STRINGS);
+	size_t kept = this->used < this->strings.size() ? this->used : this->strings.size();
+	for (size_t i = 0; i < kept; i++){
+		if (this->strings[i].capacity() > SCRATCH_STRING_BYTES)
+			std::string().swap(this->strings[i]);
+	}
+	this->used = 0;
+}
+
+size_t	ScratchArena::getMemoryUsage(void) const {
+	size_t bytes = 0;
+
+	for (size_t i = 0; i < this->strings.size(); i++)
+		bytes += stringBytes(this->strings[i]);
+	return (bytes);
+}
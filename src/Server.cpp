@@ -12,8 +12,8 @@
 
 #include "../includes/Server.hpp"
 
-Server::Server(){}
-Server::Server(const Server& right){
+Server::Server() : hotClients(clientMap) {}
+Server::Server(const Server& right) : hotClients(clientMap) {
 	this->port = right.port;
 	this->serverSocket = right.serverSocket;
 	this->pollManager = right.pollManager;
@@ -32,7 +32,7 @@ Server& Server::operator=(const Server& right){
 	return (*this);
 }
 
-Server::Server(int port, const std::string& password){
+Server::Server(int port, const std::string& password, const Config& config) : hotClients(clientMap) {
 	if ((port < 0) || (port > MAX_PORTS))
 		throw (Server::InvalidPortNumberException());
 	else if (port < RESERVED_PORTS)
@@ -41,9 +41,7 @@ Server::Server(int port, const std::string& password){
 		throw(Server::EmptyPasswordException());
 	this->port = port;
 	this->password = password;
-
-	//I added 1 becuase the server will be inside pollfd as well.
-	this->serverCapacity = NUMBER_OF_CLIENTS + 1;
+	loadSettings(config);
 	/**
 		AF_INET is just to specify that we are working with IPv4
 		SOCK_STREAM provides 2 way communication.
@@ -57,7 +55,7 @@ Server::Server(int port, const std::string& password){
 
 	this->serverAddress.sin_family = AF_INET;
 	this->serverAddress.sin_port = htons(this->port);
-	this->serverAddress.sin_addr.s_addr = inet_addr(SERVER_IP.c_str());
+	this->serverAddress.sin_addr.s_addr = inet_addr(this->listenAddress.c_str());
 
 	for (int i = 0; i < 8; i++)
 		this->serverAddress.sin_zero[i] = 0;
@@ -81,9 +79,50 @@ Server::Server(int port, const std::string& password){
 	int fcntlResult = fcntl(this->serverSocket, F_SETFL, O_NONBLOCK);
 	if (fcntlResult < 0)
 		throw (Server::FailedToMakeTheSocketNonBlockingException());
+	// Sockets are only handed to an upgraded binary explicitly, never inherited
+	fcntl(this->serverSocket, F_SETFD, FD_CLOEXEC);
+	initializeState(config);
+	if (config.getMetricsPort() > 0)
+		openMetrics(config.getMetricsAddress(), config.getMetricsPort());
+	if (!config.getAdminSocket().empty())
+		openAdmin(config.getAdminSocket());
+	// Not on upgrade: the old process still writes the file until it exits
+	if (!config.getCapture().empty())
+		this->capture.start(config.getCapture());
+}
+
+/**
+ * @brief Take the settings of the config that are needed before the
+ * sockets exist.
+ * @param config The config.
+ */
+void	Server::loadSettings(const Config& config){
+	this->configPath = config.getPath();
+	this->listenAddress = config.getListenAddress();
+	this->maxClients = config.getMaxClients();
+	this->pollTimeout = config.getPollTimeout();
+	this->recvBuffer.assign(config.getBufferSize(), 0);
+	this->memoryBudget = config.getMemoryBudget();
+	this->nextMemoryCheck = 0;
+	this->sheddingLoad = false;
+	this->fanoutRing = config.getFanoutRing();
+	this->fanoutWake = false;
+
+	//I added 1 becuase the server will be inside pollfd as well.
+	this->serverCapacity = this->maxClients + 1;
+}
+
+/**
+ * @brief Allocate the pollfd array around the listening socket and create
+ * the predefined channels and connection classes.
+ * @param config The config.
+ * @throw FailedToInitalizePollFd if the pollfd array can't be allocated.
+ */
+void	Server::initializeState(const Config& config){
 	try {
-		this->clients = new pollfd[this->serverCapacity];
-		for (unsigned int i = 0; i < this->serverCapacity; i++){
+		// The metrics and admin listeners and their connections come after the client slots
+		this->clients = new pollfd[this->serverCapacity + SERVICE_SLOTS];
+		for (unsigned int i = 0; i < this->serverCapacity + SERVICE_SLOTS; i++){
 			this->clients[i].fd = -1;
 			this->clients[i].events = 0;
 			this->clients[i].revents = 0;
@@ -94,10 +133,48 @@ Server::Server(int port, const std::string& password){
 		(void)err;
 		throw (Server::FailedToInitalizePollFd());
 	}
-	channels.insert(std::make_pair("#general", Channel("#general")));
-	channels.insert(std::make_pair("#random", Channel("#random")));
-	channels.insert(std::make_pair("#help", Channel("#help")));
-	channels.insert(std::make_pair("#admins", Channel("#admins")));
+	for (size_t i = 0; i < config.getChannels().size(); i++){
+		const std::string& name = config.getChannels()[i];
+		channels.insert(std::make_pair(name, Channel(name)));
+	}
+	this->stateDir = config.getStateDir();
+	if (!this->stateDir.empty()){
+		unsigned long started = currentTimeMs();
+		this->channelStore.open(this->stateDir);
+		size_t records = this->channelStore.load(this->channels);
+		// Start from a single snapshot, the journal only holds this run's changes
+		this->channelStore.compact(this->channels);
+		std::cout << "Loaded " << records << " channel records from " << this->stateDir
+			<< " in " << (currentTimeMs() - started) << " ms" << std::endl;
+	}
+	this->logDir = config.getLogDir();
+	this->loggedChannels = config.getLoggedChannels();
+	if (!this->logDir.empty()){
+		this->channelLogger.open(this->logDir);
+		this->logIndex.open(this->logDir);
+	}
+	this->operators = config.getOperators();
+	this->sessionGrace = config.getSessionGrace() * 1000;
+	this->nextDetachedId = DETACHED_ID_BASE;
+	this->metricsSocket = -1;
+	this->adminSocket = -1;
+	this->adminPath.clear();
+
+	this->connectionClasses = config.getClasses();
+	this->serverName = config.getServerName();
+	this->linkBlocks = config.getLinks();
+	this->keepaliveBucket = 0;
+	this->nextKeepaliveSweep = currentTimeMs();
+	this->nextRemoteId = REMOTE_ID_BASE;
+	this->remoteUserCount = 0;
+	this->lastLinkAttempt = 0;
+	// Ids of a later run are larger, clients can't mix up two runs' messages
+	this->nextMsgid = wallTimeMs() * 1000;
+	this->lastHistoryTime = 0;
+	this->historyBytes = 0;
+	this->reloadRequested = 0;
+	this->upgradeRequested = 0;
+	this->scheduledClients.assign(this->serverCapacity, false);
 	this->isRunning = true;
 }
 
@@ -137,8 +214,11 @@ Server::~Server(){
 		this->serverAddress.sin_zero[i] = 0;
 	}
 
+	// After an upgrade adminPath is empty, the socket file belongs to the new process
+	if (this->adminSocket >= 0 && !this->adminPath.empty())
+		unlink(this->adminPath.c_str());
 	if (this->clients){
-		for (unsigned int i = 0; i < this->serverCapacity; i++)
+		for (unsigned int i = 0; i < this->serverCapacity + SERVICE_SLOTS; i++)
 			closeClientConnection(this->clients[i]);
 		delete[] (this->clients);
 		this->clients = NULL;
@@ -172,25 +252,38 @@ void Server::sendWelcomeMessages(pollfd& client) {
     ss.str(""); ss.clear();
     ss << ":" << SERVER_NAME << " " << RPL_WELCOME << " " << nick
        << " :" << MSG_WELCOME << " " << nick << "!" << user << "@localhost" << CLDR;
-    sendMessage(client, ss.str());
+    queueMessage(client.fd, ss.str());
 
     // 002 RPL_YOURHOST
     ss.str(""); ss.clear();
     ss << ":" << SERVER_NAME << " " << RPL_YOURHOST << " " << nick
        << " :Your host is " << SERVER_NAME << ", running version " << SERVER_VERSION << CLDR;
-    sendMessage(client, ss.str());
+    queueMessage(client.fd, ss.str());
 
     // 003 RPL_CREATED
     ss.str(""); ss.clear();
     ss << ":" << SERVER_NAME << " " << RPL_CREATED << " " << nick
        << " :" << MSG_SERVER_CREATION << CLDR;
-    sendMessage(client, ss.str());
+    queueMessage(client.fd, ss.str());
 
     // 004 RPL_MYINFO
     ss.str(""); ss.clear();
     ss << ":" << SERVER_NAME << " " << RPL_MYINFO << " " << nick
        << " " << SERVER_NAME << " " << SERVER_VERSION << " o o" << CLDR;
-    sendMessage(client, ss.str());
+    queueMessage(client.fd, ss.str());
+
+    // 005 RPL_ISUPPORT
+    ss.str(""); ss.clear();
+    ss << ":" << SERVER_NAME << " " << RPL_ISUPPORT << " " << nick
+       << " CHANTYPES=" << WEECHAT_CHANNEL_PREFIX
+       << " TARGMAX=" << WEECHAT_PRIVMSG << ":" << MAX_MESSAGE_TARGETS
+       << "," << WEECHAT_NOTICE << ":" << MAX_MESSAGE_TARGETS
+       << " CHATHISTORY=" << CHATHISTORY_LIMIT << " MSGREFTYPES=timestamp,msgid"
+       << " :are supported by this server" << CLDR;
+    queueMessage(client.fd, ss.str());
+
+    // RESUME TOKEN, for clients that asked for draft/resume-0.5
+    updateSessionToken(client.fd);
 }
 
 /**
@@ -249,6 +342,20 @@ bool	Server::isNicknameInUse(const std::string& nickname){
 	return false;
 }
 
+/**
+ * @brief Find the client using a nickname
+ * @param nickname The nickname to look for
+ * @return The client's fd, or -1 if nobody uses it
+ */
+int	Server::findClientByNickname(const std::string& nickname) const{
+	for (std::map<int, Client>::const_iterator it = this->clientMap.begin();
+	     it != this->clientMap.end(); ++it) {
+		if (it->second.getNickname() == nickname)
+			return (it->first);
+	}
+	return (-1);
+}
+
 /**
  * @brief Send a numeric reply to a client (RFC 2812 format)
  * @param clientFd The client file descriptor
@@ -266,11 +373,345 @@ void	Server::sendNumericReply(pollfd& client, const std::string& numeric, const
 		}
 	}
 	
-	std::string response = ":" + SERVER_NAME + " " + numeric + " " + nickname + " " + message + CLDR;
-	sendMessage(client, response);
+	std::string& response = this->scratch.take();
+	response.append(":").append(SERVER_NAME).append(" ").append(numeric).append(" ").append(nickname);
+	response.append(" ").append(message).append(CLDR);
+	queueMessage(client.fd, response);
+}
+
+/**
+ * @brief Queue a message for a client. Nothing is written here, the event loop
+ * flushes every queue once per iteration and again whenever poll() reports
+ * the socket as writable.
+ * @param clientFd The client file descriptor
+ * @param message The message to queue
+ */
+void	Server::queueMessage(int clientFd, const std::string& message){
+	std::map<int, Client>::iterator it = this->clientMap.find(clientFd);
+	// Users of other servers have no socket here, their traffic goes through propagate()
+	if (it == this->clientMap.end() || it->second.isRemote())
+		return;
+	it->second.queueOutput(message);
+	std::cout << "Server sent: " << message;
+}
+
+/**
+ * @brief Write as much of the client's output queue as the socket accepts
+ * and update the poll events accordingly.
+ * @param client The client.
+ * @return false if the connection is broken and the client must be cleaned.
+ * @author Hamad
+ */
+bool	Server::flushClient(pollfd& client){
+	std::map<int, Client>::iterator it = this->clientMap.find(client.fd);
+	if (it == this->clientMap.end())
+		return (true);
+	Client& clientObj = it->second;
+	size_t queued = clientObj.getOutputSize();
+
+	while (clientObj.hasPendingOutput()){
+		ssize_t sentBytes = send(client.fd, clientObj.getOutput().c_str(), clientObj.getOutputSize(), DEFAULT_FLAG_SEND);
+		if (sentBytes < 0){
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				break;
+			return (false);
+		}
+		if (sentBytes == 0)
+			break;
+		const char *sent = clientObj.getOutput().data();
+		unsigned long lines = std::count(sent, sent + sentBytes, '\n');
+		this->metrics.add(Metrics::MESSAGES_OUT, lines);
+		clientObj.countLinesOut(lines, currentTimeMs());
+		this->metrics.add(Metrics::BYTES_OUT, sentBytes);
+		clientObj.consumeOutput(static_cast<size_t>(sentBytes));
+	}
+	// A member a ring left behind can take more (see drainFanout())
+	if (queued >= SENDQ_LOW_WATERMARK && clientObj.getOutputSize() < SENDQ_LOW_WATERMARK)
+		this->fanoutWake = true;
+	// Ask poll() to wake us up when we can write again or continue a reply cursor.
+	client.events = POLLIN;
+	if (clientObj.hasPendingOutput() || hasReplyCursor(client.fd))
+		client.events |= POLLOUT;
+	return (true);
+}
+
+/**
+ * @brief Run the complete lines in the client's input buffer, stopping early
+ * if a reply cursor is pending so later replies can't overtake it, or if
+ * the client ran out of flood tokens.
+ * @param client The client.
+ * @param maxCommands How many lines may run in this turn.
+ * @return true if the client was stopped by flood control.
+ */
+bool	Server::processInput(pollfd& client, unsigned int maxCommands){
+	std::map<int, std::string>::iterator bufIt = this->clientBuffer.find(client.fd);
+	if (bufIt == this->clientBuffer.end())
+		return (false);
+	unsigned long now = currentTimeMs();
+	size_t endPosition = bufIt->second.find(CLDR);
+	for (unsigned int done = 0; done < maxCommands && endPosition != std::string::npos && !hasReplyCursor(client.fd); done++){
+		Client& clientObj = this->clientMap[client.fd];
+		const ConnectionClass& connectionClass = this->connectionClasses[clientObj.getConnectionClass()];
+		if (!connectionClass.isExempt() && !clientObj.isServer()){
+			unsigned int cost = 1 + endPosition / FLOOD_PENALTY_BYTES;
+			if (!clientObj.takeFloodTokens(now, connectionClass.getFloodRate(), connectionClass.getFloodBurst(), cost)){
+				// The remaining lines wait in the buffer until the bucket refills
+				return (true);
+			}
+		}
+		// The command's scratch strings go back once it ran
+		size_t scratchMark = this->scratch.mark();
+		std::string& message = this->scratch.take();
+		message.assign(bufIt->second, 0, endPosition);
+		bufIt->second.erase(0, endPosition + 2);
+		HAI_PROBE2(frame, client.fd, endPosition);
+		this->metrics.add(Metrics::MESSAGES_IN, 1);
+		clientObj.countLinesIn(1, now);
+		// Use RFC-compliant message handler
+		handleMessage(client, message);
+		this->scratch.release(scratchMark);
+
+		// Check if client still valid after handling message
+		if (client.fd < 0)
+			break;
+		endPosition = bufIt->second.find(CLDR);
+	}
+	return (false);
+}
+
+bool	Server::hasPendingCommand(int clientFd) const{
+	std::map<int, std::string>::const_iterator bufIt = this->clientBuffer.find(clientFd);
+	return (bufIt != this->clientBuffer.end() && bufIt->second.find(CLDR) != std::string::npos);
+}
+
+/**
+ * @brief Whether a client's next command must not wait behind bulk traffic:
+ * registration (the client isn't registered yet) and PING/PONG, so liveness
+ * checks never time out because of other clients. The command is found as
+ * Message::parse() does, past the tags and the prefix, in any case.
+ * @param clientFd The client file descriptor
+ */
+bool	Server::isPriorityInput(int clientFd){
+	if (!this->clientMap[clientFd].isFullyRegistered())
+		return (true);
+	const std::string& buffer = this->clientBuffer[clientFd];
+	size_t end = buffer.find(CLDR);
+	size_t pos = 0;
+
+	if (end == std::string::npos)
+		return (false);
+	if (buffer[pos] == '@')
+		pos = buffer.find_first_not_of(' ', buffer.find(' ', pos));
+	if (pos < end && buffer[pos] == ':')
+		pos = buffer.find_first_not_of(' ', buffer.find(' ', pos));
+	if (pos >= end)
+		return (false);
+	std::string command = buffer.substr(pos, std::min(buffer.find(' ', pos), end) - pos);
+	for (size_t i = 0; i < command.length(); i++)
+		command[i] = std::toupper(command[i]);
+	return (command == WEECHAT_PING || command == WEECHAT_PONG);
+}
+
+/**
+ * @brief Put a client at the end of the run queue if it has commands waiting.
+ * A client with a reply cursor, or a user with SENDQ_LOW_WATERMARK of output
+ * not written yet, waits out of the queue: its commands could not run or would
+ * only add to what it doesn't read. resumeReplyCursors() and the flush put
+ * it back once that is done.
+ * @param slot The index of the client in the pollfd array.
+ */
+void	Server::scheduleInput(unsigned int slot){
+	int fd = this->clients[slot].fd;
+	if (fd < 0 || this->scheduledClients[slot] || !hasPendingCommand(fd) || hasReplyCursor(fd))
+		return;
+	std::map<int, Client>::const_iterator it = this->clientMap.find(fd);
+	if (it != this->clientMap.end() && !it->second.isServer() && it->second.getOutputSize() >= SENDQ_LOW_WATERMARK)
+		return;
+	this->scheduledClients[slot] = true;
+	this->readyClients.push_back(slot);
+}
+
+/**
+ * @brief Run one round of the scheduler: every queued client gets a turn of
+ * at most COMMANDS_PER_TURN commands, priority input first, then goes back in
+ * the queue if it still has work. A client pasting thousands of lines only
+ * delays the others by a few commands per round.
+ * @author Hamad
+ */
+void	Server::runScheduler(void){
+	std::deque<unsigned int> round;
+	std::vector<unsigned int> order;
+
+	round.swap(this->readyClients);
+	for (size_t i = 0; i < round.size(); i++)
+		this->scheduledClients[round[i]] = false;
+	// Priority input first, keeping the queue order inside both groups
+	for (int pass = 0; pass < 2; pass++){
+		for (size_t i = 0; i < round.size(); i++){
+			int fd = this->clients[round[i]].fd;
+			if (fd >= 0 && isPriorityInput(fd) == (pass == 0))
+				order.push_back(round[i]);
+		}
+	}
+	for (size_t i = 0; i < order.size(); i++){
+		pollfd& client = this->clients[order[i]];
+		if (client.fd < 0)
+			continue;
+		// A link carries the traffic of a whole server, it gets a bigger turn
+		if (processInput(client, this->clientMap[client.fd].isServer() ? LINK_COMMANDS_PER_TURN : COMMANDS_PER_TURN))
+			this->throttledClients.push_back(order[i]);  // Retried when the flood timer fires
+		else if (client.fd >= 0)
+			scheduleInput(order[i]);
+	}
+}
+
+/**
+ * @brief Keepalive timing wheel. Slot i of the pollfd array is in bucket
+ * i % KEEPALIVE_SLOTS and one bucket is swept every PING_INTERVAL_MS /
+ * KEEPALIVE_SLOTS, so a full server sends its PINGs evenly over the
+ * interval instead of all at once. A connection that sent anything in the
+ * last interval is skipped, a silent one gets a PING, one still silent a
+ * turn after its PING is dead. The dead are collected over the buckets due
+ * and dropped together at the end.
+ * @param now currentTimeMs() of this iteration.
+ * @author Hamad
+ */
+void	Server::sweepKeepalive(unsigned long now){
+	unsigned long step = PING_INTERVAL_MS / KEEPALIVE_SLOTS;
+	std::vector<unsigned int> dead;
+
+	// Back from a long stall (e.g. a stopped process): one turn is enough
+	if (now > this->nextKeepaliveSweep + PING_INTERVAL_MS)
+		this->nextKeepaliveSweep = now - PING_INTERVAL_MS;
+	while (now >= this->nextKeepaliveSweep){
+		for (unsigned int i = this->keepaliveBucket; i < this->serverCapacity; i += KEEPALIVE_SLOTS){
+			int fd = this->clients[i].fd;
+			if (i == 0 || fd < 0)
+				continue;
+			Client& clientObj = this->clientMap[fd];
+			if (now - clientObj.getLastActivity() < PING_INTERVAL_MS)
+				continue;
+			if (clientObj.isPingSent())
+				dead.push_back(i);
+			else {
+				queueMessage(fd, PING_LINE);
+				clientObj.setPingSent(true);
+			}
+		}
+		this->keepaliveBucket = (this->keepaliveBucket + 1) % KEEPALIVE_SLOTS;
+		this->nextKeepaliveSweep += step;
+	}
+	for (size_t i = 0; i < dead.size(); i++){
+		pollfd& client = this->clients[dead[i]];
+		if (client.fd < 0)
+			continue;
+		std::ostringstream reason;
+		reason << MSG_PING_TIMEOUT << ": " << (now - this->clientMap[client.fd].getLastActivity()) / 1000 << " seconds";
+		if (!detachClient(client))
+			disconnectClient(client, reason.str());
+	}
+}
+
+void	Server::queueReplyCursor(int clientFd, const ReplyCursor& cursor){
+	this->replyCursors[clientFd].push_back(cursor);
+}
+
+bool	Server::hasReplyCursor(int clientFd) const{
+	return (this->replyCursors.find(clientFd) != this->replyCursors.end());
+}
+
+/**
+ * @brief Give every pending reply cursor one bounded turn. A cursor only runs
+ * while its client's queue is below SENDQ_LOW_WATERMARK, so a huge WHO is
+ * produced as fast as the client reads it and never stalls the loop.
+ * When a client's last cursor finishes its waiting commands are resumed.
+ * @author Hamad
+ */
+void	Server::resumeReplyCursors(void){
+	for (unsigned int i = 1; i < this->serverCapacity && !this->replyCursors.empty(); i++){
+		pollfd& client = this->clients[i];
+		if (client.fd < 0)
+			continue;
+		std::map<int, std::deque<ReplyCursor> >::iterator cursorIt = this->replyCursors.find(client.fd);
+		if (cursorIt == this->replyCursors.end())
+			continue;
+
+		Client& clientObj = this->clientMap[client.fd];
+		std::deque<ReplyCursor>& pending = cursorIt->second;
+		unsigned int budget = CURSOR_LINES_PER_TURN;
+		while (!pending.empty() && budget > 0 && clientObj.getOutputSize() < SENDQ_LOW_WATERMARK){
+			std::string out;
+			bool done = pending.front().resume(clientObj.getNickname(), this->clientMap, this->channels, out, budget);
+			clientObj.queueOutput(out);
+			if (!done)
+				break;
+			pending.pop_front();
+		}
+		if (pending.empty()){
+			this->replyCursors.erase(cursorIt);
+			scheduleInput(i);
+		}
+	}
+}
+
+/**
+ * @brief Find the connection class of a client.
+ * @param address The peer address in host byte order.
+ * @param pass The password the client gave, empty before PASS.
+ * @return Index in connectionClasses, -1 if no class accepts the client.
+ */
+int	Server::findConnectionClass(in_addr_t address, const std::string& pass) const{
+	for (size_t i = 0; i < this->connectionClasses.size(); i++){
+		if (this->connectionClasses[i].matches(address, pass))
+			return (static_cast<int>(i));
+	}
+	return (-1);
+}
+
+/**
+ * @brief Move a client in a connection class if the class has room for it.
+ * @param clientFd The client file descriptor
+ * @param classIndex Index in connectionClasses
+ * @return false if the class already has its maximum of clients.
+ */
+bool	Server::assignConnectionClass(int clientFd, int classIndex){
+	size_t	members = 0;
+
+	for (std::map<int, Client>::iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		if (it->first != clientFd && !it->second.isRemote() && it->second.getConnectionClass() == static_cast<size_t>(classIndex))
+			members++;
+	}
+	unsigned int limit = this->connectionClasses[classIndex].getMaxClients();
+	if (limit != 0 && members >= limit)
+		return (false);
+	this->clientMap[clientFd].setConnectionClass(classIndex);
+	return (true);
 }
 
-void Server::cleanClient(pollfd& client) {
+/**
+ * @brief Close a client's link telling it why (ERROR message).
+ * @param client The client.
+ * @param reason Why the link is closed, e.g. MSG_EXCESS_FLOOD.
+ */
+void	Server::disconnectClient(pollfd& client, const std::string& reason){
+	std::map<int, Client>::iterator it = this->clientMap.find(client.fd);
+	if (it != this->clientMap.end()){
+		// Whatever is still queued is dropped, the ERROR has to fit in the socket
+		it->second.consumeOutput(it->second.getOutputSize());
+		queueMessage(client.fd, WEECHAT_ERROR + " :Closing Link: " + it->second.getHostname() +
+			" (" + reason + ")" + CLDR);
+	}
+	cleanClient(client);
+}
+
+/**
+ * @brief Forget a connection: channels, buffers, socket. The rest of the
+ * network is told too, a link takes its servers and users with it.
+ * @param client The client.
+ * @param announce false when the network already knows the client is gone
+ * (KILL), a QUIT would then hit whoever has the nickname by now.
+ */
+void Server::cleanClient(pollfd& client, bool announce) {
     if (client.fd < 0)
         return;
     
@@ -285,11 +726,17 @@ void Server::cleanClient(pollfd& client) {
         return;
     }
     
+    HAI_PROBE1(close, client.fd);
     std::string nickname = clientIt->second.getNickname();
     if (nickname.empty())
         nickname = "*";
     
     std::cout << nickname << " Has disconnected!" << std::endl;
+
+    if (clientIt->second.getLinkState() == Client::LINK_ESTABLISHED)
+        splitLink(client.fd, "Connection closed");
+    else if (announce && clientIt->second.isFullyRegistered())
+        propagate(":" + nickname + " QUIT :Client disconnected" + CLDR, -1);
     
     // Remove from all channels and handle auto-promotion
     for (std::map<std::string, Channel>::iterator it = channels.begin(); 
@@ -298,7 +745,8 @@ void Server::cleanClient(pollfd& client) {
         if (chan.hasMember(client.fd)) {
             // Broadcast QUIT to channel members (before removing)
             std::string quitMsg = ":" + nickname + " QUIT :Client disconnected" + CLDR;
-            chan.broadcast(quitMsg, client.fd);
+            chan.broadcast(hotClients, quitMsg, client.fd);
+            logChannel(chan, quitMsg);
             
             // Remove and check for auto-promotion
             int newOpFd = chan.removeMember(client.fd);
@@ -310,14 +758,21 @@ void Server::cleanClient(pollfd& client) {
                     std::string newOpNick = newOpIt->second.getNickname();
                     std::string modeMsg = ":" + SERVER_NAME + " MODE " + it->first + 
                                           " +o " + newOpNick + CLDR;
-                    chan.broadcast(modeMsg);
+                    chan.broadcast(hotClients, modeMsg);
                 }
             }
         }
     }
     
+    // Best effort: hand over what was queued (e.g. the error that closes the link)
+    flushClient(client);
+
     // Clean up client data
+    capture.closeSession(client.fd);
+    sessionTokens.erase(clientIt->second.getSessionToken());
     clientMap.erase(client.fd);
+    hotClients.erase(client.fd);
+    replyCursors.erase(client.fd);
     clientBuffer.erase(client.fd);
     
     // Close the socket
@@ -334,37 +789,18 @@ void Server::cleanClient(pollfd& client) {
  * @param command The IRC command (e.g., PASS, NICK, USER, JOIN, PRIVMSG)
  * @param params The command parameters
  */
-void	Server::processCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params){
-	std::string cmd = command;
+void	Server::processCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params, const std::string& tags){
+	std::string& cmd = this->scratch.take();
+	cmd.assign(command);
 	for (size_t i = 0; i < cmd.length(); i++) {
 		cmd[i] = std::toupper(cmd[i]);
 	}
 
 	Client& clientObj = this->clientMap[client.fd];
 
-	// Handle CAP command (client capability negotiation)
-	if (cmd == "CAP") {
-		if (params.size() > 0) {
-			std::string subCmd = params[0];
-			for (size_t i = 0; i < subCmd.length(); i++) {
-				subCmd[i] = std::toupper(subCmd[i]);
-			}
-			
-			std::string nick = clientObj.isNicknameSet() ? clientObj.getNickname() : "*";
-			
-			if (subCmd == "LS") {
-				// Respond with supported capabilities (none for basic IRC)
-				std::string response = ":" + SERVER_NAME + " CAP " + nick + " LS :" + CLDR;
-				sendMessage(client, response);
-			} else if (subCmd == "REQ") {
-				// Acknowledge capability request (but we don't support any)
-				std::string response = ":" + SERVER_NAME + " CAP " + nick + " ACK :" + CLDR;
-				sendMessage(client, response);
-			} else if (subCmd == "END") {
-				// End capability negotiation
-				// No response needed, client will proceed with registration
-			}
-		}
+	// Handle CAP command (client capability negotiation, see ServerCapability.cpp)
+	if (cmd == WEECHAT_CAP) {
+		negotiateCapabilities(client, params);
 		return;
 	}
 
@@ -379,18 +815,38 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 			sendNumericReply(client, ERR_NEEDMOREPARAMS, "PASS :Not enough parameters");
 			return;
 		}
+		// PASS <password> <version> <flags>: a server, checked against its link block with SERVER
+		if (params.size() >= 3) {
+			clientObj.setLinkPassword(params[0]);
+			return;
+		}
 		
+		/*
+			Besides the server password, a connection class can have its own
+			password (e.g. for bots), giving access to that class.
+		*/
 		std::string password = params[0];
-		if (password != this->password) {
+		int classIndex = findConnectionClass(clientObj.getAddress(), password);
+		bool classPassword = (classIndex >= 0 && !this->connectionClasses[classIndex].getPassword().empty());
+		if (password != this->password && !classPassword) {
 			sendNumericReply(client, ERR_PASSWDMISMATCH, ":Password incorrect");
 			cleanClient(client);
 			return;
 		}
+		if (classIndex < 0 || !assignConnectionClass(client.fd, classIndex)) {
+			disconnectClient(client, MSG_CLASS_FULL);
+			return;
+		}
 		
 		clientObj.setPasswordAuthenticated(true);
 		return;
 	}
 
+	if (cmd == WEECHAT_SERVER) {
+		acceptLink(client, params);
+		return;
+	}
+
 	// Handle NICK command - set or change nickname
 	if (cmd == "NICK") {
 		if (params.size() < 1) {
@@ -411,11 +867,19 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 		}
 
 		bool wasRegistered = clientObj.isFullyRegistered();
+		std::string oldNickname = clientObj.getNickname();
 		clientObj.setNickname(nickname);
 		clientObj.setNicknameSet(true);
+		// Nick collisions between servers are settled by this timestamp
+		clientObj.setNicknameTs(std::time(NULL));
 		
 		if (!wasRegistered && clientObj.isFullyRegistered()) {
 			sendWelcomeMessages(client);
+			introduceUser(client.fd);
+		} else if (wasRegistered) {
+			std::ostringstream change;
+			change << ":" << oldNickname << " NICK " << nickname << " " << clientObj.getNicknameTs() << CLDR;
+			propagate(change.str(), -1);
 		}
 		return;
 	}
@@ -453,20 +917,34 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 		
 		if (!wasRegistered && clientObj.isFullyRegistered()) {
 			sendWelcomeMessages(client);
+			introduceUser(client.fd);
 		}
 		return;
 	}
 
+	// The answer to a keepalive PING, the input itself already counted
+	if (cmd == WEECHAT_PONG)
+		return;
+
 	// Commands that require authentication
 	if (!clientObj.isPasswordAuthenticated()) {
 		sendNumericReply(client, ERR_NOTREGISTERED, ":You have not registered");
 		return;
 	}
 
+	// Take back a dropped session instead of registering (see ServerSession.cpp)
+	if (cmd == WEECHAT_RESUME) {
+		resumeSession(client, params);
+		return;
+	}
+
 		if (cmd == WEECHAT_PING){
-			std::string pongMsg = params.size() > 0 ? params[0] : SERVER_NAME;
-			std::string response = ":" + SERVER_NAME + " PONG " + SERVER_NAME + " :" + pongMsg + CLDR;
-			sendMessage(client, response);
+			// Only the token is appended to the preformatted reply
+			std::string response;
+			const std::string& token = params.size() > 0 ? params[0] : SERVER_NAME;
+			response.reserve(PONG_PREFIX.length() + token.length() + CLDR.length());
+			response.append(PONG_PREFIX).append(token).append(CLDR);
+			queueMessage(client.fd, response);
 			return ;
 		}
 		// Handle WHO command (WeeChat compatibility)
@@ -485,28 +963,14 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 					return;
 				}
 				
-				Channel& chan = chanIt->second;
-				const std::set<int>& members = chan.getMembers();
-				
-				// Send RPL_WHOREPLY (352) for each member
-				for (std::set<int>::const_iterator it = members.begin(); it != members.end(); ++it) {
-					std::map<int, Client>::iterator memIt = clientMap.find(*it);
-					if (memIt != clientMap.end()) {
-						Client& member = memIt->second;
-						std::string flags = chan.isOperator(*it) ? "@" : "";
-						std::string whoReply = ":" + SERVER_NAME + " 352 " + clientObj.getNickname() +
-							" " + target + " " + member.getUsername() + " localhost " +
-							SERVER_NAME + " " + member.getNickname() + " H" + flags +
-							" :0 " + member.getRealname() + CLDR;
-						sendMessage(client, whoReply);
-					}
-				}
+				queueReplyCursor(client.fd, ReplyCursor(ReplyCursor::WHO, target));
+				return;
 			}
 			
 			// Send RPL_ENDOFWHO (315)
-			std::string endWho = ":" + SERVER_NAME + " 315 " + clientObj.getNickname() +
+			std::string endWho = ":" + SERVER_NAME + " " + RPL_ENDOFWHO + " " + clientObj.getNickname() +
 				" " + target + " :End of /WHO list" + CLDR;
-			sendMessage(client, endWho);
+			queueMessage(client.fd, endWho);
 			return;
 		}
 		if (cmd == WEECHAT_QUIT){
@@ -522,11 +986,13 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 					Channel& chan = it->second;
 					if (chan.hasMember(client.fd)) {
 						std::string quitMsg = ":" + nickname + " QUIT :" + reason + CLDR;
-						chan.broadcast(quitMsg);
+						chan.broadcast(hotClients, quitMsg);
 					}
 				}
+				if (clientObj.isFullyRegistered())
+					propagate(":" + nickname + " QUIT :" + reason + CLDR, -1);
 			}
-			cleanClient(client);
+			cleanClient(client, false);
 			return;
 		}
 		// Handle NAMES command
@@ -535,7 +1001,7 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 				// No parameter - could list all channels, but we'll just return end
 				std::string endMsg = ":" + SERVER_NAME + " 366 " + 
 					clientObj.getNickname() + " * :End of /NAMES list" + CLDR;
-				sendMessage(client, endMsg);
+				queueMessage(client.fd, endMsg);
 				return;
 			}
 			
@@ -547,121 +1013,69 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 				return;
 			}
 			
-			Channel& chan = it->second;
-			std::string namesReply = chan.getNamesReply(clientMap);
-			sendMessage(client, namesReply);
+			queueReplyCursor(client.fd, ReplyCursor(ReplyCursor::NAMES, channelName));
 			return;
 		}
 		
 		if (cmd == WEECHAT_LIST) {
-			for (std::map<std::string, Channel>::iterator it = channels.begin(); it != channels.end(); ++it) {
-				Channel &chan = it->second;
-				std::ostringstream oss;
-				oss << chan.getMemberCount();
-			std::string memberCountStr = oss.str();
-			std::string msg = ":" + SERVER_NAME + " " + RPL_LIST + " " +
-				clientObj.getNickname() + " " +
-				chan.getName() + " " +
-				memberCountStr +
-				" :" + chan.getTopic() + CLDR;
-			sendMessage(client, msg); 
+			queueReplyCursor(client.fd, ReplyCursor(ReplyCursor::LIST, ""));
+			return;
 		}
-		std::string endMsg = ":" + SERVER_NAME + " " + RPL_LISTEND + " " +
-		clientObj.getNickname() + " :End of /LIST" + CLDR;
-		sendMessage(client, endMsg);
-		return;
-	}
 	if (cmd == WEECHAT_JOIN) {
 		if (params.size() < 1) {
 			sendNumericReply(client, ERR_NEEDMOREPARAMS, "JOIN :Not enough parameters");
 			return;
 		}
-		std::string channelName = params[0];
-
-		// Check if the channel exists
-		std::map<std::string, Channel>::iterator it = channels.find(channelName);
-		if (it == channels.end()) {
-			sendNumericReply(client, ERR_NOSUCHCHANNEL, channelName + " :No such channel");
+		// JOIN #a,#b,#c keyA,,keyC : keys are matched to channels by position, empty for none
+		std::vector<std::string> channelNames = splitList(params[0], ',');
+		std::vector<std::string> keys;
+		if (params.size() >= 2)
+			keys = splitList(params[1], ',', true);
+		for (size_t i = 0; i < channelNames.size() && client.fd >= 0; i++)
+			joinChannel(client, channelNames[i], i < keys.size() ? keys[i] : "");
+		return;
+	}
+	if (cmd == WEECHAT_PRIVMSG || cmd == WEECHAT_NOTICE || cmd == WEECHAT_TAGMSG){
+		handleMessageCommand(client, cmd, params, tags);
+		return;
+	}
+	if (cmd == WEECHAT_AWAY) {
+		setAway(client, params);
+		return;
+	}
+	if (cmd == WEECHAT_CHATHISTORY) {
+		chatHistory(client, params);
+		return;
+	}
+	if (cmd == WEECHAT_OPER) {
+		if (!clientObj.isFullyRegistered()) {
+			sendNumericReply(client, ERR_NOTREGISTERED, ":You have not registered");
 			return;
 		}
-		Channel &chan = it->second;
-
-		// If invite-only, make sure the client is invited
-		if (chan.isInviteOnly() && !chan.isInvited(client.fd)) {
-			sendNumericReply(client, ERR_INVITEONLYCHAN, channelName + " :Cannot join channel (+i)");
+		if (params.size() < 2) {
+			sendNumericReply(client, ERR_NEEDMOREPARAMS, "OPER :Not enough parameters");
 			return;
 		}
-
-		// If channel has a key (+k), check if provided
-		if (!chan.getKey().empty()) {
-			if (params.size() < 2 || params[1] != chan.getKey()) {
-				sendNumericReply(client, ERR_BADCHANNELKEY, channelName + " :Cannot join channel (+k)");
-				return;
-			}
-		}
-
-		// If user limit (+l) is set
-		if (chan.getUserLimit() > 0 && (int)chan.getMemberCount() >= chan.getUserLimit()) {
-			sendNumericReply(client, ERR_CHANNELISFULL, channelName + " :Cannot join channel (+l)");
+		std::map<std::string, std::string>::const_iterator oper = this->operators.find(params[0]);
+		if (oper == this->operators.end()) {
+			sendNumericReply(client, ERR_NOOPERHOST, ":No O-lines for your host");
 			return;
 		}
-		
-		// Add client to channel
-		chan.addMember(client.fd);
-
-		// If this is the first member, make them operator
-		if (chan.getMemberCount() == 1) {
-			chan.addOperator(client.fd);
-			std::string opMsg = ":" + SERVER_NAME + " MODE " + channelName + " +o " + clientObj.getNickname() + CLDR;
-    		sendMessage(client, opMsg);
-		}
-
-		// Broadcast JOIN to all channel members
-		std::string joinMsg = ":" + clientObj.getNickname() + " JOIN " + channelName + CLDR;
-		chan.broadcast(joinMsg);
-
-		// Send topic if any
-		std::string topic = chan.getTopic();
-		if (!topic.empty()) {
-			sendNumericReply(client, RPL_TOPIC, channelName + " :" + topic);
+		if (oper->second != params[1]) {
+			sendNumericReply(client, ERR_PASSWDMISMATCH, ":Password incorrect");
+			return;
 		}
-
-		// Send NAMES list
-		std::string namesReply = chan.getNamesReply(clientMap);
-		sendMessage(client, namesReply);
+		clientObj.setServerOperator(true);
+		sendNumericReply(client, RPL_YOUREOPER, ":You are now an IRC operator");
+		queueMessage(client.fd, ":" + clientObj.getNickname() + " MODE " + clientObj.getNickname() + " :+o" + CLDR);
 		return;
 	}
-	if (cmd == WEECHAT_PRIVMSG){
-		// Need at least target + message
-		if (params.size() < 2){
-			sendNumericReply(client, ERR_NEEDMOREPARAMS, "PRIVMSG :Not enough parameters");
-			return;
-		}
-		std::string channelName = params[0];
-
-		// Channel must exist
-		if (this->channels.find(channelName) == this->channels.end()){
-			sendNumericReply(client, ERR_NOSUCHCHANNEL, channelName + " :No such channel");
-			return;
-		}
-
-		// Get channel by reference
-		Channel &channel = this->channels[channelName];
-
-		// Sender must be in the channel
-		if (!channel.hasMember(client.fd)){
-			sendNumericReply(client, ERR_CANNOTSENDTOCHAN, channelName + " :Cannot send to channel");
-			return;
-		}
-
-		// Build the message (no host, as requested)
-		std::string fullMsg;
-		fullMsg  = ":" + clientObj.getNickname();
-		fullMsg += "!" + clientObj.getUsername();
-		fullMsg += " PRIVMSG " + channelName + " :" + params[1] + CLDR;
-
-		// Broadcast to everyone except sender
-		channel.broadcast(fullMsg, client.fd);
+	if (cmd == WEECHAT_SEARCH) {
+		searchLogs(client, params);
+		return;
+	}
+	if (cmd == WEECHAT_MEMSTATS) {
+		memoryStats(client);
 		return;
 	}
 	// ============================================
@@ -715,13 +1129,16 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 
         // Set the new topic
         chan.setTopic(newTopic);
+        channelStore.markDirty(channelName);
 
         // Broadcast topic change to all channel members (including the setter)
         std::string topicMsg = ":" + clientObj.getNickname() + 
                                "!" + clientObj.getUsername() +
                                " TOPIC " + channelName + 
                                " :" + newTopic + CLDR;
-        chan.broadcast(topicMsg);  // Broadcast to EVERYONE
+        chan.broadcast(hotClients, topicMsg);  // Broadcast to EVERYONE
+        propagate(topicMsg, -1);
+        logChannel(chan, topicMsg);
 
         return;
     }
@@ -796,9 +1213,12 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
                           " :" + reason + CLDR;
 
     // Broadcast KICK to everyone in the channel (including the kicked user)
-    chan.broadcast(kickMsg);
+    chan.broadcast(hotClients, kickMsg);
+    propagate(kickMsg, -1);
+    logChannel(chan, kickMsg);
 
     // Remove the target from the channel and check for auto-promotion
+    catchUpMember(chan, targetFd);
     int newOpFd = chan.removeMember(targetFd);
     
     // If someone was auto-promoted, broadcast MODE +o
@@ -808,7 +1228,7 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
             std::string newOpNick = newOpIt->second.getNickname();
             std::string modeMsg = ":" + SERVER_NAME + " MODE " + channelName + 
                                   " +o " + newOpNick + CLDR;
-            chan.broadcast(modeMsg);
+            chan.broadcast(hotClients, modeMsg);
         }
     }
 
@@ -818,14 +1238,13 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
     //  PART COMMAND 
     // ============================================
     if (cmd == WEECHAT_PART) {
-        // PART #channel :reason
+        // PART #channel{,#channel} :reason
         // Need at least channel name
         if (params.size() < 1) {
             sendNumericReply(client, ERR_NEEDMOREPARAMS, "PART :Not enough parameters");
             return;
         }
 
-        std::string channelName = params[0];
         std::string reason = "Leaving";
         
         // Optional reason parameter
@@ -833,44 +1252,9 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
             reason = params[1];
         }
 
-        // Check if channel exists
-        std::map<std::string, Channel>::iterator it = channels.find(channelName);
-        if (it == channels.end()) {
-            sendNumericReply(client, ERR_NOSUCHCHANNEL, channelName + " :No such channel");
-            return;
-        }
-
-        Channel& chan = it->second;
-
-        // Must be in the channel to leave it
-        if (!chan.hasMember(client.fd)) {
-            sendNumericReply(client, ERR_NOTONCHANNEL, channelName + " :You're not on that channel");
-            return;
-        }
-
-        // Build PART message: :nick!user PART #channel :reason
-        std::string partMsg = ":" + clientObj.getNickname() + 
-                              "!" + clientObj.getUsername() + 
-                              " PART " + channelName + 
-                              " :" + reason + CLDR;
-
-        // Broadcast to everyone in channel (including the person leaving)
-        chan.broadcast(partMsg);
-
-        // Remove from channel and check for auto-promotion
-        int newOpFd = chan.removeMember(client.fd);
-        
-        // If someone was auto-promoted, broadcast MODE +o
-        if (newOpFd != -1) {
-            std::map<int, Client>::iterator newOpIt = clientMap.find(newOpFd);
-            if (newOpIt != clientMap.end()) {
-                std::string newOpNick = newOpIt->second.getNickname();
-                std::string modeMsg = ":" + SERVER_NAME + " MODE " + channelName + 
-                                      " +o " + newOpNick + CLDR;
-                chan.broadcast(modeMsg);
-            }
-        }
-
+        std::vector<std::string> channelNames = splitList(params[0], ',');
+        for (size_t i = 0; i < channelNames.size(); i++)
+            partChannel(client, channelNames[i], reason);
         return;
     }
 // ============================================
@@ -935,20 +1319,20 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
         // Send RPL_INVITING to the inviter (341)
         std::string invitingReply = ":" + SERVER_NAME + " 341 " + clientObj.getNickname() + 
                                     " " + targetNick + " " + channelName + CLDR;
-        sendMessage(client, invitingReply);
+        queueMessage(client.fd, invitingReply);
+
+        // A user of another server is invited by its own server
+        if (clientMap[targetFd].isRemote()) {
+            queueMessage(clientMap[targetFd].getLink(), ":" + clientObj.getNickname() + " INVITE " +
+                targetNick + " " + channelName + CLDR);
+            return;
+        }
 
         // Send INVITE message to the target user
         std::string inviteMsg = ":" + SERVER_NAME + " NOTICE " + targetNick + 
                                 " :You have been invited to " + channelName + 
                                 " by " + clientObj.getNickname() + CLDR;
-        
-        // Find the target's pollfd and send the message
-        for (unsigned int i = 1; i < serverCapacity; i++) {
-            if (clients[i].fd == targetFd) {
-                sendMessage(clients[i], inviteMsg);
-                break;
-            }
-        }
+        queueMessage(targetFd, inviteMsg);
 
         return;
     }
@@ -1007,7 +1391,7 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
             // RPL_CHANNELMODEIS (324)
             std::string reply = ":" + SERVER_NAME + " 324 " + clientObj.getNickname() + 
                                " " + channelName + " " + modes + modeParams + CLDR;
-            sendMessage(client, reply);
+            queueMessage(client.fd, reply);
             return;
         }
 
@@ -1018,6 +1402,8 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
         }
 
         std::string modeString = params[1];
+        // Written at the end of the iteration, even if a mode below bails out half way
+        channelStore.markDirty(channelName);
         bool adding = true;  // + = adding mode, - = removing mode
         size_t paramIndex = 2;  // Index for mode parameters
 
@@ -1168,7 +1554,9 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
                                   "!" + clientObj.getUsername() + 
                                   " MODE " + channelName + 
                                   " " + appliedModes + appliedParams + CLDR;
-            chan.broadcast(modeMsg);
+            chan.broadcast(hotClients, modeMsg);
+            propagate(modeMsg, -1);
+            logChannel(chan, modeMsg);
         }
 
         return;
@@ -1178,6 +1566,251 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
 	sendNumericReply(client, ERR_UNKNOWNCOMMAND, command + " :Unknown command");
 }
 
+/**
+ * @brief Join one channel of a (possibly comma separated) JOIN command.
+ * @param client The client joining
+ * @param channelName The channel to join
+ * @param key The key given for that channel, empty if none
+ * @note The replies are only queued, so a JOIN of many channels reaches the
+ * client in one flush at the end of the loop iteration.
+ */
+void	Server::joinChannel(pollfd& client, const std::string& channelName, const std::string& key){
+	Client& clientObj = this->clientMap[client.fd];
+
+	// Check if the channel exists
+	std::map<std::string, Channel>::iterator it = channels.find(channelName);
+	if (it == channels.end()) {
+		sendNumericReply(client, ERR_NOSUCHCHANNEL, channelName + " :No such channel");
+		return;
+	}
+	Channel &chan = it->second;
+
+	// Already there (typical for a client replaying its channels), nothing to do
+	if (chan.hasMember(client.fd))
+		return;
+
+	// If invite-only, make sure the client is invited
+	if (chan.isInviteOnly() && !chan.isInvited(client.fd)) {
+		sendNumericReply(client, ERR_INVITEONLYCHAN, channelName + " :Cannot join channel (+i)");
+		return;
+	}
+
+	// If channel has a key (+k), check if provided
+	if (!chan.getKey().empty()) {
+		if (key != chan.getKey()) {
+			sendNumericReply(client, ERR_BADCHANNELKEY, channelName + " :Cannot join channel (+k)");
+			return;
+		}
+	}
+
+	// If user limit (+l) is set
+	if (chan.getUserLimit() > 0 && (int)chan.getMemberCount() >= chan.getUserLimit()) {
+		sendNumericReply(client, ERR_CHANNELISFULL, channelName + " :Cannot join channel (+l)");
+		return;
+	}
+	
+	// Add client to channel
+	chan.addMember(client.fd);
+
+	// If this is the first member, make them operator
+	if (chan.getMemberCount() == 1) {
+		chan.addOperator(client.fd);
+		std::string opMsg = ":" + SERVER_NAME + " MODE " + channelName + " +o " + clientObj.getNickname() + CLDR;
+		queueMessage(client.fd, opMsg);
+	}
+
+	// Broadcast JOIN to all channel members
+	std::string joinMsg = ":" + clientObj.getNickname() + " JOIN " + channelName + CLDR;
+	chan.broadcast(hotClients, joinMsg);
+	catchUpMember(chan, client.fd);
+	propagate(joinMsg, -1);
+	logChannel(chan, joinMsg);
+	announceAway(chan, client.fd);
+
+	// Send topic if any
+	std::string topic = chan.getTopic();
+	if (!topic.empty()) {
+		sendNumericReply(client, RPL_TOPIC, channelName + " :" + topic);
+	}
+
+	// Send NAMES list
+	queueReplyCursor(client.fd, ReplyCursor(ReplyCursor::NAMES, channelName));
+}
+
+/**
+ * @brief Leave one channel of a (possibly comma separated) PART command.
+ * @param client The client leaving
+ * @param channelName The channel to leave
+ * @param reason The part message
+ */
+void	Server::partChannel(pollfd& client, const std::string& channelName, const std::string& reason){
+	Client& clientObj = this->clientMap[client.fd];
+
+	// Check if channel exists
+	std::map<std::string, Channel>::iterator it = channels.find(channelName);
+	if (it == channels.end()) {
+		sendNumericReply(client, ERR_NOSUCHCHANNEL, channelName + " :No such channel");
+		return;
+	}
+
+	Channel& chan = it->second;
+
+	// Must be in the channel to leave it
+	if (!chan.hasMember(client.fd)) {
+		sendNumericReply(client, ERR_NOTONCHANNEL, channelName + " :You're not on that channel");
+		return;
+	}
+
+	// Build PART message: :nick!user PART #channel :reason
+	std::string partMsg = ":" + clientObj.getNickname() + 
+						  "!" + clientObj.getUsername() + 
+						  " PART " + channelName + 
+						  " :" + reason + CLDR;
+
+	// Broadcast to everyone in channel (including the person leaving)
+	chan.broadcast(hotClients, partMsg);
+	propagate(partMsg, -1);
+	logChannel(chan, partMsg);
+
+	// Remove from channel and check for auto-promotion
+	catchUpMember(chan, client.fd);
+	int newOpFd = chan.removeMember(client.fd);
+	
+	// If someone was auto-promoted, broadcast MODE +o
+	if (newOpFd != -1) {
+		std::map<int, Client>::iterator newOpIt = clientMap.find(newOpFd);
+		if (newOpIt != clientMap.end()) {
+			std::string newOpNick = newOpIt->second.getNickname();
+			std::string modeMsg = ":" + SERVER_NAME + " MODE " + channelName + 
+								  " +o " + newOpNick + CLDR;
+			chan.broadcast(hotClients, modeMsg);
+		}
+	}
+}
+
+/**
+ * @brief PRIVMSG/NOTICE <target>{,<target>} :<text>, TAGMSG <target>{,<target>}
+ *
+ * Targets can be channels or nicknames, up to MAX_MESSAGE_TARGETS of them.
+ * The text is formatted once, each target gets one TaggedLine whose tag
+ * variants are shared by all of its recipients, and a client reached
+ * through several targets receives the message only once. The sender gets
+ * it back with echo-message. TAGMSG only carries the sender's client tags
+ * and only reaches message-tags clients of this server. NOTICE never
+ * generates error replies (RFC 2812 3.3.2).
+ *
+ * @param client The sender
+ * @param command WEECHAT_PRIVMSG, WEECHAT_NOTICE or WEECHAT_TAGMSG (already uppercased)
+ * @param params The command parameters
+ * @param tags The message tags as received, only the +client tags are relayed
+ */
+void	Server::handleMessageCommand(pollfd& client, const std::string& command, const std::vector<std::string>& params, const std::string& tags){
+	bool isNotice = (command == WEECHAT_NOTICE);
+	bool isTagmsg = (command == WEECHAT_TAGMSG);
+
+	if (params.size() < 1 || params[0].empty()){
+		if (!isNotice)
+			sendNumericReply(client, ERR_NORECIPIENT, ":No recipient given (" + command + ")");
+		return;
+	}
+	if (!isTagmsg && (params.size() < 2 || params[1].empty())){
+		if (!isNotice)
+			sendNumericReply(client, ERR_NOTEXTTOSEND, ":No text to send");
+		return;
+	}
+	std::vector<std::string> targets = splitList(params[0], ',');
+	if (targets.size() > MAX_MESSAGE_TARGETS){
+		if (!isNotice)
+			sendNumericReply(client, ERR_TOOMANYTARGETS, params[0] + " :Too many recipients. No message delivered");
+		return;
+	}
+
+	// Build the message once (no host, as requested), only the target differs per line
+	Client& clientObj = this->clientMap[client.fd];
+	std::string& head = this->scratch.take();
+	head.append(":").append(clientObj.getPrefix());
+	head.append(" ").append(command).append(" ");
+	std::string& tail = this->scratch.take();
+	if (isTagmsg)
+		tail.append(CLDR);
+	else
+		tail.append(" :").append(params[1]).append(CLDR);
+	std::string clientTags = TaggedLine::clientOnlyTags(tags);
+	bool echo = clientObj.hasCapability(CAP_ECHO_MESSAGE);
+
+	// The sender only gets its own message back with echo-message. With a
+	// single target nobody can get it twice, the sets are only filled for
+	// several: who got the message, and the targets already handled (a
+	// target listed twice is sent and echoed once)
+	bool severalTargets = targets.size() > 1;
+	std::set<int> delivered;
+	std::set<std::string> handled;
+	if (severalTargets)
+		delivered.insert(client.fd);
+
+	for (size_t i = 0; i < targets.size(); i++){
+		const std::string& target = targets[i];
+		unsigned long time;
+		unsigned long msgid = stampMessage(time);
+		std::string& text = this->scratch.take();
+		text.append(head).append(target).append(tail);
+		TaggedLine line(text, time, msgid);
+		line.setClientTags(clientTags);
+		line.setTagsOnly(isTagmsg);
+
+		if (WEECHAT_CHANNEL_PREFIX.find(target[0]) != std::string::npos){
+			std::map<std::string, Channel>::iterator it = this->channels.find(target);
+			if (it == this->channels.end()){
+				if (!isNotice)
+					sendNumericReply(client, ERR_NOSUCHCHANNEL, target + " :No such channel");
+				continue;
+			}
+			// Sender must be in the channel
+			if (!it->second.hasMember(client.fd)){
+				if (!isNotice)
+					sendNumericReply(client, ERR_CANNOTSENDTOCHAN, target + " :Cannot send to channel");
+				continue;
+			}
+			if (severalTargets && !handled.insert(it->first).second)
+				continue;
+			if (severalTargets)
+				it->second.broadcast(this->hotClients, line, delivered);
+			else
+				fanOut(it->second, line, client.fd);
+			if (echo && !line.render(clientObj.getCapabilities()).empty())
+				clientObj.queueOutput(line.render(clientObj.getCapabilities()));
+			// Client tags stay on this server, peers get the plain message
+			if (isTagmsg)
+				continue;
+			propagateToChannel(it->second, line.getLine(), -1);
+			recordHistory(it->second, line.getLine(), time, msgid);
+			logChannel(it->second, line.getLine());
+			continue;
+		}
+
+		int targetFd = findClientByNickname(target);
+		if (targetFd == -1){
+			if (!isNotice)
+				sendNumericReply(client, ERR_NOSUCHNICK, target + " :No such nick/channel");
+			continue;
+		}
+		Client& targetObj = this->clientMap[targetFd];
+		if (severalTargets && !handled.insert(targetObj.getNickname()).second)
+			continue;
+		if (command == WEECHAT_PRIVMSG && targetObj.isAway())
+			sendNumericReply(client, RPL_AWAY, targetObj.getNickname() + " :" + targetObj.getAwayMessage());
+		if (echo && !line.render(clientObj.getCapabilities()).empty())
+			clientObj.queueOutput(line.render(clientObj.getCapabilities()));
+		if (targetFd == client.fd || (severalTargets && !delivered.insert(targetFd).second))
+			continue;
+		if (!targetObj.isRemote()){
+			if (!line.render(targetObj.getCapabilities()).empty())
+				targetObj.queueOutput(line.render(targetObj.getCapabilities()));
+		} else if (!isTagmsg)
+			queueMessage(targetObj.getLink(), line.getLine());
+	}
+}
+
 /**
  * @brief Handle a complete IRC message using proper RFC 2812 parsing
  * 
@@ -1189,16 +1822,29 @@ void	Server::processCommand(pollfd& client, const std::string& command, const st
  */
 void	Server::handleMessage(pollfd& client, const std::string& rawMessage){
 	std::cout << rawMessage << std::endl;
-	Message msg(rawMessage);
+	Message& msg = this->parsed;
+	msg.parse(rawMessage);
 	
 	if (!msg.isValid()){
-		sendMessage(client, MSG_SOMETHING_WENT_WRONG);
+		queueMessage(client.fd, MSG_SOMETHING_WENT_WRONG);
 		return;
 	}
 
-	std::string command = msg.getCommand();
-	std::vector<std::string> params = msg.getParameters();
-	processCommand(client, command, params);
+	if (this->clientMap[client.fd].getLinkState() == Client::LINK_ESTABLISHED){
+		processServerMessage(client, msg);
+		return;
+	}
+	this->capture.recordLine(client.fd, rawMessage);
+	const std::string& command = msg.getCommand();
+	const std::vector<std::string>& params = msg.getParameters();
+	// The command may close the connection, the exit probe keeps the fd it entered with
+	int clientFd = client.fd;
+	HAI_PROBE2(command_begin, clientFd, command.c_str());
+	unsigned long started = this->metricsSocket >= 0 ? currentTimeUs() : 0;
+	processCommand(client, command, params, msg.getTags());
+	if (this->metricsSocket >= 0)
+		this->metrics.observeCommand(command, currentTimeUs() - started);
+	HAI_PROBE2(command_end, clientFd, command.c_str());
 }
 
 /**
@@ -1226,6 +1872,161 @@ void	Server::shutdown(void){
 	this->isRunning = false;
 }
 
+/**
+ * @brief Ask the event loop to reload the config file (SIGHUP).
+ * Only sets a flag, so it is safe to call from a signal handler.
+ */
+void	Server::requestReload(void){
+	this->reloadRequested = 1;
+}
+
+/**
+ * @brief Ask the event loop to hand over to a new exec of the binary
+ * (SIGUSR2). Only sets a flag, so it is safe to call from a signal handler.
+ */
+void	Server::requestUpgrade(void){
+	this->upgradeRequested = 1;
+}
+
+/**
+ * @brief Find the binary argv[0] names the way execvp() does: the path
+ * itself if it has a '/', the first executable match in $PATH otherwise.
+ * @param name argv[0].
+ * @return Its absolute path, or /proc/self/exe (the running binary) if it
+ * can't be found.
+ */
+static std::string	findProgram(const std::string& name){
+	std::vector<std::string> candidates;
+
+	if (name.find('/') != std::string::npos)
+		candidates.push_back(name);
+	else if (std::getenv("PATH")){
+		std::vector<std::string> directories = splitList(std::getenv("PATH"), ':', true);
+		for (size_t i = 0; i < directories.size(); i++)
+			candidates.push_back((directories[i].empty() ? "." : directories[i]) + "/" + name);
+	}
+	for (size_t i = 0; i < candidates.size(); i++){
+		if (access(candidates[i].c_str(), X_OK) != 0)
+			continue;
+		char *resolved = realpath(candidates[i].c_str(), NULL);
+		if (resolved){
+			std::string path(resolved);
+			std::free(resolved);
+			return (path);
+		}
+	}
+	return ("/proc/self/exe");
+}
+
+/**
+ * @brief Remember the command line, the upgrade runs it again. argv[0] is
+ * resolved now: started through $PATH or from another directory, it is no
+ * path execve() can use later.
+ * @param av main's argv, NULL terminated.
+ */
+void	Server::setProgramArguments(char **av){
+	this->programArguments.clear();
+	for (size_t i = 0; av[i]; i++)
+		this->programArguments.push_back(av[i]);
+	if (!this->programArguments.empty())
+		this->programPath = findProgram(this->programArguments[0]);
+}
+
+/**
+ * @brief Make room for more clients by growing the pollfd array. Slot
+ * indexes are kept, so the run queue stays valid.
+ * @param capacity The new capacity, server socket included.
+ */
+void	Server::growCapacity(size_t capacity){
+	pollfd *grown = new pollfd[capacity + SERVICE_SLOTS];
+	for (size_t i = 0; i < capacity; i++){
+		grown[i].fd = -1;
+		grown[i].events = 0;
+		grown[i].revents = 0;
+		if (i < this->serverCapacity)
+			grown[i] = this->clients[i];
+	}
+	for (size_t i = 0; i < SERVICE_SLOTS; i++)
+		grown[capacity + i] = this->clients[this->serverCapacity + i];
+	delete[] (this->clients);
+	this->clients = grown;
+	this->serverCapacity = capacity;
+	this->scheduledClients.resize(capacity, false);
+}
+
+/**
+ * @brief Re-read the config file and apply what can change without
+ * dropping connections: capacity, buffer size, poll timeout, connection
+ * classes and new predefined channels. The listen address needs a restart.
+ * An invalid file is reported and the running settings are kept.
+ * @author Hamad
+ */
+void	Server::reloadConfig(void){
+	this->reloadRequested = 0;
+	if (this->configPath.empty()){
+		std::cerr << "No config file to reload" << std::endl;
+		return;
+	}
+	Config config;
+	try {
+		config.load(this->configPath);
+	} catch (std::exception& err){
+		std::cerr << "\033[1;31m" << err.what() << " (config not reloaded)\033[0m" << std::endl;
+		return;
+	}
+	if (config.getListenAddress() != this->listenAddress)
+		std::cerr << "Changing the listen address needs a restart" << std::endl;
+	if (config.getStateDir() != this->stateDir)
+		std::cerr << "Changing the state directory needs a restart" << std::endl;
+	if (config.getLogDir() != this->logDir)
+		std::cerr << "Changing the log directory needs a restart" << std::endl;
+	if ((config.getMetricsPort() > 0) != (this->metricsSocket >= 0))
+		std::cerr << "Changing the metrics port needs a restart" << std::endl;
+	if (config.getAdminSocket() != this->adminPath)
+		std::cerr << "Changing the admin socket needs a restart" << std::endl;
+	this->loggedChannels = config.getLoggedChannels();
+	// Operators already up keep their status
+	this->operators = config.getOperators();
+	this->sessionGrace = config.getSessionGrace() * 1000;
+	this->memoryBudget = config.getMemoryBudget();
+	this->fanoutRing = config.getFanoutRing();
+	if (config.getServerName() != this->serverName)
+		std::cerr << "Changing the server name needs a restart" << std::endl;
+	// Established links stay up, the new blocks apply to the next handshakes
+	this->linkBlocks = config.getLinks();
+
+	// Fewer clients only stops accepting new ones, nobody is dropped
+	this->maxClients = config.getMaxClients();
+	if (this->maxClients + 1 > this->serverCapacity)
+		growCapacity(this->maxClients + 1);
+	this->pollTimeout = config.getPollTimeout();
+	this->recvBuffer.assign(config.getBufferSize(), 0);
+
+	for (size_t i = 0; i < config.getChannels().size(); i++){
+		const std::string& name = config.getChannels()[i];
+		if (this->channels.find(name) == this->channels.end()){
+			this->channels.insert(std::make_pair(name, Channel(name)));
+			this->channelStore.markDirty(name);
+		}
+	}
+
+	// Clients keep their class by name, or fall in the first one matching their address
+	std::vector<ConnectionClass> previous = this->connectionClasses;
+	this->connectionClasses = config.getClasses();
+	for (std::map<int, Client>::iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		const std::string& name = previous[it->second.getConnectionClass()].getName();
+		int classIndex = -1;
+		for (size_t i = 0; i < this->connectionClasses.size() && classIndex < 0; i++){
+			if (this->connectionClasses[i].getName() == name)
+				classIndex = static_cast<int>(i);
+		}
+		if (classIndex < 0)
+			classIndex = findConnectionClass(it->second.getAddress(), "");
+		it->second.setConnectionClass(classIndex < 0 ? 0 : classIndex);
+	}
+	std::cout << "\033[1;32mConfig reloaded from " << this->configPath << "\033[0m" << std::endl;
+}
+
 /**
  * @brief This function is responsible to accept/reject clients. It will also handel
  * client messages or commands via performHandshake().
@@ -1235,77 +2036,167 @@ void	Server::shutdown(void){
  */
 void	Server::start(void){
 	while (this->isRunning){
-		this->pollManager = poll(this->clients, this->serverCapacity, MS_TIMEOUT);
-		
-		// Handle poll errors (EINTR from signals is ok, continue)
-		if (this->pollManager < 0){
-			if (errno == EINTR)
-				continue;  // Signal interrupted, check isRunning and continue
-			break;  // Real error, exit loop
-		}
-		if (this->pollManager == 0){
-			continue;  // Timeout, no events
+		if (this->reloadRequested)
+			reloadConfig();
+		if (this->upgradeRequested && upgrade())
+			break;
+		if (!this->linkBlocks.empty() && currentTimeMs() - this->lastLinkAttempt >= LINK_RETRY_MS)
+			connectLinks();
+		// Don't sleep while commands are queued, wake up early for throttled clients
+		int timeout = this->pollTimeout;
+		if (!this->readyClients.empty() || this->fanoutWake || hasFanoutLines())
+			timeout = 0;
+		else if (!this->throttledClients.empty())
+			timeout = FLOOD_POLL_TIMEOUT;
+		else if (this->logIndex.hasOutstanding())
+			timeout = SEARCH_POLL_TIMEOUT;
+		if (!runIteration(timeout))
+			break;
+	}
+}
+
+/**
+ * @brief One turn of the event loop: poll, accept, read, run the scheduled
+ * commands and flush. start() calls it forever, an embedder (see
+ * ServerLocal.cpp) may call it itself.
+ * @param timeout The poll() timeout in milliseconds.
+ * @return false if poll() failed for another reason than a signal.
+ * @author Hamad
+ */
+bool	Server::runIteration(int timeout){
+	this->pollManager = poll(this->clients, this->serverCapacity + SERVICE_SLOTS, timeout);
+
+	// Handle poll errors (EINTR from signals is ok, continue)
+	if (this->pollManager < 0)
+		return (errno == EINTR);
+	unsigned long now = currentTimeMs();
+	unsigned long iterationStart = currentTimeUs();
+	for (size_t i = 0; i < this->throttledClients.size(); i++)
+		scheduleInput(this->throttledClients[i]);
+	this->throttledClients.clear();
+	if (this->clients[0].revents & POLLIN){
+		sockaddr_in	peerAddress;
+		socklen_t	peerLength = sizeof(peerAddress);
+		int clientSocket = accept(this->clients[0].fd, (sockaddr *)&peerAddress, &peerLength);
+		if (clientSocket >= 0){
+			HAI_PROBE2(accept, clientSocket, ntohl(peerAddress.sin_addr.s_addr));
+			acceptConnection(clientSocket, ntohl(peerAddress.sin_addr.s_addr), now);
 		}
-		if (this->clients[0].revents & POLLIN){
-			int clientSocket = accept(this->clients[0].fd, NULL, NULL);
-			if (clientSocket < 0)
-				continue ;
+	}
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		pollfd& client = this->clients[i];
+		if (client.fd < 0)
+			continue;
+		if (client.revents & POLLIN){
+			std::string buffer = recieveData(client, this->recvBuffer);
+			HAI_PROBE2(recv, client.fd, buffer.size());
+			this->metrics.add(Metrics::BYTES_IN, buffer.size());
 			
-			// Set the new client socket to non-blocking
-			if (fcntl(clientSocket, F_SETFL, O_NONBLOCK) < 0) {
-				close(clientSocket);
+			// Empty buffer means client disconnected or error
+			if (buffer.empty()){
+				if (!detachClient(client))
+					cleanClient(client);
 				continue;
 			}
 			
-			// Check if server is full (serverCapacity includes server socket at index 0)
-			if (this->clientMap.size() >= serverCapacity - 1){
-				rejectClient(clientSocket);
-				continue ;
-			}
-			for (unsigned int i = 1; i < this->serverCapacity; i++){
-				pollfd&	client = this->clients[i];
-				if (client.fd == -1){
-					client.fd = clientSocket;
-					client.events = POLLIN;
-					this->clientMap[client.fd] = Client();
-					this->clientBuffer[client.fd] = std::string("");
-					break ;
-				}
+			// Check if client still exists (might have been removed)
+			if (this->clientBuffer.find(client.fd) == this->clientBuffer.end())
+				continue;
+			
+			std::string& clientBuffer = this->clientBuffer[client.fd];
+			clientBuffer += buffer;
+			Client& clientObj = this->clientMap[client.fd];
+			clientObj.markActive(now);
+			size_t recvQ = clientObj.isServer() ? LINK_SENDQ : this->connectionClasses[clientObj.getConnectionClass()].getRecvQ();
+			if (clientBuffer.size() > recvQ){
+				disconnectClient(client, MSG_EXCESS_FLOOD);
+				continue;
 			}
+			scheduleInput(i);
 		}
-		for (unsigned int i = 1; i < this->serverCapacity; i++){
-			pollfd& client = this->clients[i];
-			if ((client.fd >= 0) && (client.revents & POLLIN)){
-				std::string buffer = recieveData(client);
-				
-				// Empty buffer means client disconnected or error
-				if (buffer.empty()){
-					cleanClient(client);
-					continue;
-				}
-				
-				// Check if client still exists (might have been removed)
-				if (this->clientBuffer.find(client.fd) == this->clientBuffer.end())
-					continue;
-				
-				std::string& clientBuffer = this->clientBuffer[client.fd];
-				clientBuffer += buffer;
-				size_t endPosition = clientBuffer.find(CLDR);
-				while (endPosition != std::string::npos){
-					std::string message = clientBuffer.substr(0, endPosition);
-					// Use RFC-compliant message handler
-					handleMessage(client, message);
-					
-					// Check if client still valid after handling message
-					if (client.fd < 0)
-						break;
-					
-					clientBuffer.erase(0, endPosition + 2);
-					endPosition = clientBuffer.find(CLDR);
-				}
-			}
+		else if ((client.revents & (POLLHUP | POLLERR | POLLNVAL)) && !detachClient(client))
+			cleanClient(client);
+	}
+	serveMetrics(now);
+	serveAdmin(now);
+	sweepKeepalive(now);
+	expireSessions(now);
+	checkMemory(now);
+	runScheduler();
+	resumeReplyCursors();
+	drainFanout();
+	deliverSearches();
+	// Single flush per client per iteration, whatever the commands queued.
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		pollfd& client = this->clients[i];
+		if (client.fd < 0)
+			continue;
+		if (!flushClient(client)){
+			if (!detachClient(client))
+				cleanClient(client);
+			continue;
 		}
+		const Client& clientObj = this->clientMap[client.fd];
+		size_t sendQ = clientObj.isServer() ? LINK_SENDQ : this->connectionClasses[clientObj.getConnectionClass()].getSendQ();
+		if (clientObj.getOutputSize() > sendQ)
+			disconnectClient(client, MSG_SENDQ_EXCEEDED);
+		else if (clientObj.getOutputSize() < SENDQ_LOW_WATERMARK)
+			scheduleInput(i);  // Commands held back by its output (see scheduleInput)
 	}
+	// Group commit of this iteration's TOPIC/MODE changes, handed to the store's writer
+	this->channelStore.commit(this->channels);
+	this->capture.commit(now);
+	// Nothing built in this iteration is referenced any more
+	this->scratch.reset();
+	this->metrics.observeIteration(currentTimeUs() - iterationStart);
+	return (true);
+}
+
+/**
+ * @brief Take a new connection in a free slot, or close it if the server
+ * or its class is full.
+ * @param clientSocket The connection, from accept() or a socketpair.
+ * @param address The peer's IPv4 address (host byte order), picks the class.
+ * @param now currentTimeMs() of this iteration.
+ * @return false if the connection was closed.
+ */
+bool	Server::acceptConnection(int clientSocket, in_addr_t address, unsigned long now){
+	int classIndex = findConnectionClass(address, "");
+	in_addr peer;
+	peer.s_addr = htonl(address);
+
+	// Set the new client socket to non-blocking
+	if (fcntl(clientSocket, F_SETFL, O_NONBLOCK) < 0 || fcntl(clientSocket, F_SETFD, FD_CLOEXEC) < 0){
+		close(clientSocket);
+		return (false);
+	}
+	// Check if server is full (serverCapacity includes server socket at index 0)
+	// Detached sessions hold no slot, their owner must be able to come back
+	// Over the memory budget nobody new comes in (see checkMemory)
+	if (this->clientMap.size() - this->remoteUserCount - this->detachedSessions.size() >= this->maxClients ||
+		this->clientMap.size() - this->remoteUserCount - this->detachedSessions.size() >= serverCapacity - 1 || classIndex < 0 ||
+		this->sheddingLoad){
+		rejectClient(clientSocket);
+		return (false);
+	}
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		pollfd&	client = this->clients[i];
+		if (client.fd == -1){
+			client.fd = clientSocket;
+			client.events = POLLIN;
+			this->clientMap[client.fd] = Client();
+			this->clientMap[client.fd].setAddress(address);
+			this->clientMap[client.fd].setHostname(inet_ntoa(peer));
+			this->clientMap[client.fd].markActive(now);
+			this->clientBuffer[client.fd] = std::string("");
+			this->capture.openSession(client.fd, address);
+			if (!assignConnectionClass(client.fd, classIndex))
+				disconnectClient(client, MSG_CLASS_FULL);
+			return (true);
+		}
+	}
+	rejectClient(clientSocket);
+	return (false);
 }
 
 /*
@@ -1357,3 +2248,15 @@ const char* Server::FailedToMakeTheSocketNonBlockingException::what() const thro
 const char* Server::FailedToSetSocketOptionsException::what() const throw() {
     return SOCKET_OPTIONS_FAIL.c_str();
 }
+
+const char* Server::FailedToUpgradeException::what() const throw() {
+    return UPGRADE_FAIL.c_str();
+}
+
+const char* Server::FailedToOpenMetricsException::what() const throw() {
+    return METRICS_FAIL.c_str();
+}
+
+const char* Server::FailedToOpenAdminException::what() const throw() {
+    return ADMIN_FAIL.c_str();
+}
@@ -0,0 +1,532 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerAdmin.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/27 11:20:14 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/27 11:20:14 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Admin console (admin_socket <path> in the config). A Unix socket only
+	the user running the server can open, one command per line, e.g.
+
+		$ socat - UNIX-CONNECT:./ircserv.sock
+		CHANNEL #general
+
+	Every answer ends with a line "OK" or "ERR <why>". Consoles are served
+	by the event loop like the clients: each iteration a console gets a few
+	turns (see ADMIN_TURNS) and tables are sent a page of rows per turn, so
+	listing 10k clients never stalls the server. Limits changed here last
+	until the config is reloaded or the server upgraded.
+*/
+
+static const char *ADMIN_HELP =
+	"HELP                            this list\n"
+	"STATS                           server totals\n"
+	"CLIENTS                         connections and detached sessions\n"
+	"CLIENT <nick>                   one user\n"
+	"CHANNELS                        channels, their size and traffic\n"
+	"CHANNEL <name>                  a channel and its members\n"
+	"CLASSES                         connection classes\n"
+	"CLASS <name> <key>=<value>...   change a class: recvq sendq burst rate max_clients exempt\n"
+	"SET max_clients|poll_timeout <n>\n"
+	"KILL <nick> [reason]            disconnect a user\n"
+	"CAPTURE [<file>|OFF]            record the new connections' traffic, see tools/replay.cpp\n"
+	"MEMSTATS                        memory held, by subsystem\n"
+	"QUIT\n";
+
+static const char *CLIENT_HEADER = "ID         NICK             ADDRESS          CLASS      STATE     RECVQ    SENDQ    IN/S   OUT/S  IDLE\n";
+static const char *CHANNEL_HEADER = "NAME                     MEMBERS  OPS      OUT/S    OUT\n";
+
+static bool	parseCount(const std::string& text, unsigned long& value){
+	char *end = NULL;
+
+	if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+		return (false);
+	errno = 0;
+	value = std::strtoul(text.c_str(), &end, 10);
+	return (errno == 0 && value <= std::numeric_limits<unsigned int>::max());
+}
+
+static std::string	formatAddress(in_addr_t address){
+	in_addr peer;
+
+	peer.s_addr = htonl(address);
+	return (inet_ntoa(peer));
+}
+
+/**
+ * @brief Open the admin socket in the first admin slot. A socket file left
+ * by a server that didn't exit cleanly is replaced, one a server still
+ * answers on is not.
+ * @param path Where to create the socket.
+ * @throw FailedToOpenAdminException if the socket can't be created.
+ * @author Hamad
+ */
+void	Server::openAdmin(const std::string& path){
+	sockaddr_un adminAddress;
+	struct stat existing;
+
+	std::memset(&adminAddress, 0, sizeof(adminAddress));
+	adminAddress.sun_family = AF_UNIX;
+	std::strncpy(adminAddress.sun_path, path.c_str(), sizeof(adminAddress.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw (Server::FailedToOpenAdminException());
+	if (lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)){
+		if (connect(fd, (sockaddr *)&adminAddress, sizeof(adminAddress)) == 0 || errno != ECONNREFUSED){
+			close(fd);
+			throw (Server::FailedToOpenAdminException());
+		}
+		unlink(path.c_str());
+	}
+	// Only the owner may connect, the console can kill anybody
+	mode_t previousMask = umask(077);
+	int bound = bind(fd, (sockaddr *)&adminAddress, sizeof(adminAddress));
+	umask(previousMask);
+	if (bound < 0 || listen(fd, ADMIN_CONNECTIONS) < 0 ||
+		fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0){
+		close(fd);
+		throw (Server::FailedToOpenAdminException());
+	}
+	this->adminSocket = fd;
+	this->adminPath = path;
+	this->clients[this->serverCapacity + METRICS_SLOTS].fd = fd;
+	this->clients[this->serverCapacity + METRICS_SLOTS].events = POLLIN;
+	std::cout << "Admin console on " << path << std::endl;
+}
+
+/**
+ * @brief Accept consoles, read their commands, give each its turns and
+ * write what they produced.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::serveAdmin(unsigned long now){
+	if (this->adminSocket < 0)
+		return;
+	pollfd* slots = this->clients + this->serverCapacity + METRICS_SLOTS;
+
+	if (slots[0].revents & POLLIN){
+		int fd = accept(this->adminSocket, NULL, NULL);
+		unsigned int free = 1;
+		while (free < ADMIN_SLOTS && slots[free].fd >= 0)
+			free++;
+		if (fd >= 0 && (free == ADMIN_SLOTS || fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0))
+			close(fd);
+		else if (fd >= 0){
+			slots[free].fd = fd;
+			slots[free].events = POLLIN;
+			slots[free].revents = 0;
+			this->consoles[fd] = AdminConsole();
+		}
+	}
+	for (unsigned int i = 1; i < ADMIN_SLOTS; i++){
+		if (slots[i].fd < 0)
+			continue;
+		AdminConsole& console = this->consoles[slots[i].fd];
+		if (!console.closing && (slots[i].revents & (POLLIN | POLLHUP | POLLERR))){
+			char buffer[ADMIN_LINE_BYTES];
+			ssize_t got = recv(slots[i].fd, buffer, sizeof(buffer), 0);
+			if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+				closeConsole(slots[i]);
+				continue;
+			}
+			// The end of input still gets its answers (echo STATS | socat ...)
+			if (got == 0)
+				console.closing = true;
+			else if (got > 0)
+				console.input.append(buffer, got);
+			if (console.skipping){
+				size_t end = console.input.find('\n');
+				console.input.erase(0, end == std::string::npos ? end : end + 1);
+				console.skipping = end == std::string::npos;
+			}
+			if (console.input.find('\n') == std::string::npos && console.input.length() > ADMIN_LINE_BYTES){
+				console.output += "ERR line too long\n";
+				console.input.clear();
+				console.skipping = true;
+			}
+		}
+		runAdmin(console, now);
+		// SET max_clients may have moved the pollfd array
+		slots = this->clients + this->serverCapacity + METRICS_SLOTS;
+		pollfd& slot = slots[i];
+		bool broken = false;
+		while (!console.output.empty() && !broken){
+			ssize_t sent = send(slot.fd, console.output.data(), console.output.length(), DEFAULT_FLAG_SEND);
+			if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				break;
+			if (sent <= 0)
+				broken = true;
+			else
+				console.output.erase(0, sent);
+		}
+		if (broken){
+			closeConsole(slot);
+			continue;
+		}
+		bool busy = console.listing != AdminConsole::LIST_NONE || console.input.find('\n') != std::string::npos;
+		if (console.closing && !busy && console.output.empty()){
+			closeConsole(slot);
+			continue;
+		}
+		// A console with work left keeps the loop from sleeping, like a reply cursor
+		slot.events = (console.closing || busy) ? 0 : POLLIN;
+		if (busy || !console.output.empty())
+			slot.events |= POLLOUT;
+	}
+}
+
+/**
+ * @brief Give a console its turns: one command or one page of the table it
+ * is listing each, none while its output is piling up.
+ * @param console The console.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::runAdmin(AdminConsole& console, unsigned long now){
+	for (unsigned int turn = 0; turn < ADMIN_TURNS && console.output.length() < ADMIN_OUTPUT_HIGH; turn++){
+		if (console.listing != AdminConsole::LIST_NONE){
+			listRows(console, now);
+			continue;
+		}
+		size_t end = console.input.find('\n');
+		if (end == std::string::npos)
+			break;
+		std::string line = console.input.substr(0, end);
+		console.input.erase(0, end + 1);
+		if (!line.empty() && line[line.length() - 1] == '\r')
+			line.erase(line.length() - 1);
+		adminCommand(console, line, now);
+	}
+}
+
+/**
+ * @brief Run one console command.
+ * @param console The console, receives the answer.
+ * @param line The command line, without its line ending.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::adminCommand(AdminConsole& console, const std::string& line, unsigned long now){
+	std::vector<std::string> words;
+	std::istringstream iss(line);
+	std::string word;
+
+	while (iss >> word)
+		words.push_back(word);
+	if (words.empty())
+		return;
+	std::string command = words[0];
+	std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+	std::ostringstream out;
+
+	if (command == "HELP")
+		out << ADMIN_HELP << "OK\n";
+	else if (command == "QUIT"){
+		console.input.clear();
+		console.closing = true;
+		out << "OK\n";
+	} else if (command == "STATS"){
+		size_t connections = 0;
+		size_t registered = 0;
+		size_t links = 0;
+		for (unsigned int i = 1; i < this->serverCapacity; i++){
+			std::map<int, Client>::const_iterator it = this->clientMap.find(this->clients[i].fd);
+			if (this->clients[i].fd < 0 || it == this->clientMap.end())
+				continue;
+			if (it->second.isServer()){
+				links++;
+				continue;
+			}
+			connections++;
+			if (it->second.isFullyRegistered())
+				registered++;
+		}
+		out << "connections " << connections << "\n"
+			<< "registered " << registered << "\n"
+			<< "detached " << this->detachedSessions.size() << "\n"
+			<< "remote_users " << this->remoteUserCount << "\n"
+			<< "links " << links << "\n"
+			<< "channels " << this->channels.size() << "\n"
+			<< "max_clients " << this->maxClients << "\n"
+			<< "poll_timeout " << this->pollTimeout << "\n"
+			<< "lines_in " << this->metrics.get(Metrics::MESSAGES_IN) << "\n"
+			<< "lines_out " << this->metrics.get(Metrics::MESSAGES_OUT) << "\n"
+			<< "bytes_in " << this->metrics.get(Metrics::BYTES_IN) << "\n"
+			<< "bytes_out " << this->metrics.get(Metrics::BYTES_OUT) << "\n"
+			<< "OK\n";
+	} else if (command == "CLIENTS"){
+		out << CLIENT_HEADER;
+		console.listing = AdminConsole::LIST_CLIENTS;
+		console.nextId = 0;
+	} else if (command == "CHANNELS"){
+		out << CHANNEL_HEADER;
+		console.listing = AdminConsole::LIST_CHANNELS;
+		console.channel.clear();
+	} else if (command == "CHANNEL" && words.size() == 2){
+		std::map<std::string, Channel>::const_iterator it = this->channels.find(words[1]);
+		if (it == this->channels.end())
+			out << "ERR no such channel\n";
+		else {
+			const Channel& chan = it->second;
+			out << "name " << chan.getName() << "\n"
+				<< "members " << chan.getMemberCount() << "\n"
+				<< "operators " << chan.getOperatorCount() << "\n"
+				<< "out_rate " << chan.getDeliveries().formatRate(now) << "\n"
+				<< "out_total " << chan.getDeliveries().getTotal() << "\n"
+				<< "fanout " << (chan.getRing().isActive() ? "ring" : "push") << "\n"
+				<< "ring_lines " << chan.getRing().getLength() << "\n"
+				<< "ring_lagging " << chan.getRing().getLagging() << "\n"
+				<< "topic " << chan.getTopic() << "\n"
+				<< CLIENT_HEADER;
+			console.listing = AdminConsole::LIST_MEMBERS;
+			console.channel = chan.getName();
+			console.nextId = 0;
+		}
+	} else if (command == "CLIENT" && words.size() == 2){
+		int userId = findClientByNickname(words[1]);
+		if (userId < 0)
+			out << "ERR no such nick\n";
+		else {
+			const Client& user = this->clientMap[userId];
+			out << CLIENT_HEADER << adminClientRow(userId, user, now)
+				<< "user " << user.getUsername() << "\n"
+				<< "realname " << user.getRealname() << "\n"
+				<< "capabilities " << capabilityList(user.getCapabilities()) << "\n"
+				<< "away " << user.getAwayMessage() << "\n"
+				<< "lines_in " << user.getLinesIn().getTotal() << "\n"
+				<< "lines_out " << user.getLinesOut().getTotal() << "\n"
+				<< "channels";
+			for (std::map<std::string, Channel>::const_iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+				if (it->second.hasMember(userId))
+					out << " " << (it->second.isOperator(userId) ? "@" : "") << it->first;
+			}
+			out << "\nOK\n";
+		}
+	} else if (command == "CLASSES"){
+		std::vector<size_t> members(this->connectionClasses.size(), 0);
+		for (std::map<int, Client>::const_iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+			if (!it->second.isRemote() && it->second.getConnectionClass() < members.size())
+				members[it->second.getConnectionClass()]++;
+		}
+		out << "NAME       CLIENTS  RECVQ    SENDQ    BURST  RATE   MAX    EXEMPT\n";
+		for (size_t i = 0; i < this->connectionClasses.size(); i++){
+			const ConnectionClass& connectionClass = this->connectionClasses[i];
+			out << std::left << std::setw(10) << connectionClass.getName() << " "
+				<< std::setw(8) << members[i] << " "
+				<< std::setw(8) << connectionClass.getRecvQ() << " "
+				<< std::setw(8) << connectionClass.getSendQ() << " "
+				<< std::setw(6) << connectionClass.getFloodBurst() << " "
+				<< std::setw(6) << connectionClass.getFloodRate() << " "
+				<< std::setw(6) << connectionClass.getMaxClients() << " "
+				<< (connectionClass.isExempt() ? "yes" : "no") << "\n";
+		}
+		out << "OK\n";
+	} else if (command == "CLASS" && words.size() >= 3)
+		out << adminClass(words);
+	else if (command == "SET" && words.size() == 3)
+		out << adminSet(words[1], words[2]);
+	else if (command == "KILL" && words.size() >= 2){
+		int userId = findClientByNickname(words[1]);
+		size_t reasonStart = line.find(words[1], line.find(words[0]) + words[0].length()) + words[1].length();
+		std::string reason = line.substr(reasonStart);
+		reason.erase(0, reason.find_first_not_of(' '));
+		if (userId < 0)
+			out << "ERR no such nick\n";
+		else {
+			killUser(userId, reason.empty() ? "Killed by the administrator" : reason, -1);
+			out << "OK\n";
+		}
+	} else if (command == "MEMSTATS")
+		out << memoryReport() << "OK\n";
+	else if (command == "CAPTURE" && words.size() <= 2){
+		std::string target = words.size() == 2 ? words[1] : "";
+		std::transform(target.begin(), target.end(), target.begin(), ::toupper);
+		if (target == "OFF")
+			this->capture.stop();
+		else if (!target.empty()){
+			try {
+				this->capture.start(words[1]);
+			} catch (std::exception& err){
+				out << "ERR " << err.what() << "\n";
+			}
+		}
+		if (out.str().empty()){
+			out << "capture " << (this->capture.isEnabled() ? this->capture.getPath() : "off") << "\n"
+				<< "sessions " << this->capture.getSessionCount() << "\n"
+				<< "records " << this->capture.getRecords() << "\n"
+				<< "bytes_written " << this->capture.getBytesWritten() << "\n"
+				<< "OK\n";
+		}
+	} else
+		out << "ERR unknown command or wrong arguments, see HELP\n";
+	console.output += out.str();
+}
+
+/**
+ * @brief Send the next page of the table a console is listing.
+ * @param console The console.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::listRows(AdminConsole& console, unsigned long now){
+	std::ostringstream out;
+	unsigned int rows = 0;
+	bool done = false;
+
+	if (console.listing == AdminConsole::LIST_CLIENTS){
+		std::map<int, Client>::const_iterator it = this->clientMap.lower_bound(console.nextId);
+		// Remote users are skipped but count, a page walks ADMIN_ROWS_PER_TURN entries at most
+		for (; it != this->clientMap.end() && rows < ADMIN_ROWS_PER_TURN; ++it, rows++){
+			if (!it->second.isRemote())
+				out << adminClientRow(it->first, it->second, now);
+		}
+		done = it == this->clientMap.end();
+		if (!done)
+			console.nextId = it->first;
+	} else if (console.listing == AdminConsole::LIST_CHANNELS){
+		std::map<std::string, Channel>::const_iterator it = this->channels.lower_bound(console.channel);
+		for (; it != this->channels.end() && rows < ADMIN_ROWS_PER_TURN; ++it, rows++){
+			const Channel& chan = it->second;
+			out << std::left << std::setw(24) << chan.getName() << " "
+				<< std::setw(8) << chan.getMemberCount() << " "
+				<< std::setw(8) << chan.getOperatorCount() << " "
+				<< std::setw(8) << chan.getDeliveries().formatRate(now) << " "
+				<< chan.getDeliveries().getTotal() << "\n";
+		}
+		done = it == this->channels.end();
+		if (!done)
+			console.channel = it->first;
+	} else {
+		std::map<std::string, Channel>::const_iterator chanIt = this->channels.find(console.channel);
+		if (chanIt == this->channels.end()){
+			console.output += "ERR the channel is gone\n";
+			console.listing = AdminConsole::LIST_NONE;
+			return;
+		}
+		const std::set<int>& members = chanIt->second.getMembers();
+		std::set<int>::const_iterator it = members.lower_bound(console.nextId);
+		for (; it != members.end() && rows < ADMIN_ROWS_PER_TURN; ++it, rows++)
+			out << adminClientRow(*it, this->clientMap[*it], now);
+		done = it == members.end();
+		if (!done)
+			console.nextId = *it;
+	}
+	if (done){
+		out << "OK\n";
+		console.listing = AdminConsole::LIST_NONE;
+	}
+	console.output += out.str();
+}
+
+/**
+ * @brief One row of the CLIENTS table. Remote users show their server as
+ * address, detached sessions their missed lines as sendq.
+ */
+std::string	Server::adminClientRow(int userId, const Client& user, unsigned long now) const{
+	std::ostringstream row;
+	std::string state = "unreg";
+	std::string address = formatAddress(user.getAddress());
+	std::string className = "-";
+	size_t recvQ = 0;
+
+	if (this->detachedSessions.find(userId) != this->detachedSessions.end())
+		state = "detached";
+	else if (user.isRemote()){
+		state = "remote";
+		address = user.getServerName();
+	} else if (user.isServer())
+		state = "link";
+	else if (user.isServerOperator())
+		state = "oper";
+	else if (user.isFullyRegistered())
+		state = "user";
+	if (!user.isRemote() && user.getConnectionClass() < this->connectionClasses.size())
+		className = this->connectionClasses[user.getConnectionClass()].getName();
+	std::map<int, std::string>::const_iterator buffer = this->clientBuffer.find(userId);
+	if (buffer != this->clientBuffer.end())
+		recvQ = buffer->second.length();
+	std::string nick = user.isServer() ? user.getServerName() : user.getNickname();
+
+	row << std::left << std::setw(10) << userId << " "
+		<< std::setw(16) << (nick.empty() ? "*" : nick) << " "
+		<< std::setw(16) << address << " "
+		<< std::setw(10) << className << " "
+		<< std::setw(9) << state << " "
+		<< std::setw(8) << recvQ << " "
+		<< std::setw(8) << user.getOutputSize() << " "
+		<< std::setw(6) << user.getLinesIn().formatRate(now) << " "
+		<< std::setw(6) << user.getLinesOut().formatRate(now) << " "
+		<< (user.isRemote() ? 0 : (now - user.getLastActivity()) / 1000) << "\n";
+	return (row.str());
+}
+
+/**
+ * @brief CLASS <name> <key>=<value>... with the keys of a class line in the
+ * config file. Nothing changes unless every option is valid.
+ * @return The answer.
+ */
+std::string	Server::adminClass(const std::vector<std::string>& words){
+	size_t index = 0;
+	while (index < this->connectionClasses.size() && this->connectionClasses[index].getName() != words[1])
+		index++;
+	if (index == this->connectionClasses.size())
+		return ("ERR no such class\n");
+
+	ConnectionClass changed = this->connectionClasses[index];
+	for (size_t i = 2; i < words.size(); i++){
+		size_t equal = words[i].find('=');
+		std::string key = words[i].substr(0, equal);
+		std::string value = equal == std::string::npos ? "" : words[i].substr(equal + 1);
+		unsigned long number = 0;
+
+		if (key == "exempt" && (value == "yes" || value == "no"))
+			changed.setExempt(value == "yes");
+		else if (!parseCount(value, number))
+			return ("ERR invalid option " + words[i] + "\n");
+		else if (key == "recvq")
+			changed.setRecvQ(number);
+		else if (key == "sendq")
+			changed.setSendQ(number);
+		else if (key == "burst")
+			changed.setFloodBurst(number);
+		else if (key == "rate")
+			changed.setFloodRate(number);
+		else if (key == "max_clients")
+			changed.setMaxClients(number);
+		else
+			return ("ERR invalid option " + words[i] + "\n");
+	}
+	this->connectionClasses[index] = changed;
+	return ("OK\n");
+}
+
+/**
+ * @brief SET max_clients|poll_timeout <n>. More clients than the pollfd
+ * array holds grow it, fewer only stop new connections.
+ * @return The answer.
+ */
+std::string	Server::adminSet(const std::string& setting, const std::string& value){
+	unsigned long number = 0;
+
+	if (!parseCount(value, number))
+		return ("ERR invalid value " + value + "\n");
+	if (setting == "max_clients" && number > 0){
+		this->maxClients = number;
+		if (this->maxClients + 1 > this->serverCapacity)
+			growCapacity(this->maxClients + 1);
+	} else if (setting == "poll_timeout" && number <= static_cast<unsigned long>(std::numeric_limits<int>::max()))
+		this->pollTimeout = static_cast<int>(number);
+	else
+		return ("ERR invalid setting\n");
+	return ("OK\n");
+}
+
+void	Server::closeConsole(pollfd& console){
+	this->consoles.erase(console.fd);
+	closeClientConnection(console);
+}
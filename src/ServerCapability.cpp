@@ -0,0 +1,159 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerCapability.cpp                               :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/21 14:22:09 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/21 14:22:09 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	IRCv3 capabilities (https://ircv3.net/specs/extensions/capability-negotiation).
+	A client that sends CAP LS or CAP REQ before registering is held until
+	CAP END, the enabled capabilities are a bitset on its Client.
+*/
+
+static int	capabilityBit(const std::string& name, unsigned int available){
+	for (unsigned int i = 0; i < NUM_CAPABILITIES; i++){
+		if (CAPABILITY_NAMES[i] == name && (available & (1u << i)))
+			return (1 << i);
+	}
+	return (0);
+}
+
+/**
+ * @brief CAP LS|LIST|REQ|END. A REQ is applied whole or not at all: ACK
+ * when every capability in it is known, NAK otherwise.
+ * @param client The client.
+ * @param params The command parameters.
+ * @author Hamad
+ */
+void	Server::negotiateCapabilities(pollfd& client, const std::vector<std::string>& params){
+	Client& clientObj = this->clientMap[client.fd];
+	std::string nick = clientObj.isNicknameSet() ? clientObj.getNickname() : "*";
+	std::string prefix = ":" + SERVER_NAME + " " + WEECHAT_CAP + " " + nick + " ";
+	unsigned int available = (1u << NUM_CAPABILITIES) - 1;
+
+	if (this->sessionGrace == 0)
+		available &= ~CAP_RESUME;
+
+	if (params.empty()){
+		sendNumericReply(client, ERR_NEEDMOREPARAMS, "CAP :Not enough parameters");
+		return;
+	}
+	std::string subcommand = params[0];
+	for (size_t i = 0; i < subcommand.length(); i++)
+		subcommand[i] = std::toupper(subcommand[i]);
+
+	if ((subcommand == "LS" || subcommand == "REQ") && !clientObj.isFullyRegistered())
+		clientObj.setCapNegotiating(true);
+	if (subcommand == "LS")
+		queueMessage(client.fd, prefix + "LS :" + capabilityList(available) + CLDR);
+	else if (subcommand == "LIST")
+		queueMessage(client.fd, prefix + "LIST :" + capabilityList(clientObj.getCapabilities()) + CLDR);
+	else if (subcommand == "REQ"){
+		std::string requested = params.size() > 1 ? params[1] : "";
+		std::vector<std::string> names = splitList(requested, ' ');
+		unsigned int enable = 0;
+		unsigned int disable = 0;
+		bool known = !names.empty();
+		for (size_t i = 0; i < names.size() && known; i++){
+			bool removal = names[i][0] == '-';
+			int bit = capabilityBit(removal ? names[i].substr(1) : names[i], available);
+			known = bit != 0;
+			if (removal)
+				disable |= bit;
+			else
+				enable |= bit;
+		}
+		if (!known){
+			queueMessage(client.fd, prefix + "NAK :" + requested + CLDR);
+			return;
+		}
+		clientObj.setCapabilities((clientObj.getCapabilities() | enable) & ~disable);
+		this->hotClients.refresh(client.fd);
+		queueMessage(client.fd, prefix + "ACK :" + requested + CLDR);
+		if (clientObj.isFullyRegistered())
+			updateSessionToken(client.fd);
+	} else if (subcommand == "END"){
+		bool wasRegistered = clientObj.isFullyRegistered();
+		clientObj.setCapNegotiating(false);
+		if (!wasRegistered && clientObj.isFullyRegistered()){
+			sendWelcomeMessages(client);
+			introduceUser(client.fd);
+		}
+	} else
+		sendNumericReply(client, ERR_INVALIDCAPCMD, params[0] + " :Invalid CAP command");
+}
+
+/**
+ * @brief AWAY [:message]. Sets or clears the away message, and tells the
+ * members of the user's channels that enabled away-notify, and the network.
+ * @param client The client.
+ * @param params The command parameters.
+ * @author Hamad
+ */
+void	Server::setAway(pollfd& client, const std::vector<std::string>& params){
+	Client& clientObj = this->clientMap[client.fd];
+	std::string message = params.empty() ? "" : params[0];
+
+	clientObj.setAwayMessage(message);
+	if (message.empty())
+		sendNumericReply(client, RPL_UNAWAY, ":You are no longer marked as being away");
+	else
+		sendNumericReply(client, RPL_NOWAWAY, ":You have been marked as being away");
+	std::string away = " " + WEECHAT_AWAY + (message.empty() ? "" : " :" + message) + CLDR;
+	notifyAway(client.fd, ":" + clientObj.getPrefix() + away);
+	propagate(":" + clientObj.getNickname() + away, -1);
+}
+
+/**
+ * @brief Send an AWAY line once to every away-notify member of the user's
+ * channels, the user excluded.
+ * @param userId The user whose away status changed.
+ * @param line The AWAY line.
+ */
+void	Server::notifyAway(int userId, const std::string& line){
+	std::set<int> delivered;
+
+	delivered.insert(userId);
+	for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+		if (it->second.hasMember(userId))
+			it->second.broadcast(this->hotClients, line, delivered, CAP_AWAY_NOTIFY);
+	}
+}
+
+/**
+ * @brief After a JOIN, tell the away-notify members of the channel that the
+ * user who just joined is away.
+ * @param chan The channel joined.
+ * @param userId The user who joined.
+ */
+void	Server::announceAway(Channel& chan, int userId){
+	const Client& user = this->clientMap[userId];
+	std::set<int> delivered;
+
+	if (!user.isAway())
+		return;
+	delivered.insert(userId);
+	chan.broadcast(this->hotClients, ":" + user.getPrefix() + " " + WEECHAT_AWAY +
+		" :" + user.getAwayMessage() + CLDR, delivered, CAP_AWAY_NOTIFY);
+}
+
+/**
+ * @brief Time and msgid of a new message, shared by its live tags and its
+ * CHATHISTORY entry.
+ * @param time Receives the time in ms, never smaller than the last one.
+ * @return The msgid.
+ */
+unsigned long	Server::stampMessage(unsigned long& time){
+	// The wall clock may step back, message times must not
+	this->lastHistoryTime = std::max(this->lastHistoryTime, wallTimeMs());
+	time = this->lastHistoryTime;
+	return (this->nextMsgid++);
+}
@@ -0,0 +1,128 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerFanout.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/01/01 14:05:12 by hamalmar          #+#    #+#             */
+/*   Updated: 2026/01/01 14:05:12 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Pull fan-out. A message to a channel is normally queued to every member
+	by the command that sent it: with tens of thousands of members, the
+	sender's turn does that much work and every member's queue grows,
+	whether it reads or not.
+
+	From fanout_ring members on a channel keeps what it broadcasts in a
+	ring instead (see ChannelRing.hpp), the sender's turn only appends the
+	line. drainFanout() then copies to each member what it has not read
+	yet, in one batch, when its queue is under SENDQ_LOW_WATERMARK: members
+	that read keep up, the others wait in the ring. A member more than
+	FANOUT_RING_LINES behind skips what it missed and gets a notice with the
+	count, it can ask CHATHISTORY for them.
+
+	JOIN, PART and KICK catch up the member they are about (catchUpMember())
+	so it sees its JOIN before the NAMES reply and its PART or KICK before
+	it stops reading. Everything else waits for the drain, in order.
+
+	The rings only have something new to hand out after a line came in or
+	once a member they left behind drained its queue, drainFanout() does
+	nothing in the other iterations and poll() sleeps as usual.
+
+	A channel switches when it gets a message: to a ring from fanout_ring
+	members, back to push fan-out below half of it, so a channel around the
+	threshold doesn't flip back and forth.
+*/
+
+/**
+ * @brief Send a single target PRIVMSG/NOTICE to a channel's members: in its
+ * ring for a big channel, pushed to them otherwise. The channel switches
+ * between the two here, as its size changed since its last message.
+ * @param chan The channel.
+ * @param line The message.
+ * @param excludeId The sender, -1 for nobody.
+ */
+void	Server::fanOut(Channel& chan, TaggedLine& line, int excludeId){
+	size_t members = chan.getMemberCount();
+
+	if (!chan.getRing().isActive() && this->fanoutRing > 0 && members >= this->fanoutRing){
+		chan.startRing();
+		this->fanoutChannels.insert(chan.getName());
+	} else if (chan.getRing().isActive() && (this->fanoutRing == 0 || members < this->fanoutRing / 2)){
+		countSkipped(chan.stopRing(this->hotClients));
+		this->fanoutChannels.erase(chan.getName());
+	}
+	chan.broadcast(this->hotClients, line, excludeId);
+}
+
+/**
+ * @brief Give a member of a ring channel what it has not read yet, before
+ * a reply that must come after it or before it leaves the channel.
+ * @param chan The channel.
+ * @param id The member.
+ */
+void	Server::catchUpMember(Channel& chan, int id){
+	countSkipped(chan.catchUpMember(this->hotClients, id));
+}
+
+/**
+ * @brief Hand out the rings that got a line, and when a member's queue
+ * went under SENDQ_LOW_WATERMARK since the last time, those that left
+ * members behind.
+ */
+void	Server::drainFanout(void){
+	unsigned long skipped = 0;
+	bool wake = this->fanoutWake;
+
+	this->fanoutWake = false;
+	for (std::set<std::string>::iterator it = this->fanoutChannels.begin(); it != this->fanoutChannels.end();){
+		std::map<std::string, Channel>::iterator chanIt = this->channels.find(*it);
+		if (chanIt == this->channels.end() || !chanIt->second.getRing().isActive()){
+			this->fanoutChannels.erase(it++);
+			continue;
+		}
+		if (wake || chanIt->second.getRing().hasNewLines())
+			skipped += chanIt->second.drainRing(this->hotClients);
+		++it;
+	}
+	countSkipped(skipped);
+}
+
+/**
+ * @brief Whether a ring got a line since the last drain (one queued after
+ * drainFanout() in this iteration, e.g. the QUIT of a dropped member),
+ * the loop doesn't sleep then.
+ */
+bool	Server::hasFanoutLines(void) const{
+	for (std::set<std::string>::const_iterator it = this->fanoutChannels.begin(); it != this->fanoutChannels.end(); ++it){
+		std::map<std::string, Channel>::const_iterator chanIt = this->channels.find(*it);
+		if (chanIt != this->channels.end() && chanIt->second.getRing().hasNewLines())
+			return (true);
+	}
+	return (false);
+}
+
+/**
+ * @brief Go back to push fan-out on every channel, the rings are not part
+ * of the handed over state. What a member can't take is skipped, as when
+ * a channel gets small again.
+ */
+void	Server::finishFanout(void){
+	for (std::set<std::string>::iterator it = this->fanoutChannels.begin(); it != this->fanoutChannels.end(); ++it){
+		std::map<std::string, Channel>::iterator chanIt = this->channels.find(*it);
+		if (chanIt != this->channels.end() && chanIt->second.getRing().isActive())
+			countSkipped(chanIt->second.stopRing(this->hotClients));
+	}
+	this->fanoutChannels.clear();
+}
+
+// Lines members lost to a ring, for hai_fanout_lines_skipped
+void	Server::countSkipped(unsigned long skipped){
+	if (skipped > 0)
+		this->metrics.add(Metrics::FANOUT_SKIPPED, skipped);
+}
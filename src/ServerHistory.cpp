@@ -0,0 +1,224 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerHistory.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/18 11:40:27 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/18 11:40:27 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/**
+ * @brief Keep a channel message for CHATHISTORY, then evict the oldest
+ * messages of the server until the history fits in HISTORY_BUDGET again.
+ * @param chan The channel.
+ * @param line The message as relayed, CRLF included.
+ * @param time The time from stampMessage().
+ * @param msgid The msgid from stampMessage().
+ * @author Hamad
+ */
+void	Server::recordHistory(Channel& chan, const std::string& line, unsigned long time, unsigned long msgid){
+	ChannelHistory& history = chan.getHistory();
+	size_t before = history.getMemoryUsage();
+
+	if (!history.isEmpty())
+		this->historyOldest.erase(std::make_pair(history.getOldestMsgid(), chan.getName()));
+	history.append(time, msgid, line.substr(0, line.length() - CLDR.length()));
+	this->historyOldest.insert(std::make_pair(history.getOldestMsgid(), chan.getName()));
+	this->historyBytes += history.getMemoryUsage() - before;
+	evictHistory(HISTORY_BUDGET);
+}
+
+/**
+ * @brief Drop the oldest messages of the server until the history fits in
+ * budget bytes. A channel left without history gives its memory back.
+ * @param budget The bytes the history may keep.
+ */
+void	Server::evictHistory(size_t budget){
+	while (this->historyBytes > budget && !this->historyOldest.empty()){
+		std::pair<unsigned long, std::string> oldest = *this->historyOldest.begin();
+		this->historyOldest.erase(this->historyOldest.begin());
+		ChannelHistory& victim = this->channels[oldest.second].getHistory();
+		size_t before = victim.getMemoryUsage();
+		victim.dropOldest();
+		this->historyBytes -= before - victim.getMemoryUsage();
+		if (!victim.isEmpty())
+			this->historyOldest.insert(std::make_pair(victim.getOldestMsgid(), oldest.second));
+	}
+}
+
+/**
+ * @brief Where a selector (timestamp=... or msgid=...) points in a history.
+ * @param history The channel history.
+ * @param selector The selector.
+ * @param after true for the first message after the point, false for the
+ * first message at or after it (the end of a BEFORE range).
+ * @param index Receives the index.
+ * @return false if the selector can't be parsed.
+ */
+static bool	selectorIndex(const ChannelHistory& history, const std::string& selector, bool after, size_t& index){
+	size_t equal = selector.find('=');
+	std::string type = selector.substr(0, equal);
+	std::string value = (equal == std::string::npos) ? "" : selector.substr(equal + 1);
+	unsigned long number;
+
+	if (type == "timestamp" && parseServerTime(value, number)){
+		index = history.lowerBoundTime(after ? number + 1 : number);
+		return (true);
+	}
+	if (type == "msgid" && !value.empty() && value.find_first_not_of("0123456789") == std::string::npos){
+		index = history.findMsgid(std::strtoul(value.c_str(), NULL, 10));
+		// A message that fell out of the history is older than everything left
+		if (index == history.getCount())
+			index = 0;
+		else if (after)
+			index++;
+		return (true);
+	}
+	return (false);
+}
+
+/**
+ * @brief CHATHISTORY LATEST|BEFORE|AFTER <channel> <selector> <limit>
+ * (IRCv3 chathistory). The messages go out oldest first in a chathistory
+ * batch, each with its server-time and msgid.
+ * @param client The client.
+ * @param params The command parameters.
+ * @author Hamad
+ */
+void	Server::chatHistory(pollfd& client, const std::vector<std::string>& params){
+	Client& clientObj = this->clientMap[client.fd];
+	std::string prefix = ":" + SERVER_NAME + " " + WEECHAT_FAIL + " " + WEECHAT_CHATHISTORY + " ";
+
+	if (params.size() < 4){
+		queueMessage(client.fd, prefix + "NEED_MORE_PARAMS :Missing parameters" + CLDR);
+		return;
+	}
+	std::string subcommand = params[0];
+	for (size_t i = 0; i < subcommand.length(); i++)
+		subcommand[i] = std::toupper(subcommand[i]);
+	const std::string& target = params[1];
+	if (subcommand != "LATEST" && subcommand != "BEFORE" && subcommand != "AFTER"){
+		queueMessage(client.fd, prefix + "INVALID_PARAMS " + subcommand + " :Unknown subcommand" + CLDR);
+		return;
+	}
+	std::map<std::string, Channel>::iterator it = this->channels.find(target);
+	if (it == this->channels.end() || !it->second.hasMember(client.fd)){
+		queueMessage(client.fd, prefix + "INVALID_TARGET " + subcommand + " " + target + " :Messages could not be retrieved" + CLDR);
+		return;
+	}
+	const ChannelHistory& history = it->second.getHistory();
+	size_t limit = std::strtoul(params[3].c_str(), NULL, 10);
+	if (limit == 0 || limit > CHATHISTORY_LIMIT)
+		limit = CHATHISTORY_LIMIT;
+
+	size_t start = 0;
+	size_t end = history.getCount();
+	size_t pivot = 0;
+	if (!(subcommand == "LATEST" && params[2] == "*") && !selectorIndex(history, params[2], subcommand != "BEFORE", pivot)){
+		queueMessage(client.fd, prefix + "INVALID_PARAMS " + subcommand + " " + params[2] + " :Invalid message reference" + CLDR);
+		return;
+	}
+	if (subcommand == "BEFORE"){
+		end = pivot;
+		start = end > limit ? end - limit : 0;
+	} else if (subcommand == "AFTER"){
+		start = pivot;
+		end = std::min(end, start + limit);
+	} else
+		start = std::max(pivot, end > limit ? end - limit : 0);
+
+	std::ostringstream reference;
+	reference << "history" << this->nextMsgid++;
+	std::string out = ":" + SERVER_NAME + " " + WEECHAT_BATCH + " +" + reference.str() + " chathistory " + target + CLDR;
+	for (size_t i = start; i < end; i++){
+		const ChannelHistory::Entry& entry = history.getEntry(i);
+		std::ostringstream tags;
+		tags << "@batch=" << reference.str() << ";time=" << formatServerTime(entry.time) << ";msgid=" << entry.msgid << " ";
+		out += tags.str() + history.getLine(i) + CLDR;
+	}
+	out += ":" + SERVER_NAME + " " + WEECHAT_BATCH + " -" + reference.str() + CLDR;
+	clientObj.queueOutput(out);
+}
+
+/**
+ * @brief Hand a line shown in a channel to the log writer if the channel
+ * is marked "log". Only a copy into the writer's queue happens here.
+ * @param chan The channel.
+ * @param line The line, CRLF included.
+ */
+void	Server::logChannel(const Channel& chan, const std::string& line){
+	if (!this->channelLogger.isEnabled() || this->loggedChannels.find(chan.getName()) == this->loggedChannels.end())
+		return;
+	this->channelLogger.append(chan.getName(), line.substr(0, line.length() - CLDR.length()));
+}
+
+/**
+ * @brief SEARCH <channel|*> <words> (server operators only). Sends the logged
+ * lines that have every word, newest first and at most SEARCH_LIMIT, as
+ * notices. The lookups go through the index files (see LogIndex.hpp), on
+ * the indexer thread: the answer comes with deliverSearches().
+ * @param client The client.
+ * @param params The command parameters.
+ * @author Hamad
+ */
+void	Server::searchLogs(pollfd& client, const std::vector<std::string>& params){
+	Client& clientObj = this->clientMap[client.fd];
+	std::string prefix = ":" + SERVER_NAME + " " + WEECHAT_FAIL + " " + WEECHAT_SEARCH + " ";
+
+	if (!clientObj.isServerOperator()){
+		sendNumericReply(client, ERR_NOPRIVILEGES, ":Permission Denied- You're not an IRC operator");
+		return;
+	}
+	if (params.size() < 2){
+		queueMessage(client.fd, prefix + "NEED_MORE_PARAMS :Missing parameters" + CLDR);
+		return;
+	}
+	if (!this->logIndex.isEnabled()){
+		queueMessage(client.fd, prefix + "UNAVAILABLE :Channel logs are disabled" + CLDR);
+		return;
+	}
+	// SEARCH #c some words and SEARCH #c :some words are the same
+	std::string text;
+	for (size_t i = 1; i < params.size(); i++)
+		text += params[i] + " ";
+
+	unsigned long ticket = this->logIndex.submit(params[0], text, SEARCH_LIMIT);
+	this->searches[ticket] = std::make_pair(std::make_pair(client.fd, clientObj.getNickname()), currentTimeMs());
+}
+
+/**
+ * @brief Send the results of the searches the indexer finished, once per
+ * loop iteration.
+ */
+void	Server::deliverSearches(void){
+	std::vector<LogIndex::Result> done;
+
+	this->logIndex.collect(done);
+	for (size_t i = 0; i < done.size(); i++){
+		std::map<unsigned long, std::pair<std::pair<int, std::string>, unsigned long> >::iterator it = this->searches.find(done[i].ticket);
+		if (it == this->searches.end())
+			continue;
+		int fd = it->second.first.first;
+		unsigned long started = it->second.second;
+		std::map<int, Client>::iterator clientIt = this->clientMap.find(fd);
+		bool present = clientIt != this->clientMap.end() && clientIt->second.isServerOperator()
+			&& clientIt->second.getNickname() == it->second.first.second;
+		this->searches.erase(it);
+		if (!present)
+			continue;
+
+		const std::vector<LogIndex::Match>& matches = done[i].matches;
+		std::string notice = ":" + SERVER_NAME + " " + WEECHAT_NOTICE + " " + clientIt->second.getNickname() + " :";
+		std::string out;
+		for (size_t j = 0; j < matches.size(); j++)
+			out += notice + matches[j].channel + " " + matches[j].line + CLDR;
+		std::ostringstream end;
+		end << notice << "End of SEARCH, " << matches.size() << " lines in " << (currentTimeMs() - started) << " ms" << CLDR;
+		clientIt->second.queueOutput(out + end.str());
+	}
+}
@@ -0,0 +1,673 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerLink.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/16 19:02:48 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/16 19:02:48 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Server to server links, a reduced RFC 2813. The servers of a network form
+	a spanning tree: a server that is already known, directly or behind
+	another link, is refused. Handshake, the side that connected first:
+
+		PASS <password> 0210 HAI
+		SERVER <name> 1 :<description>
+
+	The other side answers the same once the password matches its link
+	block. Then both send a burst of everything they know:
+
+		:<us> SERVER <name> <hop> :<description>      servers behind us
+		NICK <nick> <hop> <ts> <user> <host> <server> :<realname>
+		NJOIN <#chan> :@nick,nick                      channel members
+		:<us> CHANINFO <#chan> <created> <+modes> [args] :<topic>
+
+	After the burst changes are relayed as client style lines with the user
+	in the prefix (:nick JOIN #chan, :nick MODE #chan +k key, ...), each
+	server passing them on to its other links. Channel messages only go to
+	the links that have members in the channel.
+
+	Conflicts are settled with timestamps so every server reaches the same
+	result on its own: on a nick collision the older nickname stays (both
+	go on a tie), and in a burst the channel created first keeps its modes
+	and topic.
+*/
+
+static std::string	toString(unsigned long value){
+	std::ostringstream oss;
+	oss << value;
+	return (oss.str());
+}
+
+// "nick!user" -> "nick"
+static std::string	prefixNick(const std::string& prefix){
+	return (prefix.substr(0, prefix.find('!')));
+}
+
+/**
+ * @brief Open the autoconnect links that are down. Called from the event
+ * loop every LINK_RETRY_MS, the connect() itself never blocks.
+ * @author Hamad
+ */
+void	Server::connectLinks(void){
+	this->lastLinkAttempt = currentTimeMs();
+	for (size_t i = 0; i < this->linkBlocks.size(); i++){
+		const LinkBlock& block = this->linkBlocks[i];
+		if (!block.isAutoconnect() || this->knownServers.find(block.getName()) != this->knownServers.end())
+			continue;
+		bool connecting = false;
+		for (unsigned int slot = 1; slot < this->serverCapacity && !connecting; slot++){
+			std::map<int, Client>::iterator it = this->clientMap.find(this->clients[slot].fd);
+			connecting = (it != this->clientMap.end() && it->second.isServer() && it->second.getServerName() == block.getName());
+		}
+		unsigned int slot = 1;
+		while (slot < this->serverCapacity && this->clients[slot].fd != -1)
+			slot++;
+		if (connecting || slot == this->serverCapacity)
+			continue;
+
+		sockaddr_in peer;
+		std::memset(&peer, 0, sizeof(peer));
+		peer.sin_family = AF_INET;
+		peer.sin_port = htons(block.getPort());
+		inet_aton(block.getHost().c_str(), &peer.sin_addr);
+		int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (fd < 0)
+			continue;
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 ||
+			(connect(fd, (sockaddr *)&peer, sizeof(peer)) < 0 && errno != EINPROGRESS)){
+			std::cerr << "Link to " << block.getName() << " failed: " << std::strerror(errno) << std::endl;
+			close(fd);
+			continue;
+		}
+		// The handshake waits in the queue until the connection is up
+		this->clients[slot].fd = fd;
+		this->clients[slot].events = POLLIN | POLLOUT;
+		Client& link = this->clientMap[fd];
+		link = Client();
+		link.setLinkState(Client::LINK_CONNECTING);
+		link.setServerName(block.getName());
+		link.setHostname(block.getHost());
+		link.setAddress(ntohl(peer.sin_addr.s_addr));
+		this->clientBuffer[fd] = std::string("");
+		queueMessage(fd, WEECHAT_PASS + " " + block.getPassword() + " " + LINK_PROTOCOL_VERSION + " " + SERVER_NAME + CLDR);
+		queueMessage(fd, WEECHAT_SERVER + " " + this->serverName + " 1 :" + SERVER_NAME + " server" + CLDR);
+	}
+}
+
+/**
+ * @brief SERVER <name> <hopcount> :<description> from a connection that is
+ * not registered yet: a server answering our handshake or opening a link.
+ * @param client The connection.
+ * @param params The command parameters.
+ */
+void	Server::acceptLink(pollfd& client, const std::vector<std::string>& params){
+	Client& peer = this->clientMap[client.fd];
+
+	if (peer.isFullyRegistered() || peer.getLinkState() == Client::LINK_ESTABLISHED){
+		sendNumericReply(client, ERR_ALREADYREGISTRED, ":You may not reregister");
+		return;
+	}
+	if (params.size() < 1){
+		sendNumericReply(client, ERR_NEEDMOREPARAMS, "SERVER :Not enough parameters");
+		return;
+	}
+	const std::string& name = params[0];
+	const LinkBlock* block = NULL;
+	for (size_t i = 0; i < this->linkBlocks.size() && !block; i++){
+		if (this->linkBlocks[i].getName() == name)
+			block = &this->linkBlocks[i];
+	}
+	std::string refused;
+	if (!block || block->getPassword() != peer.getLinkPassword())
+		refused = "Access denied";
+	else if (peer.getLinkState() == Client::LINK_CONNECTING && peer.getServerName() != name)
+		refused = "Expected " + peer.getServerName();
+	else if (name == this->serverName || this->knownServers.find(name) != this->knownServers.end())
+		refused = "Server " + name + " already exists";
+	if (!refused.empty()){
+		std::cerr << "Refused link from " << name << ": " << refused << std::endl;
+		disconnectClient(client, refused);
+		return;
+	}
+
+	if (peer.getLinkState() == Client::LINK_NONE){
+		queueMessage(client.fd, WEECHAT_PASS + " " + block->getPassword() + " " + LINK_PROTOCOL_VERSION + " " + SERVER_NAME + CLDR);
+		queueMessage(client.fd, WEECHAT_SERVER + " " + this->serverName + " 1 :" + SERVER_NAME + " server" + CLDR);
+	}
+	peer.setLinkState(Client::LINK_ESTABLISHED);
+	peer.setServerName(name);
+	peer.setPasswordAuthenticated(true);
+	this->knownServers[name] = client.fd;
+
+	// Tell the rest of the network, then teach the new server what we know
+	propagate(":" + this->serverName + " " + WEECHAT_SERVER + " " + name + " 2 :" + SERVER_NAME + " server" + CLDR, client.fd);
+	sendBurst(client.fd);
+	std::cout << "\033[1;32mLinked with " << name << "\033[0m" << std::endl;
+}
+
+std::string	Server::introduction(const Client& user, int hopcount) const{
+	std::ostringstream oss;
+	oss << WEECHAT_NICKNAME << " " << user.getNickname() << " " << hopcount << " " << user.getNicknameTs() << " "
+		<< user.getUsername() << " " << user.getHostname() << " "
+		<< (user.isRemote() ? user.getServerName() : this->serverName) << " :" << user.getRealname() << CLDR;
+	return (oss.str());
+}
+
+/**
+ * @brief Send a new link everything we know: servers, users, channel
+ * members and channel state.
+ * @param linkFd The new link.
+ */
+void	Server::sendBurst(int linkFd){
+	for (std::map<std::string, int>::iterator it = this->knownServers.begin(); it != this->knownServers.end(); ++it){
+		if (it->second != linkFd)
+			queueMessage(linkFd, ":" + this->serverName + " " + WEECHAT_SERVER + " " + it->first + " 2 :" + SERVER_NAME + " server" + CLDR);
+	}
+	for (std::map<int, Client>::iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		const Client& user = it->second;
+		if (user.isServer() || !user.isFullyRegistered() || user.getLink() == linkFd)
+			continue;
+		queueMessage(linkFd, introduction(user, user.isRemote() ? 2 : 1));
+		if (user.isAway())
+			queueMessage(linkFd, ":" + user.getNickname() + " " + WEECHAT_AWAY + " :" + user.getAwayMessage() + CLDR);
+	}
+	for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+		const Channel& chan = it->second;
+		const std::set<int>& members = chan.getMembers();
+		std::string names;
+		for (std::set<int>::const_iterator m = members.begin(); m != members.end(); ++m){
+			const Client& member = this->clientMap[*m];
+			if (member.getLink() == linkFd)
+				continue;
+			if (!names.empty())
+				names += ",";
+			names += (chan.isOperator(*m) ? "@" : "") + member.getNickname();
+			if (names.length() > NAMES_LINE_LENGTH){
+				queueMessage(linkFd, WEECHAT_NJOIN + " " + chan.getName() + " :" + names + CLDR);
+				names.clear();
+			}
+		}
+		if (!names.empty())
+			queueMessage(linkFd, WEECHAT_NJOIN + " " + chan.getName() + " :" + names + CLDR);
+
+		std::string modes = "+";
+		std::string args;
+		if (chan.isInviteOnly())
+			modes += "i";
+		if (chan.isTopicRestricted())
+			modes += "t";
+		if (!chan.getKey().empty()){
+			modes += "k";
+			args += " " + chan.getKey();
+		}
+		if (chan.getUserLimit() > 0){
+			modes += "l";
+			args += " " + toString(chan.getUserLimit());
+		}
+		queueMessage(linkFd, ":" + this->serverName + " CHANINFO " + chan.getName() + " " + chan.getCreationTime() +
+			" " + modes + args + " :" + chan.getTopic() + CLDR);
+	}
+}
+
+/**
+ * @brief Send a line to every link but one.
+ * @param line The line, CRLF included.
+ * @param exceptLink The link the line came from, -1 for none.
+ */
+void	Server::propagate(const std::string& line, int exceptLink){
+	std::set<int> links;
+	for (std::map<std::string, int>::iterator it = this->knownServers.begin(); it != this->knownServers.end(); ++it)
+		links.insert(it->second);
+	for (std::set<int>::iterator it = links.begin(); it != links.end(); ++it){
+		if (*it != exceptLink)
+			queueMessage(*it, line);
+	}
+}
+
+/**
+ * @brief Send a channel line only to the links that have members of the
+ * channel behind them, once per link.
+ * @param chan The channel.
+ * @param line The line, CRLF included.
+ * @param exceptLink The link the line came from, -1 for none.
+ */
+void	Server::propagateToChannel(const Channel& chan, const std::string& line, int exceptLink){
+	std::set<int> links;
+	const std::set<int>& members = chan.getMembers();
+	for (std::set<int>::const_iterator it = members.begin(); it != members.end(); ++it){
+		std::map<int, Client>::iterator memberIt = this->clientMap.find(*it);
+		if (memberIt != this->clientMap.end() && memberIt->second.isRemote())
+			links.insert(memberIt->second.getLink());
+	}
+	for (std::set<int>::iterator it = links.begin(); it != links.end(); ++it){
+		if (*it != exceptLink)
+			queueMessage(*it, line);
+	}
+}
+
+// A local user finished registering, the whole network learns about it
+void	Server::introduceUser(int clientFd){
+	propagate(introduction(this->clientMap[clientFd], 1), -1);
+}
+
+/**
+ * @brief A link went down: every server and user behind it is gone. The
+ * other links get a SQUIT per lost server and drop their users themselves.
+ * @param linkFd The link.
+ * @param reason Why the link went down.
+ */
+void	Server::splitLink(int linkFd, const std::string& reason){
+	std::string peerName = this->clientMap[linkFd].getServerName();
+	std::vector<std::string> lost;
+	for (std::map<std::string, int>::iterator it = this->knownServers.begin(); it != this->knownServers.end(); ++it){
+		if (it->second == linkFd)
+			lost.push_back(it->first);
+	}
+	for (size_t i = 0; i < lost.size(); i++){
+		this->knownServers.erase(lost[i]);
+		propagate(":" + this->serverName + " " + WEECHAT_SQUIT + " " + lost[i] + " :" + reason + CLDR, linkFd);
+	}
+	std::vector<int> users;
+	for (std::map<int, Client>::iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		if (it->second.getLink() == linkFd)
+			users.push_back(it->first);
+	}
+	for (size_t i = 0; i < users.size(); i++)
+		removeRemoteUser(users[i], ":" + this->clientMap[users[i]].getNickname() + " " + WEECHAT_QUIT + " :" +
+			this->serverName + " " + peerName + CLDR);
+	std::cout << "\033[1;33mLost link with " << peerName << " (" << reason << "), "
+		<< users.size() << " users gone\033[0m" << std::endl;
+}
+
+/**
+ * @brief Forget a user of another server, telling the local members of its
+ * channels.
+ * @param userId The user's id in the client map.
+ * @param quitLine The QUIT shown to local users, CRLF included.
+ */
+void	Server::removeRemoteUser(int userId, const std::string& quitLine){
+	quitChannels(userId, quitLine);
+	this->clientMap.erase(userId);
+	this->hotClients.erase(userId);
+	this->remoteUserCount--;
+}
+
+/**
+ * @brief Take a user without a connection here (remote or detached) out of
+ * its channels, each local member getting the QUIT once.
+ * @param userId The user's id in the client map.
+ * @param quitLine The QUIT shown to local users, CRLF included.
+ */
+void	Server::quitChannels(int userId, const std::string& quitLine){
+	std::set<int> delivered;
+	delivered.insert(userId);
+	for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+		Channel& chan = it->second;
+		if (!chan.hasMember(userId))
+			continue;
+		chan.broadcast(this->hotClients, quitLine, delivered);
+		logChannel(chan, quitLine);
+		int newOpFd = chan.removeMember(userId);
+		if (newOpFd != -1)
+			chan.broadcast(this->hotClients, ":" + SERVER_NAME + " MODE " + it->first + " +o " +
+				this->clientMap[newOpFd].getNickname() + CLDR);
+	}
+}
+
+/**
+ * @brief Remove a user from the whole network.
+ * @param userId The user, local or remote.
+ * @param reason The kill reason.
+ * @param exceptLink The link the KILL came from, -1 for none.
+ */
+void	Server::killUser(int userId, const std::string& reason, int exceptLink){
+	Client& user = this->clientMap[userId];
+	std::string nick = user.getNickname();
+
+	propagate(":" + this->serverName + " " + WEECHAT_KILL + " " + nick + " :" + reason + CLDR, exceptLink);
+	if (user.isRemote()){
+		removeRemoteUser(userId, ":" + nick + " " + WEECHAT_QUIT + " :Killed (" + reason + ")" + CLDR);
+		return;
+	}
+	if (this->detachedSessions.find(userId) != this->detachedSessions.end()){
+		endSession(userId, "Killed (" + reason + ")", false);
+		return;
+	}
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		if (this->clients[i].fd == userId){
+			user.consumeOutput(user.getOutputSize());
+			queueMessage(userId, WEECHAT_ERROR + " :Closing Link: " + user.getHostname() + " (Killed (" + reason + "))" + CLDR);
+			// The KILL already told the network, a QUIT now could hit the winner of the nick
+			cleanClient(this->clients[i], false);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief A link introduces incomingNick (or renames a user to it) while
+ * existingId has it here. The older nickname stays, on a tie both go.
+ * @return true if the incoming user keeps the nickname.
+ */
+bool	Server::resolveNickCollision(int existingId, unsigned long incomingTs, const std::string& incomingNick, pollfd& link){
+	unsigned long existingTs = this->clientMap[existingId].getNicknameTs();
+
+	if (incomingTs <= existingTs)
+		killUser(existingId, "Nick collision", link.fd);
+	if (incomingTs >= existingTs){
+		queueMessage(link.fd, ":" + this->serverName + " " + WEECHAT_KILL + " " + incomingNick + " :Nick collision" + CLDR);
+		return (false);
+	}
+	return (true);
+}
+
+/**
+ * @brief Apply MODE parameters (#chan, modes, arguments...) coming from a
+ * link. The sending server checked the rights already.
+ */
+void	Server::applyRemoteModes(Channel& chan, const std::vector<std::string>& params){
+	bool	adding = true;
+	size_t	arg = 2;
+
+	if (params.size() < 2)
+		return;
+	for (size_t i = 0; i < params[1].length(); i++){
+		char mode = params[1][i];
+		if (mode == '+' || mode == '-')
+			adding = (mode == '+');
+		else if (mode == 'i')
+			chan.setInviteOnly(adding);
+		else if (mode == 't')
+			chan.setTopicRestricted(adding);
+		else if (mode == 'k'){
+			if (!adding)
+				chan.setKey("");
+			else if (arg < params.size())
+				chan.setKey(params[arg++]);
+		} else if (mode == 'l'){
+			if (!adding)
+				chan.setUserLimit(-1);
+			else if (arg < params.size())
+				chan.setUserLimit(std::atoi(params[arg++].c_str()));
+		} else if (mode == 'o' && arg < params.size()){
+			int target = findClientByNickname(params[arg++]);
+			if (target != -1 && adding)
+				chan.addOperator(target);
+			else if (target != -1)
+				chan.removeOperator(target);
+		}
+	}
+}
+
+// A user of another server joins, channels unknown here are created
+void	Server::remoteJoin(int userId, const std::string& channelName, bool asOperator){
+	if (WEECHAT_CHANNEL_PREFIX.find(channelName[0]) == std::string::npos)
+		return;
+	std::map<std::string, Channel>::iterator it = this->channels.find(channelName);
+	if (it == this->channels.end()){
+		it = this->channels.insert(std::make_pair(channelName, Channel(channelName))).first;
+		this->channelStore.markDirty(channelName);
+	}
+	Channel& chan = it->second;
+	if (chan.hasMember(userId))
+		return;
+	chan.addMember(userId);
+	if (asOperator || chan.getMemberCount() == 1)
+		chan.addOperator(userId);
+	chan.removeInvite(userId);
+	std::string joinLine = ":" + this->clientMap[userId].getNickname() + " " + WEECHAT_JOIN + " " + channelName + CLDR;
+	chan.broadcast(this->hotClients, joinLine);
+	logChannel(chan, joinLine);
+	announceAway(chan, userId);
+}
+
+/**
+ * @brief Run a line received on an established server link.
+ * @param link The link.
+ * @param msg The parsed line.
+ * @author Hamad
+ */
+void	Server::processServerMessage(pollfd& link, const Message& msg){
+	std::string command = msg.getCommand();
+	for (size_t i = 0; i < command.length(); i++)
+		command[i] = std::toupper(command[i]);
+	const std::vector<std::string>& params = msg.getParameters();
+	std::string source = prefixNick(msg.getPrefix());
+	int sourceId = source.empty() ? -1 : findClientByNickname(source);
+	std::string& line = this->scratch.take();
+	line.append(msg.getRawMessage()).append(CLDR);
+
+	if (command == WEECHAT_PING){
+		queueMessage(link.fd, ":" + this->serverName + " " + WEECHAT_PONG + " " + this->serverName +
+			" :" + (params.empty() ? this->serverName : params[0]) + CLDR);
+		return;
+	}
+	if (command == WEECHAT_PONG)
+		return;
+	if (command == WEECHAT_ERROR){
+		std::cerr << "Link " << this->clientMap[link.fd].getServerName() << ": " << line;
+		return;
+	}
+	// :origin SERVER <name> <hop> :<description>, a server behind the link
+	if (command == WEECHAT_SERVER){
+		if (params.size() < 1)
+			return;
+		if (params[0] == this->serverName || this->knownServers.find(params[0]) != this->knownServers.end()){
+			disconnectClient(link, "Server " + params[0] + " already exists");
+			return;
+		}
+		this->knownServers[params[0]] = link.fd;
+		propagate(":" + this->serverName + " " + WEECHAT_SERVER + " " + params[0] + " " +
+			toString(std::strtoul(params.size() > 1 ? params[1].c_str() : "1", NULL, 10) + 1) + " :" + SERVER_NAME + " server" + CLDR, link.fd);
+		return;
+	}
+	if (command == WEECHAT_SQUIT){
+		std::map<std::string, int>::iterator it = params.empty() ? this->knownServers.end() : this->knownServers.find(params[0]);
+		if (it == this->knownServers.end() || it->second != link.fd)
+			return;
+		this->knownServers.erase(it);
+		std::vector<int> users;
+		for (std::map<int, Client>::iterator userIt = this->clientMap.begin(); userIt != this->clientMap.end(); ++userIt){
+			if (userIt->second.getLink() == link.fd && userIt->second.getServerName() == params[0])
+				users.push_back(userIt->first);
+		}
+		for (size_t i = 0; i < users.size(); i++)
+			removeRemoteUser(users[i], ":" + this->clientMap[users[i]].getNickname() + " " + WEECHAT_QUIT + " :" +
+				this->clientMap[link.fd].getServerName() + " " + params[0] + CLDR);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_NICKNAME && params.size() >= 7){
+		// NICK <nick> <hop> <ts> <user> <host> <server> :<realname>
+		unsigned long ts = std::strtoul(params[2].c_str(), NULL, 10);
+		int existing = findClientByNickname(params[0]);
+		if (existing != -1 && !resolveNickCollision(existing, ts, params[0], link))
+			return;
+		Client user;
+		user.setNickname(params[0]);
+		user.setNicknameSet(true);
+		user.setNicknameTs(ts);
+		user.setUsername(params[3]);
+		user.setHostname(params[4]);
+		user.setServerName(params[5]);
+		user.setRealname(params[6]);
+		user.setUserSet(true);
+		user.setPasswordAuthenticated(true);
+		user.setLink(link.fd);
+		int userId = this->nextRemoteId++;
+		propagate(introduction(user, std::atoi(params[1].c_str()) + 1), link.fd);
+		this->clientMap[userId] = HAI_MOVE(user);
+		this->remoteUserCount++;
+		return;
+	}
+	if (command == WEECHAT_NJOIN && params.size() >= 2){
+		std::vector<std::string> names = splitList(params[1], ',');
+		for (size_t i = 0; i < names.size(); i++){
+			bool op = (names[i][0] == '@');
+			int userId = findClientByNickname(op ? names[i].substr(1) : names[i]);
+			if (userId != -1 && this->clientMap[userId].getLink() == link.fd)
+				remoteJoin(userId, params[0], op);
+		}
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == "CHANINFO" && params.size() >= 4){
+		// :origin CHANINFO <#chan> <created> <+modes> [args...] :<topic>
+		if (WEECHAT_CHANNEL_PREFIX.find(params[0][0]) == std::string::npos)
+			return;
+		std::map<std::string, Channel>::iterator it = this->channels.find(params[0]);
+		if (it == this->channels.end())
+			it = this->channels.insert(std::make_pair(params[0], Channel(params[0]))).first;
+		Channel& chan = it->second;
+		unsigned long remoteTs = std::strtoul(params[1].c_str(), NULL, 10);
+		unsigned long localTs = std::strtoul(chan.getCreationTime().c_str(), NULL, 10);
+		// Older channel wins, a tie goes to the lowest server name, the same answer everywhere
+		if (remoteTs > localTs || (remoteTs == localTs && msg.getPrefix() >= this->serverName))
+			return;
+		chan.setCreationTime(params[1]);
+		chan.setInviteOnly(false);
+		chan.setTopicRestricted(false);
+		chan.setKey("");
+		chan.setUserLimit(-1);
+		std::vector<std::string> modeParams(params.begin(), params.end() - 1);
+		modeParams.erase(modeParams.begin() + 1);
+		applyRemoteModes(chan, modeParams);
+		chan.setTopic(params.back());
+		this->channelStore.markDirty(params[0]);
+		std::string modes;
+		for (size_t i = 1; i < modeParams.size(); i++)
+			modes += " " + modeParams[i];
+		chan.broadcast(this->hotClients, ":" + SERVER_NAME + " " + WEECHAT_MODE + " " + params[0] + modes + CLDR);
+		if (!params.back().empty())
+			chan.broadcast(this->hotClients, ":" + SERVER_NAME + " " + WEECHAT_TOPIC + " " + params[0] + " :" + params.back() + CLDR);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_KILL && params.size() >= 1){
+		int userId = findClientByNickname(params[0]);
+		if (userId != -1)
+			killUser(userId, params.size() > 1 ? params[1] : "Killed", link.fd);
+		return;
+	}
+
+	// Everything else comes from a user behind this link
+	if (sourceId == -1 || this->clientMap[sourceId].getLink() != link.fd)
+		return;
+	Client& user = this->clientMap[sourceId];
+
+	if (command == WEECHAT_NICKNAME && params.size() >= 1){
+		// :old NICK <new> <ts>
+		unsigned long ts = params.size() > 1 ? std::strtoul(params[1].c_str(), NULL, 10) : std::time(NULL);
+		int existing = findClientByNickname(params[0]);
+		if (existing != -1 && existing != sourceId && !resolveNickCollision(existing, ts, params[0], link)){
+			// The other links still know the loser by its old nickname
+			propagate(":" + this->serverName + " " + WEECHAT_KILL + " " + source + " :Nick collision" + CLDR, link.fd);
+			removeRemoteUser(sourceId, ":" + source + " " + WEECHAT_QUIT + " :Killed (Nick collision)" + CLDR);
+			return;
+		}
+		std::set<int> delivered;
+		delivered.insert(sourceId);
+		for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+			if (it->second.hasMember(sourceId))
+				it->second.broadcast(this->hotClients, ":" + source + " " + WEECHAT_NICKNAME + " " + params[0] + CLDR, delivered);
+		}
+		user.setNickname(params[0]);
+		user.setNicknameTs(ts);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_QUIT){
+		removeRemoteUser(sourceId, line);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_AWAY){
+		user.setAwayMessage(params.empty() ? "" : params[0]);
+		notifyAway(sourceId, ":" + user.getPrefix() + " " + WEECHAT_AWAY +
+			(user.isAway() ? " :" + user.getAwayMessage() : "") + CLDR);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_JOIN && params.size() >= 1){
+		std::vector<std::string> names = splitList(params[0], ',');
+		for (size_t i = 0; i < names.size(); i++)
+			remoteJoin(sourceId, names[i], false);
+		propagate(line, link.fd);
+		return;
+	}
+	if (command == WEECHAT_INVITE && params.size() >= 2){
+		int target = findClientByNickname(params[0]);
+		std::map<std::string, Channel>::iterator it = this->channels.find(params[1]);
+		if (target == -1 || it == this->channels.end())
+			return;
+		it->second.inviteUser(target);
+		if (this->clientMap[target].isRemote()){
+			if (this->clientMap[target].getLink() != link.fd)
+				queueMessage(this->clientMap[target].getLink(), line);
+		} else
+			queueMessage(target, ":" + SERVER_NAME + " " + WEECHAT_NOTICE + " " + params[0] +
+				" :You have been invited to " + params[1] + " by " + source + CLDR);
+		return;
+	}
+	if ((command == WEECHAT_PRIVMSG || command == WEECHAT_NOTICE) && params.size() >= 2){
+		// Peers send plain lines, the tags are this server's
+		unsigned long time;
+		unsigned long msgid = stampMessage(time);
+		TaggedLine tagged(line, time, msgid);
+		if (WEECHAT_CHANNEL_PREFIX.find(params[0][0]) != std::string::npos){
+			std::map<std::string, Channel>::iterator it = this->channels.find(params[0]);
+			if (it == this->channels.end())
+				return;
+			// A single target, like a local one: through the ring of a big channel
+			fanOut(it->second, tagged, sourceId);
+			propagateToChannel(it->second, line, link.fd);
+			recordHistory(it->second, line, time, msgid);
+			logChannel(it->second, line);
+			return;
+		}
+		int target = findClientByNickname(params[0]);
+		if (target == -1)
+			return;
+		if (!this->clientMap[target].isRemote())
+			this->clientMap[target].queueOutput(tagged.render(this->clientMap[target].getCapabilities()));
+		else if (this->clientMap[target].getLink() != link.fd)
+			queueMessage(this->clientMap[target].getLink(), line);
+		return;
+	}
+
+	// Channel commands: PART, KICK, TOPIC, MODE
+	std::map<std::string, Channel>::iterator chanIt = params.empty() ? this->channels.end() : this->channels.find(params[0]);
+	if (chanIt == this->channels.end())
+		return;
+	Channel& chan = chanIt->second;
+	int leaving = -1;
+	if (command == WEECHAT_PART)
+		leaving = sourceId;
+	else if (command == WEECHAT_KICK && params.size() >= 2)
+		leaving = findClientByNickname(params[1]);
+	else if (command == WEECHAT_TOPIC && params.size() >= 2){
+		chan.setTopic(params[1]);
+		this->channelStore.markDirty(params[0]);
+	} else if (command == WEECHAT_MODE && params.size() >= 2){
+		applyRemoteModes(chan, params);
+		this->channelStore.markDirty(params[0]);
+	} else
+		return;
+	chan.broadcast(this->hotClients, line);
+	logChannel(chan, line);
+	if (leaving != -1 && chan.hasMember(leaving)){
+		catchUpMember(chan, leaving);
+		int newOpFd = chan.removeMember(leaving);
+		if (newOpFd != -1)
+			chan.broadcast(this->hotClients, ":" + SERVER_NAME + " MODE " + params[0] + " +o " +
+				this->clientMap[newOpFd].getNickname() + CLDR);
+	}
+	propagate(line, link.fd);
+}
@@ -0,0 +1,64 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerLocal.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/28 10:02:51 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/28 10:02:51 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	In-process transport. Connections normally come from the TCP listener,
+	a Server built without a port has none and gets its connections from
+	whoever embeds it instead: openLocalConnection() gives the server one
+	end of a socketpair and the caller the other, to talk IRC on. Past
+	accept the server can't tell them from TCP connections, they get a
+	class, flood control and output queues the same way. The embedder runs
+	the loop with runIteration() instead of start(), e.g. tools/bench.cpp.
+*/
+
+/**
+ * @brief A server without a listening socket, see openLocalConnection().
+ * @param password The server password.
+ * @param config The settings, listen is ignored.
+ * @throw EmptyPasswordException if the password is empty.
+ * @author Hamad
+ */
+Server::Server(const std::string& password, const Config& config) : hotClients(clientMap) {
+	if (password.empty())
+		throw (Server::EmptyPasswordException());
+	this->port = 0;
+	this->password = password;
+	this->serverSocket = -1;
+	this->pollManager = -1;
+	std::memset(&this->serverAddress, 0, sizeof(this->serverAddress));
+	loadSettings(config);
+	initializeState(config);
+	if (!config.getCapture().empty())
+		this->capture.start(config.getCapture());
+}
+
+/**
+ * @brief Connect a socketpair to the server as if it came from address.
+ * @param address The IPv4 address the connection pretends to come from
+ * (host byte order), it picks the connection class.
+ * @return The caller's end, blocking, or -1 if the server refused the
+ * connection (full, or no class for the address).
+ */
+int	Server::openLocalConnection(in_addr_t address){
+	int pair[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+		return (-1);
+	fcntl(pair[1], F_SETFD, FD_CLOEXEC);
+	if (!acceptConnection(pair[0], address, currentTimeMs())){
+		close(pair[1]);
+		return (-1);
+	}
+	return (pair[1]);
+}
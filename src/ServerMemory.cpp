@@ -0,0 +1,185 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerMemory.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/30 14:12:36 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/30 14:12:36 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Memory accounting. measureMemory() walks the server's containers and
+	adds up what they hold, by subsystem (see MemoryUsage.hpp):
+
+		connections  the clients (local, remote, detached), the pollfd
+		             array, the scheduler and the session tokens
+		input        the unread input of every connection, recv buffer,
+		             scratch strings
+		output       the output queues and the pending WHO/NAMES/LIST
+		channels     the channels, their member sets and fan-out rings
+		history      the CHATHISTORY rings and arenas
+		services     admin consoles, scrapes, capture, log queue
+
+	Nothing is counted as it is allocated, the walk is cheap enough to run
+	once per MEMORY_CHECK_MS when memory_budget is set, and on demand for
+	MEMSTATS (server operators), MEMSTATS on the admin console and the
+	metrics page.
+
+	Past the budget the server sheds load, the cheapest loss first: the
+	oldest history, then new connections (refused until the server is
+	back under), then the clients with the most output waiting, which are
+	usually the ones not reading it.
+*/
+
+/**
+ * @brief Add up what the server holds, by subsystem.
+ * @param usage Receives the figures, heapInUse is left alone.
+ */
+void	Server::measureMemory(MemoryUsage& usage) const{
+	size_t *bytes = usage.bytes;
+
+	for (size_t i = 0; i < MemoryUsage::NUM_SUBSYSTEMS; i++)
+		bytes[i] = 0;
+	usage.connections = 0;
+	for (unsigned int i = 1; i < this->serverCapacity; i++)
+		usage.connections += this->clients[i].fd >= 0;
+
+	bytes[MemoryUsage::CONNECTIONS] += allocationBytes((this->serverCapacity + SERVICE_SLOTS) * sizeof(pollfd))
+		+ allocationBytes((this->scheduledClients.capacity() + 7) / 8)
+		+ allocationBytes(this->throttledClients.capacity() * sizeof(unsigned int))
+		+ dequeBytes(this->readyClients.size(), sizeof(unsigned int));
+	for (std::map<int, Client>::const_iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		bytes[MemoryUsage::CONNECTIONS] += treeNodeBytes(sizeof(*it)) + it->second.getMemoryUsage();
+		bytes[MemoryUsage::OUTPUT] += stringBytes(it->second.getOutput());
+	}
+	bytes[MemoryUsage::CONNECTIONS] += this->hotClients.getMemoryUsage();
+	for (std::map<std::string, int>::const_iterator it = this->sessionTokens.begin(); it != this->sessionTokens.end(); ++it)
+		bytes[MemoryUsage::CONNECTIONS] += treeNodeBytes(sizeof(*it)) + stringBytes(it->first);
+	bytes[MemoryUsage::CONNECTIONS] += this->detachedSessions.size() * treeNodeBytes(sizeof(std::pair<const int, unsigned long>));
+
+	bytes[MemoryUsage::INPUT] += allocationBytes(this->recvBuffer.capacity()) + this->scratch.getMemoryUsage();
+	for (std::map<int, std::string>::const_iterator it = this->clientBuffer.begin(); it != this->clientBuffer.end(); ++it)
+		bytes[MemoryUsage::INPUT] += treeNodeBytes(sizeof(*it)) + stringBytes(it->second);
+
+	for (std::map<int, std::deque<ReplyCursor> >::const_iterator it = this->replyCursors.begin(); it != this->replyCursors.end(); ++it){
+		bytes[MemoryUsage::OUTPUT] += treeNodeBytes(sizeof(*it)) + dequeBytes(it->second.size(), sizeof(ReplyCursor));
+		for (size_t i = 0; i < it->second.size(); i++)
+			bytes[MemoryUsage::OUTPUT] += stringBytes(it->second[i].getTarget());
+	}
+
+	for (std::map<std::string, Channel>::const_iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+		bytes[MemoryUsage::CHANNELS] += treeNodeBytes(sizeof(*it)) + stringBytes(it->first) + it->second.getMemoryUsage();
+		bytes[MemoryUsage::HISTORY] += it->second.getHistory().getHeapUsage();
+	}
+	for (std::set<std::pair<unsigned long, std::string> >::const_iterator it = this->historyOldest.begin(); it != this->historyOldest.end(); ++it)
+		bytes[MemoryUsage::HISTORY] += treeNodeBytes(sizeof(*it)) + stringBytes(it->second);
+
+	for (std::map<int, AdminConsole>::const_iterator it = this->consoles.begin(); it != this->consoles.end(); ++it)
+		bytes[MemoryUsage::SERVICES] += treeNodeBytes(sizeof(*it)) + stringBytes(it->second.input) +
+			stringBytes(it->second.output) + stringBytes(it->second.channel);
+	for (std::map<int, MetricsScrape>::const_iterator it = this->scrapes.begin(); it != this->scrapes.end(); ++it)
+		bytes[MemoryUsage::SERVICES] += treeNodeBytes(sizeof(*it)) + stringBytes(it->second.request) + stringBytes(it->second.response);
+	bytes[MemoryUsage::SERVICES] += this->capture.getMemoryUsage();
+	if (this->channelLogger.isEnabled())
+		bytes[MemoryUsage::SERVICES] += allocationBytes(LOG_QUEUE_BYTES);
+}
+
+/**
+ * @brief Measure the server every MEMORY_CHECK_MS when it has a memory
+ * budget, and shed load while it is over.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::checkMemory(unsigned long now){
+	if (this->memoryBudget == 0){
+		this->sheddingLoad = false;
+		return;
+	}
+	if (now < this->nextMemoryCheck)
+		return;
+	this->nextMemoryCheck = now + MEMORY_CHECK_MS;
+
+	MemoryUsage usage;
+	measureMemory(usage);
+	size_t total = usage.total();
+	if (total <= this->memoryBudget){
+		if (this->sheddingLoad)
+			std::cerr << "Memory back under budget (" << total << " of " << this->memoryBudget << " bytes)" << std::endl;
+		this->sheddingLoad = false;
+		return;
+	}
+	if (!this->sheddingLoad)
+		std::cerr << "\033[1;31mMemory budget exceeded (" << total << " of " << this->memoryBudget
+			<< " bytes), shedding load\033[0m" << std::endl;
+	this->sheddingLoad = true;
+
+	// History first, it is only there for convenience
+	size_t excess = total - this->memoryBudget;
+	size_t historyBefore = this->historyBytes;
+	evictHistory(this->historyBytes > excess ? this->historyBytes - excess : 0);
+	size_t freed = historyBefore - this->historyBytes;
+	if (freed >= excess)
+		return;
+	excess -= freed;
+
+	// Then whoever has the most output waiting
+	std::vector<std::pair<size_t, unsigned int> > queues;
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		std::map<int, Client>::const_iterator it = this->clientMap.find(this->clients[i].fd);
+		if (this->clients[i].fd < 0 || it == this->clientMap.end() || it->second.isServer())
+			continue;
+		if (it->second.getOutputSize() > MEMORY_SHED_SENDQ)
+			queues.push_back(std::make_pair(stringBytes(it->second.getOutput()), i));
+	}
+	std::sort(queues.rbegin(), queues.rend());
+	for (size_t i = 0; i < queues.size() && freed < excess; i++){
+		freed += queues[i].first;
+		disconnectClient(this->clients[queues[i].second], MSG_MEMORY_BUDGET);
+	}
+}
+
+/**
+ * @brief The memory figures, one "name value" line each.
+ */
+std::string	Server::memoryReport(void) const{
+	MemoryUsage usage;
+	std::ostringstream out;
+
+	measureMemory(usage);
+	usage.heapInUse = mallocInUse();
+	out << "connections " << usage.connections << "\n";
+	for (size_t i = 0; i < MemoryUsage::NUM_SUBSYSTEMS; i++)
+		out << MemoryUsage::name(static_cast<MemoryUsage::Subsystem>(i)) << "_bytes " << usage.bytes[i] << "\n";
+	out << "total_bytes " << usage.total() << "\n"
+		<< "bytes_per_connection " << usage.perConnection() << "\n"
+		<< "heap_in_use " << usage.heapInUse << "\n"
+		<< "memory_budget " << this->memoryBudget << "\n"
+		<< "shedding " << (this->sheddingLoad ? "yes" : "no") << "\n";
+	return (out.str());
+}
+
+/**
+ * @brief MEMSTATS (server operators only). Sends memoryReport() as
+ * notices.
+ * @param client The client.
+ * @author Hamad
+ */
+void	Server::memoryStats(pollfd& client){
+	Client& clientObj = this->clientMap[client.fd];
+
+	if (!clientObj.isServerOperator()){
+		sendNumericReply(client, ERR_NOPRIVILEGES, ":Permission Denied- You're not an IRC operator");
+		return;
+	}
+	std::string notice = ":" + SERVER_NAME + " " + WEECHAT_NOTICE + " " + clientObj.getNickname() + " :";
+	std::istringstream report(memoryReport());
+	std::string line;
+	std::string out;
+	while (std::getline(report, line))
+		out += notice + line + CLDR;
+	clientObj.queueOutput(out + notice + "End of MEMSTATS" + CLDR);
+}
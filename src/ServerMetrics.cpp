@@ -0,0 +1,210 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerMetrics.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/26 16:40:03 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/26 16:40:03 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Metrics page for Prometheus (metrics <address> <port> in the config).
+	The listener is polled by the event loop with the clients, in the slot
+	right after the last client slot, followed by METRICS_CONNECTIONS
+	scraper slots. A scrape is one HTTP/1.0 request: GET /metrics gets the
+	page in the OpenMetrics text format and the connection is closed once
+	it is sent. The page is built from the counters the loop keeps anyway
+	(see Metrics.hpp) and a walk over the clients and channels, nothing is
+	kept up to date for it.
+*/
+
+/**
+ * @brief Open the metrics listener in the first metrics slot.
+ * @param address The IPv4 address to listen on.
+ * @param metricsPort The port.
+ * @throw FailedToOpenMetricsException if the port can't be listened on.
+ * @author Hamad
+ */
+void	Server::openMetrics(const std::string& address, int metricsPort){
+	sockaddr_in metricsAddress;
+	int enable = 1;
+
+	std::memset(&metricsAddress, 0, sizeof(metricsAddress));
+	metricsAddress.sin_family = AF_INET;
+	metricsAddress.sin_port = htons(metricsPort);
+	metricsAddress.sin_addr.s_addr = inet_addr(address.c_str());
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (fd < 0)
+		throw (Server::FailedToOpenMetricsException());
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0 ||
+		bind(fd, (sockaddr *)&metricsAddress, sizeof(metricsAddress)) < 0 ||
+		listen(fd, METRICS_CONNECTIONS) < 0 ||
+		fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0){
+		close(fd);
+		throw (Server::FailedToOpenMetricsException());
+	}
+	this->metricsSocket = fd;
+	this->clients[this->serverCapacity].fd = fd;
+	this->clients[this->serverCapacity].events = POLLIN;
+	std::cout << "Metrics on http://" << address << ":" << metricsPort << METRICS_PATH << std::endl;
+}
+
+/**
+ * @brief Accept scrapers, read their requests and send the answers. A
+ * scraper that takes longer than METRICS_TIMEOUT_MS is dropped.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::serveMetrics(unsigned long now){
+	if (this->metricsSocket < 0)
+		return;
+	pollfd* slots = this->clients + this->serverCapacity;
+
+	if (slots[0].revents & POLLIN){
+		int fd = accept(this->metricsSocket, NULL, NULL);
+		unsigned int free = 1;
+		while (free < METRICS_SLOTS && slots[free].fd >= 0)
+			free++;
+		if (fd >= 0 && (free == METRICS_SLOTS || fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0))
+			close(fd);
+		else if (fd >= 0){
+			slots[free].fd = fd;
+			slots[free].events = POLLIN;
+			slots[free].revents = 0;
+			MetricsScrape& scrape = this->scrapes[fd];
+			scrape.sent = 0;
+			scrape.deadline = now + METRICS_TIMEOUT_MS;
+		}
+	}
+	for (unsigned int i = 1; i < METRICS_SLOTS; i++){
+		pollfd& scraper = slots[i];
+		if (scraper.fd < 0)
+			continue;
+		MetricsScrape& scrape = this->scrapes[scraper.fd];
+		if (scraper.revents & POLLIN){
+			char buffer[1024];
+			ssize_t got = recv(scraper.fd, buffer, sizeof(buffer), 0);
+			if (got <= 0 || scrape.request.size() + got > METRICS_REQUEST_BYTES){
+				closeScrape(scraper);
+				continue;
+			}
+			scrape.request.append(buffer, got);
+			if (scrape.response.empty() && scrape.request.find("\r\n\r\n") != std::string::npos){
+				answerScrape(scrape);
+				scraper.events = POLLOUT;
+			}
+		}
+		if (!scrape.response.empty()){
+			ssize_t sent = send(scraper.fd, scrape.response.data() + scrape.sent, scrape.response.size() - scrape.sent, DEFAULT_FLAG_SEND);
+			if (sent > 0)
+				scrape.sent += sent;
+			if (scrape.sent == scrape.response.size() || (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+				closeScrape(scraper);
+				continue;
+			}
+		}
+		if (now >= scrape.deadline)
+			closeScrape(scraper);
+	}
+}
+
+/**
+ * @brief Build the HTTP response to a complete request.
+ * @param scrape The scrape, its response is set.
+ */
+void	Server::answerScrape(MetricsScrape& scrape) const{
+	std::istringstream requestLine(scrape.request.substr(0, scrape.request.find("\r\n")));
+	std::string method;
+	std::string target;
+	std::string status = "200 OK";
+	std::string contentType = METRICS_CONTENT_TYPE;
+	std::string body;
+
+	requestLine >> method >> target;
+	if (method != "GET")
+		status = "405 Method Not Allowed";
+	else if (target != METRICS_PATH)
+		status = "404 Not Found";
+	if (status == "200 OK")
+		body = renderMetrics();
+	else {
+		contentType = "text/plain; charset=utf-8";
+		body = status + "\n";
+	}
+	std::ostringstream response;
+	response << "HTTP/1.0 " << status << "\r\n"
+		<< "Content-Type: " << contentType << "\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n" << body;
+	scrape.response = response.str();
+}
+
+/**
+ * @brief The metrics page, in the OpenMetrics text format.
+ */
+std::string	Server::renderMetrics(void) const{
+	std::ostringstream out;
+	size_t connections = 0;
+	size_t registered = 0;
+	size_t links = 0;
+	Histogram sendQueues(SENDQ_BUCKETS, NUM_SENDQ_BUCKETS);
+	Histogram members(MEMBER_BUCKETS, NUM_MEMBER_BUCKETS);
+
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		std::map<int, Client>::const_iterator it = this->clientMap.find(this->clients[i].fd);
+		if (this->clients[i].fd < 0 || it == this->clientMap.end())
+			continue;
+		if (it->second.isServer()){
+			links++;
+			continue;
+		}
+		connections++;
+		if (it->second.isFullyRegistered())
+			registered++;
+		sendQueues.observe(it->second.getOutputSize());
+	}
+	for (std::map<std::string, Channel>::const_iterator it = this->channels.begin(); it != this->channels.end(); ++it)
+		members.observe(it->second.getMemberCount());
+
+	Metrics::writeFamily(out, "hai_connections", "gauge", "Client connections, registered or not.");
+	out << "hai_connections " << connections << "\n";
+	Metrics::writeFamily(out, "hai_registered_clients", "gauge", "Connections that completed registration.");
+	out << "hai_registered_clients " << registered << "\n";
+	Metrics::writeFamily(out, "hai_detached_sessions", "gauge", "Users waiting to be resumed.");
+	out << "hai_detached_sessions " << this->detachedSessions.size() << "\n";
+	Metrics::writeFamily(out, "hai_remote_users", "gauge", "Users on linked servers.");
+	out << "hai_remote_users " << this->remoteUserCount << "\n";
+	Metrics::writeFamily(out, "hai_links", "gauge", "Server links.");
+	out << "hai_links " << links << "\n";
+	Metrics::writeFamily(out, "hai_channels", "gauge", "Channels.");
+	out << "hai_channels " << this->channels.size() << "\n";
+	Metrics::writeFamily(out, "hai_channel_members", "gaugehistogram", "Members per channel.");
+	members.write(out, "hai_channel_members", "", false, true);
+	Metrics::writeFamily(out, "hai_sendq_bytes", "gaugehistogram", "Output waiting per client connection.");
+	sendQueues.write(out, "hai_sendq_bytes", "", false, true);
+	MemoryUsage usage;
+	measureMemory(usage);
+	Metrics::writeFamily(out, "hai_memory_bytes", "gauge", "Heap held by subsystem, estimated from the containers.");
+	for (size_t i = 0; i < MemoryUsage::NUM_SUBSYSTEMS; i++)
+		out << "hai_memory_bytes{subsystem=\"" << MemoryUsage::name(static_cast<MemoryUsage::Subsystem>(i)) << "\"} " << usage.bytes[i] << "\n";
+	this->metrics.write(out);
+	if (this->channelLogger.isEnabled()){
+		Metrics::writeFamily(out, "hai_log_lines_written", "counter", "Lines written to the channel logs.");
+		out << "hai_log_lines_written_total " << this->channelLogger.getLinesWritten() << "\n";
+		Metrics::writeFamily(out, "hai_log_bytes_written", "counter", "Bytes written to the channel logs.");
+		out << "hai_log_bytes_written_total " << this->channelLogger.getBytesWritten() << "\n";
+		Metrics::writeFamily(out, "hai_log_lines_dropped", "counter", "Lines not logged because the log queue was full.");
+		out << "hai_log_lines_dropped_total " << this->channelLogger.getDropped() << "\n";
+	}
+	out << "# EOF\n";
+	return (out.str());
+}
+
+void	Server::closeScrape(pollfd& scraper){
+	this->scrapes.erase(scraper.fd);
+	closeClientConnection(scraper);
+}
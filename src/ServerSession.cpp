@@ -0,0 +1,203 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerSession.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/23 11:05:37 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/23 11:05:37 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Session resumption (draft/resume-0.5, session_grace in the config). A
+	client that enabled the capability gets RESUME TOKEN <token> once
+	registered. When its connection drops without a QUIT, the user stays on
+	the network under a detached id: the channels keep it as a member and
+	whatever it is sent queues up in its Client, as for a slow connection.
+	A new connection sending RESUME <token> before registering takes the
+	user back and only gets those missed lines, no JOIN, NAMES or topic.
+	A session nobody resumes within the grace period, or whose missed lines
+	outgrow its sendq, quits like a dropped client would have.
+*/
+
+/**
+ * @brief Give a registered client a token if it enabled the resume
+ * capability and has none, or take it back if it disabled it.
+ * @param clientFd The client.
+ */
+void	Server::updateSessionToken(int clientFd){
+	Client& clientObj = this->clientMap[clientFd];
+	bool wanted = this->sessionGrace > 0 && clientObj.hasCapability(CAP_RESUME);
+
+	if (wanted == !clientObj.getSessionToken().empty())
+		return;
+	if (!wanted){
+		this->sessionTokens.erase(clientObj.getSessionToken());
+		clientObj.setSessionToken("");
+		return;
+	}
+	std::string token = randomHex(SESSION_TOKEN_BYTES);
+	if (token.empty())
+		return;
+	clientObj.setSessionToken(token);
+	this->sessionTokens[token] = clientFd;
+	queueMessage(clientFd, ":" + SERVER_NAME + " " + WEECHAT_RESUME + " TOKEN " + token + CLDR);
+}
+
+/**
+ * @brief Keep the user of a dropped connection for the grace period. Its
+ * unsent output stays queued, it is part of what the user missed.
+ * @param client The connection, closed here if the user is kept.
+ * @return false if the client has no session, the caller cleans it as usual.
+ * @author Hamad
+ */
+bool	Server::detachClient(pollfd& client){
+	std::map<int, Client>::iterator it = this->clientMap.find(client.fd);
+	if (it == this->clientMap.end() || it->second.getSessionToken().empty() || !it->second.isFullyRegistered())
+		return (false);
+
+	int sessionId;
+	do {
+		sessionId = this->nextDetachedId;
+		if (this->nextDetachedId == std::numeric_limits<int>::max())
+			this->nextDetachedId = DETACHED_ID_BASE;
+		else
+			this->nextDetachedId++;
+	} while (this->clientMap.find(sessionId) != this->clientMap.end());
+
+	this->clientMap[sessionId] = HAI_MOVE(it->second);
+	this->clientMap.erase(client.fd);
+	this->hotClients.erase(client.fd);
+	moveUser(client.fd, sessionId);
+	this->sessionTokens[this->clientMap[sessionId].getSessionToken()] = sessionId;
+	this->detachedSessions[sessionId] = currentTimeMs() + this->sessionGrace;
+	this->replyCursors.erase(client.fd);
+	this->clientBuffer.erase(client.fd);
+	this->capture.closeSession(client.fd);
+	std::cout << this->clientMap[sessionId].getNickname() << " Has detached!" << std::endl;
+	closeClientConnection(client);
+	return (true);
+}
+
+/**
+ * @brief RESUME <token>. An unregistered connection takes over the session
+ * of the token, keeping its own address, class and capabilities. If the
+ * session still has a connection (one that didn't notice it was cut yet)
+ * that one is detached first.
+ * @param client The new connection.
+ * @param params The command parameters.
+ * @author Hamad
+ */
+void	Server::resumeSession(pollfd& client, const std::vector<std::string>& params){
+	std::string prefix = ":" + SERVER_NAME + " " + WEECHAT_FAIL + " " + WEECHAT_RESUME + " ";
+
+	if (this->clientMap[client.fd].isFullyRegistered()){
+		queueMessage(client.fd, prefix + "REGISTRATION_IS_COMPLETED :Cannot resume once registered" + CLDR);
+		return;
+	}
+	if (params.empty()){
+		sendNumericReply(client, ERR_NEEDMOREPARAMS, "RESUME :Not enough parameters");
+		return;
+	}
+	std::string token = params[0];
+	std::map<std::string, int>::iterator tokenIt = this->sessionTokens.find(token);
+	if (tokenIt == this->sessionTokens.end()){
+		queueMessage(client.fd, prefix + "INVALID_TOKEN :Cannot resume connection, token is not valid" + CLDR);
+		return;
+	}
+	if (this->detachedSessions.find(tokenIt->second) == this->detachedSessions.end()){
+		for (unsigned int i = 1; i < this->serverCapacity; i++){
+			if (this->clients[i].fd == tokenIt->second){
+				detachClient(this->clients[i]);
+				break;
+			}
+		}
+	}
+	int sessionId = tokenIt->second;
+	if (this->detachedSessions.find(sessionId) == this->detachedSessions.end()){
+		queueMessage(client.fd, prefix + "INVALID_TOKEN :Cannot resume connection, token is not valid" + CLDR);
+		return;
+	}
+
+	const Client& connection = this->clientMap[client.fd];
+	Client session = HAI_MOVE(this->clientMap[sessionId]);
+	session.setAddress(connection.getAddress());
+	session.setHostname(connection.getHostname());
+	session.setConnectionClass(connection.getConnectionClass());
+	session.setCapabilities(connection.getCapabilities());
+	session.setCapNegotiating(false);
+	session.markActive(currentTimeMs());
+	// What this connection was already sent goes first, the missed lines after RESUME SUCCESS
+	std::string missed = session.getOutput();
+	session.consumeOutput(missed.length());
+	session.queueOutput(connection.getOutput());
+	session.setSessionToken("");
+
+	this->clientMap[client.fd] = HAI_MOVE(session);
+	this->hotClients.refresh(client.fd);
+	this->clientMap.erase(sessionId);
+	this->hotClients.erase(sessionId);
+	this->detachedSessions.erase(sessionId);
+	this->sessionTokens.erase(tokenIt);
+	moveUser(sessionId, client.fd);
+	const std::string& nickname = this->clientMap[client.fd].getNickname();
+	std::cout << nickname << " Has resumed!" << std::endl;
+	queueMessage(client.fd, ":" + SERVER_NAME + " " + WEECHAT_RESUME + " SUCCESS " + nickname + CLDR);
+	queueMessage(client.fd, missed);
+	// A token is only good once
+	updateSessionToken(client.fd);
+}
+
+/**
+ * @brief Give a local user a new id in every channel.
+ * @param fromId Its id so far.
+ * @param toId Its new id, the user must already be in the client map under it.
+ */
+void	Server::moveUser(int fromId, int toId){
+	for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it)
+		it->second.replaceMember(fromId, toId);
+}
+
+/**
+ * @brief End the detached sessions whose grace period is over, or whose
+ * missed lines went past the sendq of their class.
+ * @param now currentTimeMs() of this iteration.
+ */
+void	Server::expireSessions(unsigned long now){
+	std::vector<std::pair<int, std::string> > expired;
+
+	for (std::map<int, unsigned long>::iterator it = this->detachedSessions.begin(); it != this->detachedSessions.end(); ++it){
+		const Client& session = this->clientMap[it->first];
+		if (session.getOutputSize() > this->connectionClasses[session.getConnectionClass()].getSendQ())
+			expired.push_back(std::make_pair(it->first, MSG_SENDQ_EXCEEDED));
+		else if (now >= it->second)
+			expired.push_back(std::make_pair(it->first, MSG_SESSION_EXPIRED));
+	}
+	for (size_t i = 0; i < expired.size(); i++)
+		endSession(expired[i].first, expired[i].second, true);
+}
+
+/**
+ * @brief Forget a detached session, telling its channels and, unless it
+ * already knows, the network.
+ * @param userId The session's id.
+ * @param reason The QUIT reason.
+ * @param announce false when the network already knows the user is gone (KILL).
+ */
+void	Server::endSession(int userId, const std::string& reason, bool announce){
+	const Client& session = this->clientMap[userId];
+	std::string quitLine = ":" + session.getNickname() + " " + WEECHAT_QUIT + " :" + reason + CLDR;
+
+	std::cout << session.getNickname() << " Has disconnected! (" << reason << ")" << std::endl;
+	if (announce)
+		propagate(quitLine, -1);
+	this->sessionTokens.erase(session.getSessionToken());
+	this->detachedSessions.erase(userId);
+	quitChannels(userId, quitLine);
+	this->clientMap.erase(userId);
+	this->hotClients.erase(userId);
+}
@@ -0,0 +1,467 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerUpgrade.cpp                                  :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/12 14:40:02 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/12 14:40:02 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	Zero downtime upgrade. On SIGUSR2 the server forks and execs its own
+	command line (the binary on disk, so a freshly built one) with the fd of
+	one end of a socketpair in UPGRADE_ENV. Over that socket it sends:
+
+		header   number of bytes of the state, number of file descriptors
+		state    StateWriter encoding, see serializeState()
+		fds      the listening socket then every client socket, in batches
+		         of UPGRADE_FDS_PER_MESSAGE with SCM_RIGHTS
+
+	The new process rebuilds everything from the state and answers with one
+	byte. Only then does the old one stop, without touching the sockets
+	again: what the clients send meanwhile waits in the kernel for the new
+	process. If anything fails before the answer the old process kills the
+	child and keeps serving.
+*/
+
+// One byte of payload carries the descriptors, a message can't be empty
+static bool	sendDescriptors(int socket, const int *fds, size_t count){
+	char				payload = 'F';
+	iovec				iov;
+	msghdr				message;
+	std::vector<char>	control(CMSG_SPACE(sizeof(int) * count), 0);
+
+	iov.iov_base = &payload;
+	iov.iov_len = 1;
+	std::memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = &control[0];
+	message.msg_controllen = control.size();
+
+	cmsghdr *header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+	std::memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+	return (sendmsg(socket, &message, 0) == 1);
+}
+
+static bool	receiveDescriptors(int socket, int *fds, size_t count){
+	char				payload;
+	iovec				iov;
+	msghdr				message;
+	std::vector<char>	control(CMSG_SPACE(sizeof(int) * count), 0);
+
+	iov.iov_base = &payload;
+	iov.iov_len = 1;
+	std::memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = &control[0];
+	message.msg_controllen = control.size();
+
+	if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != 1 || (message.msg_flags & MSG_CTRUNC))
+		return (false);
+	cmsghdr *header = CMSG_FIRSTHDR(&message);
+	if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS ||
+		header->cmsg_len != CMSG_LEN(sizeof(int) * count))
+		return (false);
+	std::memcpy(fds, CMSG_DATA(header), sizeof(int) * count);
+	return (true);
+}
+
+/**
+ * @brief Run every pending WHO/NAMES/LIST to its end, the cursors are not
+ * part of the handed over state.
+ */
+void	Server::finishReplyCursors(void){
+	for (std::map<int, std::deque<ReplyCursor> >::iterator it = this->replyCursors.begin(); it != this->replyCursors.end(); ++it){
+		Client& clientObj = this->clientMap[it->first];
+		while (!it->second.empty()){
+			std::string out;
+			unsigned int budget = std::numeric_limits<unsigned int>::max();
+			it->second.front().resume(clientObj.getNickname(), this->clientMap, this->channels, out, budget);
+			clientObj.queueOutput(out);
+			it->second.pop_front();
+		}
+	}
+	this->replyCursors.clear();
+}
+
+// The fields of a connected or detached user, output queue included
+static void	putClient(StateWriter& writer, const Client& client, const std::string& className){
+	writer.putString(client.getNickname());
+	writer.putString(client.getUsername());
+	writer.putString(client.getRealname());
+	writer.putString(client.getHostname());
+	writer.putBool(client.isPasswordAuthenticated());
+	writer.putBool(client.isNicknameSet());
+	writer.putBool(client.isUserSet());
+	writer.putBool(client.isServerOperator());
+	writer.putNumber(client.getCapabilities());
+	writer.putBool(client.isCapNegotiating());
+	writer.putString(client.getAwayMessage());
+	writer.putString(client.getSessionToken());
+	writer.putNumber(client.getAddress());
+	writer.putString(className);
+	writer.putString(client.getOutput());
+}
+
+// Read back by putClient(), the class is looked up by the caller
+static Client	getClient(StateReader& reader, std::string& className){
+	Client client;
+
+	client.setNickname(reader.getString());
+	client.setUsername(reader.getString());
+	client.setRealname(reader.getString());
+	client.setHostname(reader.getString());
+	client.setPasswordAuthenticated(reader.getBool());
+	client.setNicknameSet(reader.getBool());
+	client.setUserSet(reader.getBool());
+	client.setServerOperator(reader.getBool());
+	client.setCapabilities(static_cast<unsigned int>(reader.getNumber()));
+	client.setCapNegotiating(reader.getBool());
+	client.setAwayMessage(reader.getString());
+	client.setSessionToken(reader.getString());
+	// The silence before the handover isn't known, the keepalive starts over
+	client.markActive(currentTimeMs());
+	client.setAddress(static_cast<in_addr_t>(reader.getNumber()));
+	className = reader.getString();
+	client.queueOutput(reader.getString());
+	return (client);
+}
+
+/**
+ * @brief Encode everything a client could notice: registration, nicknames,
+ * unread input, unsent output, detached sessions, channels with their modes,
+ * topics, members, operators and invites. Flood buckets and the run queue start over.
+ * @param writer Receives the state.
+ * @param fds Receives the sockets in the order the state refers to them.
+ */
+void	Server::serializeState(StateWriter& writer, std::vector<int>& fds){
+	writer.putString(UPGRADE_MAGIC);
+	writer.putNumber(this->port);
+	writer.putString(this->password);
+	writer.putString(this->configPath);
+	writer.putBool(this->metricsSocket >= 0);
+	writer.putBool(this->adminSocket >= 0);
+
+	fds.push_back(this->serverSocket);
+	for (unsigned int i = 1; i < this->serverCapacity; i++){
+		// Links are dropped, autoconnect brings them back and the burst restores their users
+		std::map<int, Client>::iterator it = this->clientMap.find(this->clients[i].fd);
+		if (this->clients[i].fd >= 0 && it != this->clientMap.end() && !it->second.isServer())
+			fds.push_back(this->clients[i].fd);
+	}
+	writer.putNumber(fds.size() - 1);
+	for (size_t i = 1; i < fds.size(); i++){
+		int fd = fds[i];
+		const Client& client = this->clientMap[fd];
+		writer.putNumber(fd);
+		putClient(writer, client, this->connectionClasses[client.getConnectionClass()].getName());
+		writer.putString(this->clientBuffer[fd]);
+	}
+
+	// Detached sessions keep their id, with the time they have left
+	unsigned long now = currentTimeMs();
+	writer.putNumber(this->detachedSessions.size());
+	for (std::map<int, unsigned long>::iterator it = this->detachedSessions.begin(); it != this->detachedSessions.end(); ++it){
+		const Client& session = this->clientMap[it->first];
+		writer.putNumber(it->first);
+		writer.putNumber(it->second > now ? it->second - now : 0);
+		putClient(writer, session, this->connectionClasses[session.getConnectionClass()].getName());
+	}
+
+	writer.putNumber(this->channels.size());
+	for (std::map<std::string, Channel>::iterator it = this->channels.begin(); it != this->channels.end(); ++it){
+		const Channel& chan = it->second;
+		writer.putString(chan.getName());
+		writer.putString(chan.getTopic());
+		writer.putString(chan.getCreationTime());
+		writer.putBool(chan.isInviteOnly());
+		writer.putBool(chan.isTopicRestricted());
+		writer.putString(chan.getKey());
+		writer.putSigned(chan.getUserLimit());
+
+		const std::set<int>* sets[3] = {&chan.getMembers(), &chan.getOperators(), &chan.getInvitedUsers()};
+		for (int s = 0; s < 3; s++){
+			writer.putNumber(sets[s]->size());
+			for (std::set<int>::const_iterator fdIt = sets[s]->begin(); fdIt != sets[s]->end(); ++fdIt)
+				writer.putNumber(*fdIt);
+		}
+	}
+	// The metrics and admin listeners go last, scrapes and consoles are dropped
+	if (this->metricsSocket >= 0)
+		fds.push_back(this->metricsSocket);
+	if (this->adminSocket >= 0)
+		fds.push_back(this->adminSocket);
+}
+
+/**
+ * @brief Rebuild the clients and channels written by serializeState().
+ * Socket numbers differ in this process, the state's fds are mapped to the
+ * received ones by position.
+ * @param reader Positioned after the header fields.
+ * @param fds The received sockets, listening socket first.
+ * @throw StateReader::CorruptStateException if the state is truncated.
+ */
+void	Server::restoreState(StateReader& reader, const std::vector<int>& fds){
+	std::map<int, int> newFd;
+	std::map<int, std::string> classNames;
+
+	size_t clientCount = reader.getNumber();
+	if (clientCount + 1 != fds.size())
+		throw (StateReader::CorruptStateException());
+	for (size_t i = 0; i < clientCount; i++){
+		int fd = fds[i + 1];
+		newFd[static_cast<int>(reader.getNumber())] = fd;
+
+		this->clientMap[fd] = getClient(reader, classNames[fd]);
+		this->clientBuffer[fd] = reader.getString();
+		this->clients[i + 1].fd = fd;
+		this->clients[i + 1].events = POLLIN;
+		if (hasPendingCommand(fd))
+			scheduleInput(i + 1);
+	}
+
+	size_t sessionCount = reader.getNumber();
+	unsigned long now = currentTimeMs();
+	for (size_t i = 0; i < sessionCount; i++){
+		int sessionId = static_cast<int>(reader.getNumber());
+		newFd[sessionId] = sessionId;
+		this->detachedSessions[sessionId] = now + reader.getNumber();
+		this->clientMap[sessionId] = getClient(reader, classNames[sessionId]);
+		if (sessionId >= this->nextDetachedId && sessionId < std::numeric_limits<int>::max())
+			this->nextDetachedId = sessionId + 1;
+	}
+
+	// Clients keep their class by name, or fall in the first one matching their address
+	for (std::map<int, Client>::iterator it = this->clientMap.begin(); it != this->clientMap.end(); ++it){
+		const std::string& className = classNames[it->first];
+		int classIndex = -1;
+		for (size_t c = 0; c < this->connectionClasses.size() && classIndex < 0; c++){
+			if (this->connectionClasses[c].getName() == className)
+				classIndex = static_cast<int>(c);
+		}
+		if (classIndex < 0)
+			classIndex = findConnectionClass(it->second.getAddress(), "");
+		it->second.setConnectionClass(classIndex < 0 ? 0 : classIndex);
+		if (!it->second.getSessionToken().empty())
+			this->sessionTokens[it->second.getSessionToken()] = it->first;
+	}
+
+	size_t channelCount = reader.getNumber();
+	for (size_t i = 0; i < channelCount; i++){
+		std::string name = reader.getString();
+		Channel chan(name);
+		chan.setTopic(reader.getString());
+		chan.setCreationTime(reader.getString());
+		chan.setInviteOnly(reader.getBool());
+		chan.setTopicRestricted(reader.getBool());
+		chan.setKey(reader.getString());
+		chan.setUserLimit(static_cast<int>(reader.getSigned()));
+
+		// Members first, addOperator() only accepts members
+		for (int s = 0; s < 3; s++){
+			size_t count = reader.getNumber();
+			for (size_t m = 0; m < count; m++){
+				std::map<int, int>::iterator it = newFd.find(static_cast<int>(reader.getNumber()));
+				if (it == newFd.end())
+					continue;
+				if (s == 0)
+					chan.addMember(it->second);
+				else if (s == 1)
+					chan.addOperator(it->second);
+				else
+					chan.inviteUser(it->second);
+			}
+		}
+		this->channels[name] = HAI_MOVE(chan);
+	}
+}
+
+/**
+ * @brief Hand the sockets and the state over to a new exec of the binary.
+ * @return true once the new process took over and this one must stop,
+ * false if the upgrade failed and this process keeps serving.
+ * @author Hamad
+ */
+bool	Server::upgrade(void){
+	this->upgradeRequested = 0;
+	if (this->programPath.empty())
+		return (false);
+
+	int pair[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0){
+		std::cerr << "Upgrade: socketpair failed: " << std::strerror(errno) << std::endl;
+		return (false);
+	}
+	fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+	// The new process loads the channel store, it must find every change on disk
+	this->channelStore.sync();
+	timeval timeout;
+	timeout.tv_sec = UPGRADE_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(pair[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(pair[0], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	/*
+		The child only calls execve(): a writer thread may hold the
+		allocator lock at fork time, so everything is built beforehand.
+	*/
+	std::ostringstream oss;
+	oss << UPGRADE_ENV << "=" << pair[1];
+	std::string upgradeVariable = oss.str();
+	std::vector<char *> argv;
+	for (size_t i = 0; i < this->programArguments.size(); i++)
+		argv.push_back(const_cast<char *>(this->programArguments[i].c_str()));
+	argv.push_back(NULL);
+	std::vector<char *> envp;
+	for (char **variable = environ; *variable; variable++){
+		if (std::strncmp(*variable, (UPGRADE_ENV + "=").c_str(), UPGRADE_ENV.length() + 1) != 0)
+			envp.push_back(*variable);
+	}
+	envp.push_back(const_cast<char *>(upgradeVariable.c_str()));
+	envp.push_back(NULL);
+
+	pid_t pid = fork();
+	if (pid < 0){
+		std::cerr << "Upgrade: fork failed: " << std::strerror(errno) << std::endl;
+		close(pair[0]);
+		close(pair[1]);
+		return (false);
+	}
+	if (pid == 0){
+		execve(this->programPath.c_str(), &argv[0], &envp[0]);
+		_exit(127);
+	}
+	close(pair[1]);
+
+	finishReplyCursors();
+	finishFanout();
+	StateWriter state;
+	std::vector<int> fds;
+	serializeState(state, fds);
+
+	StateWriter header;
+	header.putNumber(state.getData().size());
+	header.putNumber(fds.size());
+	bool handedOver = writeAll(pair[0], header.getData().data(), header.getData().size()) &&
+		writeAll(pair[0], state.getData().data(), state.getData().size());
+	for (size_t sent = 0; handedOver && sent < fds.size(); sent += UPGRADE_FDS_PER_MESSAGE)
+		handedOver = sendDescriptors(pair[0], &fds[sent], std::min(UPGRADE_FDS_PER_MESSAGE, fds.size() - sent));
+	char answer = 0;
+	handedOver = handedOver && readAll(pair[0], &answer, 1) && answer == 'K';
+	close(pair[0]);
+
+	if (!handedOver){
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+		std::cerr << "\033[1;31mUpgrade failed, still serving\033[0m" << std::endl;
+		return (false);
+	}
+	std::cout << "\033[1;32mHanded over to process " << pid << "\033[0m" << std::endl;
+	// The new process serves the admin socket now, it must not be removed on exit
+	this->adminPath.clear();
+	this->isRunning = false;
+	return (true);
+}
+
+/**
+ * @brief Take over from the process that exec'd this one (see upgrade()).
+ * The config file of the previous process is read again, so an upgrade
+ * also picks up config changes.
+ * @param upgradeSocket The socket from UPGRADE_ENV, closed on return.
+ * @throw FailedToUpgradeException if the handover fails, the previous
+ * process then keeps serving.
+ * @author Hamad
+ */
+Server::Server(int upgradeSocket) : hotClients(clientMap) {
+	this->clients = NULL;
+	this->serverSocket = -1;
+	this->pollManager = -1;
+	this->serverCapacity = 0;
+
+	char headerData[16];
+	if (!readAll(upgradeSocket, headerData, sizeof(headerData))){
+		close(upgradeSocket);
+		throw (Server::FailedToUpgradeException());
+	}
+	StateReader header(headerData, sizeof(headerData));
+	std::vector<char> stateData(header.getNumber() + 1);
+	std::vector<int> fds(header.getNumber());
+	bool received = !fds.empty() && readAll(upgradeSocket, &stateData[0], stateData.size() - 1);
+	for (size_t got = 0; received && got < fds.size(); got += UPGRADE_FDS_PER_MESSAGE)
+		received = receiveDescriptors(upgradeSocket, &fds[got], std::min(UPGRADE_FDS_PER_MESSAGE, fds.size() - got));
+	if (!received){
+		close(upgradeSocket);
+		throw (Server::FailedToUpgradeException());
+	}
+
+	try {
+		StateReader reader(&stateData[0], stateData.size() - 1);
+		if (reader.getString() != UPGRADE_MAGIC)
+			throw (StateReader::CorruptStateException());
+		this->port = static_cast<int>(reader.getNumber());
+		this->password = reader.getString();
+		std::string path = reader.getString();
+		bool hasMetrics = reader.getBool();
+		bool hasAdmin = reader.getBool();
+		int adminListener = -1;
+		int metricsListener = -1;
+		if (hasAdmin){
+			adminListener = fds.back();
+			fds.pop_back();
+		}
+		if (hasMetrics){
+			metricsListener = fds.back();
+			fds.pop_back();
+		}
+
+		Config config;
+		if (!path.empty())
+			config.load(path);
+		loadSettings(config);
+		this->serverSocket = fds[0];
+		socklen_t addressLength = sizeof(this->serverAddress);
+		getsockname(this->serverSocket, (sockaddr *)&this->serverAddress, &addressLength);
+		this->listenAddress = inet_ntoa(this->serverAddress.sin_addr);
+		// Everybody comes back, even if the new config allows fewer clients
+		if (fds.size() > this->serverCapacity)
+			this->serverCapacity = fds.size();
+		initializeState(config);
+		if (metricsListener >= 0){
+			this->metricsSocket = metricsListener;
+			this->clients[this->serverCapacity].fd = metricsListener;
+			this->clients[this->serverCapacity].events = POLLIN;
+		}
+		if (adminListener >= 0){
+			sockaddr_un adminAddress;
+			socklen_t adminLength = sizeof(adminAddress);
+			std::memset(&adminAddress, 0, sizeof(adminAddress));
+			getsockname(adminListener, (sockaddr *)&adminAddress, &adminLength);
+			this->adminSocket = adminListener;
+			this->adminPath = adminAddress.sun_path;
+			this->clients[this->serverCapacity + METRICS_SLOTS].fd = adminListener;
+			this->clients[this->serverCapacity + METRICS_SLOTS].events = POLLIN;
+		}
+		restoreState(reader, fds);
+	} catch (std::exception& err){
+		std::cerr << "\033[1;31m" << err.what() << "\033[0m" << std::endl;
+		close(upgradeSocket);
+		throw (Server::FailedToUpgradeException());
+	}
+	if (!writeAll(upgradeSocket, "K", 1)){
+		close(upgradeSocket);
+		throw (Server::FailedToUpgradeException());
+	}
+	close(upgradeSocket);
+	std::cout << "\033[1;32mTook over " << this->clientMap.size() << " clients and "
+		<< this->channels.size() << " channels\033[0m" << std::endl;
+}
@@ -0,0 +1,156 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   StateStream.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/12 14:40:02 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/12 14:40:02 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/StateStream.hpp"
+#include "../includes/Constants.hpp"
+
+StateWriter::StateWriter() : data("") {}
+
+StateWriter::StateWriter(const StateWriter& right) : data(right.data) {}
+
+StateWriter& StateWriter::operator=(const StateWriter& right) {
+	if (this != &right)
+		this->data = right.data;
+	return (*this);
+}
+
+StateWriter::~StateWriter() {}
+
+void	StateWriter::putNumber(unsigned long value) {
+	char bytes[8];
+	for (int i = 7; i >= 0; i--) {
+		bytes[i] = static_cast<char>(value & 0xFF);
+		value >>= 8;
+	}
+	this->data.append(bytes, 8);
+}
+
+void	StateWriter::putSigned(long value) {
+	putNumber(static_cast<unsigned long>(value));
+}
+
+void	StateWriter::putBool(bool value) {
+	putNumber(value ? 1 : 0);
+}
+
+void	StateWriter::putString(const std::string& value) {
+	putNumber(value.length());
+	this->data += value;
+}
+
+void	StateWriter::putCompact(unsigned long value) {
+	while (value >= 0x80) {
+		this->data += static_cast<char>((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	this->data += static_cast<char>(value);
+}
+
+void	StateWriter::putCompactString(const std::string& value) {
+	putCompact(value.length());
+	this->data += value;
+}
+
+const std::string&	StateWriter::getData(void) const {return (this->data);}
+void				StateWriter::clear(void) {this->data.clear();}
+
+StateReader::StateReader(const char *data, size_t length) : data(data), length(length), position(0) {}
+
+StateReader::StateReader(const StateReader& right) {
+	*this = right;
+}
+
+StateReader& StateReader::operator=(const StateReader& right) {
+	if (this != &right) {
+		this->data = right.data;
+		this->length = right.length;
+		this->position = right.position;
+	}
+	return (*this);
+}
+
+StateReader::~StateReader() {}
+
+/**
+ * @brief Read the next number.
+ * @throw CorruptStateException if the data ends in the middle of it.
+ */
+unsigned long	StateReader::getNumber(void) {
+	if (this->length - this->position < 8)
+		throw (StateReader::CorruptStateException());
+	unsigned long value = 0;
+	for (int i = 0; i < 8; i++)
+		value = (value << 8) | static_cast<unsigned char>(this->data[this->position + i]);
+	this->position += 8;
+	return (value);
+}
+
+long	StateReader::getSigned(void) {
+	return (static_cast<long>(getNumber()));
+}
+
+bool	StateReader::getBool(void) {
+	return (getNumber() != 0);
+}
+
+/**
+ * @brief Read the next string.
+ * @throw CorruptStateException if the data ends in the middle of it.
+ */
+std::string	StateReader::getString(void) {
+	unsigned long stringLength = getNumber();
+	if (stringLength > this->length - this->position)
+		throw (StateReader::CorruptStateException());
+	std::string value(this->data + this->position, stringLength);
+	this->position += stringLength;
+	return (value);
+}
+
+/**
+ * @brief Read the next compact number.
+ * @throw CorruptStateException if the data ends in the middle of it or it
+ * doesn't fit an unsigned long.
+ */
+unsigned long	StateReader::getCompact(void) {
+	unsigned long	value = 0;
+	unsigned int	shift = 0;
+
+	while (true) {
+		if (this->position >= this->length || shift >= 64)
+			throw (StateReader::CorruptStateException());
+		unsigned char byte = static_cast<unsigned char>(this->data[this->position++]);
+		value |= static_cast<unsigned long>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return (value);
+		shift += 7;
+	}
+}
+
+/**
+ * @brief Read the next compact string.
+ * @throw CorruptStateException if the data ends in the middle of it.
+ */
+std::string	StateReader::getCompactString(void) {
+	unsigned long stringLength = getCompact();
+	if (stringLength > this->length - this->position)
+		throw (StateReader::CorruptStateException());
+	std::string value(this->data + this->position, stringLength);
+	this->position += stringLength;
+	return (value);
+}
+
+bool	StateReader::atEnd(void) const {return (this->position >= this->length);}
+size_t	StateReader::getPosition(void) const {return (this->position);}
+
+const char* StateReader::CorruptStateException::what() const throw() {
+	return (STATE_CORRUPT.c_str());
+}
@@ -0,0 +1,109 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TaggedLine.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/21 14:22:09 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/21 14:22:09 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/TaggedLine.hpp"
+
+TaggedLine::TaggedLine(const std::string& line, unsigned long time, unsigned long msgid) :
+line(line),
+clientTags(""),
+time(time),
+msgid(msgid),
+tagsOnly(false)
+{
+	for (size_t i = 0; i < TAG_VARIANTS; i++)
+		this->rendered[i] = false;
+}
+
+TaggedLine::TaggedLine(const TaggedLine& right) {
+	*this = right;
+}
+
+TaggedLine& TaggedLine::operator=(const TaggedLine& right) {
+	if (this != &right) {
+		this->line = right.line;
+		this->clientTags = right.clientTags;
+		this->time = right.time;
+		this->msgid = right.msgid;
+		this->tagsOnly = right.tagsOnly;
+		for (size_t i = 0; i < TAG_VARIANTS; i++) {
+			this->variants[i] = right.variants[i];
+			this->rendered[i] = right.rendered[i];
+		}
+	}
+	return (*this);
+}
+
+TaggedLine::~TaggedLine() {}
+
+void				TaggedLine::setClientTags(const std::string& tags) {this->clientTags = tags;}
+void				TaggedLine::setTagsOnly(bool value) {this->tagsOnly = value;}
+const std::string&	TaggedLine::getLine(void) const {return (this->line);}
+
+// Heap bytes of the line, the tags and the variants rendered so far
+size_t	TaggedLine::getMemoryUsage(void) const {
+	size_t bytes = stringBytes(this->line) + stringBytes(this->clientTags);
+
+	for (size_t i = 0; i < TAG_VARIANTS; i++)
+		bytes += stringBytes(this->variants[i]);
+	return (bytes);
+}
+
+/**
+ * @brief The line as a client with these capabilities gets it, rendered
+ * once per variant.
+ * @param capabilities The CAP_* bits of the recipient.
+ * @return The line with its tags, empty if this client gets nothing.
+ */
+const std::string&	TaggedLine::render(unsigned int capabilities) {
+	bool messageTags = (capabilities & CAP_MESSAGE_TAGS) != 0;
+	bool serverTime = (capabilities & CAP_SERVER_TIME) != 0;
+	size_t variant = (messageTags ? 1 : 0) | (serverTime ? 2 : 0);
+
+	if (this->rendered[variant])
+		return (this->variants[variant]);
+	this->rendered[variant] = true;
+	if (this->tagsOnly && !messageTags)
+		return (this->variants[variant]);
+
+	std::ostringstream tags;
+	if (serverTime)
+		tags << "time=" << formatServerTime(this->time);
+	if (messageTags) {
+		tags << (serverTime ? ";" : "") << "msgid=" << this->msgid;
+		if (!this->clientTags.empty())
+			tags << ";" << this->clientTags;
+	}
+	if (tags.str().empty())
+		this->variants[variant] = this->line;
+	else
+		this->variants[variant] = "@" + tags.str() + " " + this->line;
+	return (this->variants[variant]);
+}
+
+/**
+ * @brief The client only tags (+name[=value]) of a message's tags, the only
+ * ones relayed from one client to others.
+ * @param tags The tags as received, without the '@'.
+ */
+std::string	TaggedLine::clientOnlyTags(const std::string& tags) {
+	std::vector<std::string> list = splitList(tags, ';');
+	std::string kept;
+
+	for (size_t i = 0; i < list.size(); i++) {
+		if (list[i].length() < 2 || list[i][0] != '+')
+			continue;
+		if (!kept.empty())
+			kept += ";";
+		kept += list[i];
+	}
+	return (kept);
+}
@@ -0,0 +1,219 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   TrafficCapture.cpp                                 :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/29 09:41:07 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/29 09:41:07 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/TrafficCapture.hpp"
+
+TrafficCapture::TrafficCapture() :
+path(""),
+fd(-1),
+pending(),
+lastRecord(0),
+lastWrite(0),
+nextSession(1),
+records(0),
+bytesWritten(0),
+sessions()
+{}
+
+TrafficCapture::~TrafficCapture() {
+	stop();
+}
+
+bool				TrafficCapture::isEnabled(void) const {return (this->fd >= 0);}
+const std::string&	TrafficCapture::getPath(void) const {return (this->path);}
+unsigned long		TrafficCapture::getSessionCount(void) const {return (this->nextSession - 1);}
+unsigned long		TrafficCapture::getRecords(void) const {return (this->records);}
+unsigned long		TrafficCapture::getBytesWritten(void) const {return (this->bytesWritten);}
+
+size_t	TrafficCapture::getMemoryUsage(void) const {
+	return (stringBytes(this->pending.getData()) + stringBytes(this->path) +
+		this->sessions.size() * treeNodeBytes(sizeof(std::pair<const int, unsigned long>)));
+}
+
+/**
+ * @brief Start capturing to file, replacing it. A running capture is
+ * stopped first.
+ * @throw TrafficCaptureException if the file can't be created.
+ */
+void	TrafficCapture::start(const std::string& file) {
+	stop();
+	// The lines are what the users said, only the owner may read them
+	int captureFd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (captureFd < 0)
+		throw (TrafficCapture::TrafficCaptureException("Cannot open " + file + ": " + std::strerror(errno)));
+	this->fd = captureFd;
+	this->path = file;
+	this->nextSession = 1;
+	this->records = 0;
+	this->bytesWritten = 0;
+	this->lastRecord = currentTimeMs();
+	this->lastWrite = this->lastRecord;
+	this->pending.clear();
+	this->pending.putString(CAPTURE_MAGIC);
+	this->pending.putNumber(wallTimeMs());
+}
+
+/**
+ * @brief Write what is buffered and close the file. The sessions still
+ * open have no CLOSE record, a replay closes them at the end.
+ */
+void	TrafficCapture::stop(void) {
+	if (this->fd < 0)
+		return;
+	commit(this->lastWrite + CAPTURE_FLUSH_MS);
+	if (this->fd >= 0)
+		close(this->fd);
+	this->fd = -1;
+	this->sessions.clear();
+	this->pending.clear();
+}
+
+void	TrafficCapture::putRecord(Kind kind, unsigned long session) {
+	unsigned long now = currentTimeMs();
+
+	this->pending.putCompact(kind);
+	this->pending.putCompact(session);
+	this->pending.putCompact(now - this->lastRecord);
+	this->lastRecord = now;
+	this->records++;
+}
+
+/**
+ * @brief Follow a new connection.
+ * @param clientFd Its fd.
+ * @param address Its IPv4 address, host byte order.
+ */
+void	TrafficCapture::openSession(int clientFd, in_addr_t address) {
+	if (this->fd < 0)
+		return;
+	unsigned long session = this->nextSession++;
+	this->sessions[clientFd] = session;
+	putRecord(OPEN, session);
+	this->pending.putCompact(address);
+}
+
+/**
+ * @brief Record a line of a followed connection, others are ignored.
+ * @param clientFd The connection.
+ * @param line The line, without its CRLF.
+ */
+void	TrafficCapture::recordLine(int clientFd, const std::string& line) {
+	std::map<int, unsigned long>::const_iterator it = this->sessions.find(clientFd);
+	if (it == this->sessions.end())
+		return;
+	putRecord(LINE, it->second);
+	this->pending.putCompactString(redact(line));
+}
+
+void	TrafficCapture::closeSession(int clientFd) {
+	std::map<int, unsigned long>::iterator it = this->sessions.find(clientFd);
+	if (it == this->sessions.end())
+		return;
+	putRecord(CLOSE, it->second);
+	this->sessions.erase(it);
+}
+
+/**
+ * @brief Write the buffered records if there are enough of them or the
+ * last write is CAPTURE_FLUSH_MS old. The capture stops if the write
+ * fails (e.g. the disk is full).
+ * @param nowMs currentTimeMs() of this iteration.
+ */
+void	TrafficCapture::commit(unsigned long nowMs) {
+	const std::string& data = this->pending.getData();
+
+	if (this->fd < 0 || data.empty())
+		return;
+	if (data.size() < CAPTURE_FLUSH_BYTES && nowMs - this->lastWrite < CAPTURE_FLUSH_MS)
+		return;
+	this->lastWrite = nowMs;
+	if (!writeAll(this->fd, data.data(), data.size())){
+		std::cerr << "\033[1;31mCapture to " << this->path << " stopped: " << std::strerror(errno) << "\033[0m" << std::endl;
+		close(this->fd);
+		this->fd = -1;
+		this->sessions.clear();
+		this->pending.clear();
+		return;
+	}
+	this->bytesWritten += data.size();
+	this->pending.clear();
+}
+
+/**
+ * @brief The line with the credentials it carries replaced by "*".
+ */
+std::string	TrafficCapture::redact(const std::string& line) {
+	size_t start = 0;
+
+	// Tags and source come before the command
+	while (start < line.length() && (line[start] == '@' || line[start] == ':')){
+		start = line.find(' ', start);
+		if (start == std::string::npos)
+			return (line);
+		start = line.find_first_not_of(' ', start);
+		if (start == std::string::npos)
+			return (line);
+	}
+	size_t end = line.find(' ', start);
+	if (end == std::string::npos)
+		return (line);
+	std::string command = line.substr(start, end - start);
+	for (size_t i = 0; i < command.length(); i++)
+		command[i] = std::toupper(command[i]);
+	if (command == WEECHAT_PASS || command == "RESUME")
+		return (line.substr(0, end) + " *");
+	if (command == WEECHAT_OPER){
+		size_t name = line.find_first_not_of(' ', end);
+		size_t nameEnd = name == std::string::npos ? std::string::npos : line.find(' ', name);
+		if (nameEnd != std::string::npos)
+			return (line.substr(0, nameEnd) + " *");
+	}
+	return (line);
+}
+
+/**
+ * @brief Check the header of a capture file.
+ * @return The wall clock time the capture started at, in ms.
+ * @throw CorruptStateException if this is not a capture file.
+ */
+unsigned long	TrafficCapture::readHeader(StateReader& reader) {
+	if (reader.getString() != CAPTURE_MAGIC)
+		throw (StateReader::CorruptStateException());
+	return (reader.getNumber());
+}
+
+/**
+ * @brief Decode the next record. event.time is advanced by its delay, it
+ * must hold the time of the previous record (0 for the first one).
+ * @throw CorruptStateException if the record is cut or of an unknown kind.
+ */
+void	TrafficCapture::next(StateReader& reader, Event& event) {
+	unsigned long kind = reader.getCompact();
+
+	if (kind < OPEN || kind > CLOSE)
+		throw (StateReader::CorruptStateException());
+	event.kind = static_cast<Kind>(kind);
+	event.session = reader.getCompact();
+	event.time += reader.getCompact();
+	event.line.clear();
+	if (event.kind == OPEN)
+		event.address = static_cast<in_addr_t>(reader.getCompact());
+	else if (event.kind == LINE)
+		event.line = reader.getCompactString();
+}
+
+TrafficCapture::TrafficCaptureException::TrafficCaptureException(const std::string& message) : message(message) {}
+TrafficCapture::TrafficCaptureException::~TrafficCaptureException() throw() {}
+
+const char* TrafficCapture::TrafficCaptureException::what() const throw() {
+	return (this->message.c_str());
+}
@@ -63,18 +63,200 @@ void	channelSendMessage(int clientFd, const std::string& message){
  * @brief This function will recieve the data from the client via recv().
  * 
  * @param client The client that wants to send data.
+ * @param buffer Scratch space reused across calls, its size (buffer_size in the
+ * config file) is the most that is read at once.
  * @return The message that the client has sent, or empty string on error/disconnect.
  * @author Hamad
  */
-std::string	recieveData(pollfd& client){
-	char	buffer[BUFFER_SIZE];
-	std::memset(buffer, 0, BUFFER_SIZE);
-	ssize_t	recievedBytes = recv(client.fd, buffer, BUFFER_SIZE - 1, DEFAULT_FLAG_SEND);
+std::string	recieveData(pollfd& client, std::vector<char>& buffer){
+	ssize_t	recievedBytes = recv(client.fd, &buffer[0], buffer.size(), DEFAULT_FLAG_SEND);
 	
 	// recv returns 0 when client disconnects, negative on error
 	if (recievedBytes <= 0)
 		return (std::string(""));
 	
-	buffer[recievedBytes] = '\0';
+	return (std::string(&buffer[0], recievedBytes));
+}
+
+/**
+ * @brief Split a comma separated parameter (e.g. "#a,#b,bob") into its items.
+ * @param list The parameter to split.
+ * @param delimiter The separator, ',' for IRC target and key lists.
+ * @param keepEmpty Keep the empty items, for lists matched by position
+ * (JOIN keys, where an empty one means no key).
+ * @return The items in their original order, the empty ones dropped
+ * unless keepEmpty is set.
+ */
+std::vector<std::string>	splitList(const std::string& list, char delimiter, bool keepEmpty){
+	std::vector<std::string>	items;
+	size_t						start = 0;
+
+	while (start <= list.length()){
+		size_t end = list.find(delimiter, start);
+		if (end == std::string::npos)
+			end = list.length();
+		if (end > start || keepEmpty)
+			items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return (items);
+}
+
+/**
+ * @brief Monotonic clock in milliseconds, unaffected by changes of the wall
+ * clock. Used for flood control and timers.
+ */
+unsigned long	currentTimeMs(void){
+	timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (static_cast<unsigned long>(now.tv_sec) * 1000 + static_cast<unsigned long>(now.tv_nsec) / 1000000);
+}
+
+// Monotonic clock in microseconds, for durations
+unsigned long	currentTimeUs(void){
+	timespec	now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (static_cast<unsigned long>(now.tv_sec) * 1000000 + static_cast<unsigned long>(now.tv_nsec) / 1000);
+}
+
+/**
+ * @brief Wall clock in milliseconds since the epoch, for message times shown
+ * to clients.
+ */
+unsigned long	wallTimeMs(void){
+	timespec	now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (static_cast<unsigned long>(now.tv_sec) * 1000 + static_cast<unsigned long>(now.tv_nsec) / 1000000);
+}
+
+/**
+ * @brief IRCv3 server-time format, e.g. 2025-12-18T10:12:05.123Z (UTC).
+ */
+std::string	formatServerTime(unsigned long ms){
+	time_t	seconds = static_cast<time_t>(ms / 1000);
+	tm		utc;
+	char	buffer[32];
+
+	gmtime_r(&seconds, &utc);
+	size_t length = strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+	snprintf(buffer + length, sizeof(buffer) - length, ".%03luZ", ms % 1000);
 	return (std::string(buffer));
 }
+
+/**
+ * @brief Parse a server-time timestamp (fraction of a second optional).
+ * The fraction is read as a decimal, ".5" is 500 ms, digits past the
+ * millisecond are ignored.
+ * @param text The timestamp.
+ * @param ms Receives the time in ms since the epoch.
+ * @return false if text is not a valid timestamp.
+ */
+bool	parseServerTime(const std::string& text, unsigned long& ms){
+	int		year, month, day, hour, minute, second, millis = 0;
+	int		length = 0;
+
+	if (std::sscanf(text.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &length) != 6
+		|| length == 0)
+		return (false);
+	size_t position = length;
+	if (position < text.length() && text[position] == '.'){
+		size_t digits = 0;
+		for (position++; position < text.length() && text[position] >= '0' && text[position] <= '9'; position++, digits++){
+			if (digits < 3)
+				millis = millis * 10 + (text[position] - '0');
+		}
+		if (digits == 0)
+			return (false);
+		for (; digits < 3; digits++)
+			millis *= 10;
+	}
+	if (position + 1 != text.length() || text[position] != 'Z' || year < 1970 || month < 1 || month > 12 || day < 1 || day > 31
+		|| hour > 23 || minute > 59 || second > 60)
+		return (false);
+	// Days since the epoch of a proleptic Gregorian date (year starting in March)
+	long y = (month <= 2) ? year - 1 : year;
+	long era = y / 400;
+	long yearOfEra = y - era * 400;
+	long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	long days = era * 146097 + dayOfEra - 719468;
+	ms = ((static_cast<unsigned long>(days) * 24 + hour) * 60 + minute) * 60 + second;
+	ms = ms * 1000 + millis;
+	return (true);
+}
+
+/**
+ * @brief write() all of data to a blocking fd, retrying after signals.
+ * @return false on error or if the other end is gone.
+ */
+bool	writeAll(int fd, const char *data, size_t length){
+	while (length > 0){
+		ssize_t written = write(fd, data, length);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return (false);
+		data += written;
+		length -= written;
+	}
+	return (true);
+}
+
+/**
+ * @brief read() exactly length bytes from a blocking fd.
+ * @return false on error or end of file before length bytes.
+ */
+bool	readAll(int fd, char *data, size_t length){
+	while (length > 0){
+		ssize_t got = read(fd, data, length);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return (false);
+		data += got;
+		length -= got;
+	}
+	return (true);
+}
+
+/**
+ * @brief Random bytes from /dev/urandom, in hexadecimal.
+ * @param bytes How many bytes, the string is twice as long.
+ * @return The string, empty if /dev/urandom can't be read.
+ */
+std::string	randomHex(size_t bytes){
+	std::vector<char>	random(bytes);
+	const char			*digits = "0123456789abcdef";
+	std::string			hex;
+
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return ("");
+	bool complete = readAll(fd, &random[0], bytes);
+	close(fd);
+	if (!complete)
+		return ("");
+	for (size_t i = 0; i < bytes; i++){
+		unsigned char byte = static_cast<unsigned char>(random[i]);
+		hex += digits[byte >> 4];
+		hex += digits[byte & 15];
+	}
+	return (hex);
+}
+
+// Names of the CAP_* bits set, space separated
+std::string	capabilityList(unsigned int capabilities){
+	std::string list;
+
+	for (unsigned int i = 0; i < NUM_CAPABILITIES; i++){
+		if (!(capabilities & (1u << i)))
+			continue;
+		if (!list.empty())
+			list += " ";
+		list += CAPABILITY_NAMES[i];
+	}
+	return (list);
+}
@@ -27,9 +27,29 @@ void signalHandler(int signal) {
     }
 }
 
+/**
+ * @brief Signal handler for SIGHUP, reloads the config file without
+ * dropping connections.
+ */
+void reloadHandler(int signal) {
+    (void)signal;
+    if (g_serverInstance)
+        g_serverInstance->requestReload();
+}
+
+/**
+ * @brief Signal handler for SIGUSR2, hands the connections over to a new
+ * exec of the binary (zero downtime upgrade).
+ */
+void upgradeHandler(int signal) {
+    (void)signal;
+    if (g_serverInstance)
+        g_serverInstance->requestUpgrade();
+}
+
 int main(int ac, char **av){
-    if (ac != 3){
-        std::cerr << "Input must be: ./ircserv [port] [password]" << std::endl;
+    if (ac != 3 && ac != 4){
+        std::cerr << "Input must be: ./ircserv [port] [password] (config file)" << std::endl;
         return (2);
     }
     Server *HAIServer = NULL;
@@ -45,7 +65,19 @@ int main(int ac, char **av){
         int port = 0;
         std::stringstream(av[1]) >> port;
         std::string password(av[2]);
-        HAIServer = new Server(port, password);
+        const char *upgradeSocket = std::getenv(UPGRADE_ENV.c_str());
+        if (upgradeSocket){
+            // Exec'd by a running server (SIGUSR2), take over its sockets
+            int fd = std::atoi(upgradeSocket);
+            unsetenv(UPGRADE_ENV.c_str());
+            HAIServer = new Server(fd);
+        } else {
+            Config config;
+            if (ac == 4)
+                config.load(av[3]);
+            HAIServer = new Server(port, password, config);
+        }
+        HAIServer->setProgramArguments(av);
     } catch (std::exception& err){
         std::cerr << "\033[1;31m" << err.what() << "\033[0m" << std::endl;
         delete (HAIServer);
@@ -58,6 +90,8 @@ int main(int ac, char **av){
     signal(SIGINT, signalHandler);   // Handle Ctrl+C
     signal(SIGTERM, signalHandler);  // Handle termination signal
     signal(SIGPIPE, SIG_IGN);        // Ignore broken pipe (client disconnect)
+    signal(SIGHUP, reloadHandler);   // Reload the config file
+    signal(SIGUSR2, upgradeHandler); // Hand over to the binary on disk
     
     std::cout << SERVER_START_AND_ACCEPT << std::endl;
     try{
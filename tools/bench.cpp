@@ -0,0 +1,251 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/28 10:02:51 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/28 10:02:51 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/Server.hpp"
+
+/*
+	ircbench (make bench): scripted IRC sessions against a Server in this
+	process, over socketpairs (see src/ServerLocal.cpp). No TCP stack, no
+	scheduler between two processes: the loop only runs when the bench
+	calls runIteration(), so a run does the same work every time and the
+	numbers can be compared from one commit to the next.
+
+		./ircbench [clients] [rounds] [config]
+
+	Every scenario gives each client a script, ending with a PING the
+	client waits the PONG of, then lets the server run until nothing moves.
+	"server us/cmd" is the time spent in runIteration() divided by the
+	commands of the scenario, the bench's own reads and writes excluded.
+*/
+
+static const std::string BENCH_MARKER("hai-bench-done");
+static const std::string BENCH_PASSWORD("bench");
+
+/**
+ * @brief The bench's end of a connection: its script still to write and
+ * the partial line it is reading.
+ */
+struct BenchClient {
+	int			fd;
+	std::string	pending;
+	std::string	partial;
+	bool		done;
+};
+
+struct BenchResult {
+	unsigned long	commands;
+	unsigned long	linesRead;
+	unsigned long	serverUs;
+	unsigned long	iterations;
+};
+
+/**
+ * @brief Write what the socket takes of every script, read everything
+ * waiting. A client is done when its marker PONG came back.
+ * @return Bytes read.
+ */
+static size_t	exchange(std::vector<BenchClient>& clients, BenchResult& result){
+	char	buffer[65536];
+	size_t	got = 0;
+
+	for (size_t i = 0; i < clients.size(); i++){
+		BenchClient& client = clients[i];
+		if (!client.pending.empty()){
+			ssize_t sent = send(client.fd, client.pending.data(), client.pending.length(), MSG_DONTWAIT);
+			if (sent > 0)
+				client.pending.erase(0, sent);
+		}
+		ssize_t length;
+		while ((length = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0){
+			got += length;
+			client.partial.append(buffer, length);
+		}
+		size_t start = 0;
+		size_t end;
+		while ((end = client.partial.find('\n', start)) != std::string::npos){
+			// The marker ends the line, before its \r: a shorter line can't hold it
+			if (end >= start + BENCH_MARKER.length() + 1
+				&& client.partial.compare(end - BENCH_MARKER.length() - 1, BENCH_MARKER.length(), BENCH_MARKER) == 0)
+				client.done = true;
+			result.linesRead++;
+			start = end + 1;
+		}
+		client.partial.erase(0, start);
+	}
+	return (got);
+}
+
+/**
+ * @brief Give every client its script and run the server until all of
+ * them are answered and the output is drained.
+ * @param server The server.
+ * @param clients The connections.
+ * @param scripts The lines of each client, empty for the idle ones.
+ * @param commands How many commands the scripts hold together.
+ */
+static BenchResult	runScripts(Server& server, std::vector<BenchClient>& clients, const std::vector<std::string>& scripts, unsigned long commands){
+	BenchResult	result = {commands, 0, 0, 0};
+	size_t		waiting = 0;
+	int			quiet = 0;
+
+	for (size_t i = 0; i < clients.size(); i++){
+		clients[i].done = scripts[i].empty();
+		if (!scripts[i].empty()){
+			clients[i].pending = scripts[i] + "PING :" + BENCH_MARKER + CLDR;
+			waiting++;
+		}
+	}
+	while (waiting > 0 || quiet < 2){
+		unsigned long started = currentTimeUs();
+		server.runIteration(0);
+		result.serverUs += currentTimeUs() - started;
+		result.iterations++;
+		quiet = exchange(clients, result) == 0 ? quiet + 1 : 0;
+		waiting = 0;
+		for (size_t i = 0; i < clients.size(); i++)
+			waiting += !clients[i].done;
+	}
+	return (result);
+}
+
+static void	printResult(const std::string& scenario, const BenchResult& result){
+	std::cout << std::left << std::setw(16) << scenario << std::right
+		<< std::setw(10) << result.commands
+		<< std::setw(12) << result.linesRead
+		<< std::setw(12) << result.iterations
+		<< std::setw(12) << std::fixed << std::setprecision(1) << result.serverUs / 1000.0
+		<< std::setw(16) << std::setprecision(2) << static_cast<double>(result.serverUs) / result.commands
+		<< std::endl;
+}
+
+static std::string	nick(char prefix, size_t index){
+	std::ostringstream out;
+
+	out << prefix << index;
+	return (out.str());
+}
+
+int	main(int ac, char **av){
+	size_t		clientCount = ac > 1 ? std::strtoul(av[1], NULL, 10) : 100;
+	size_t		rounds = ac > 2 ? std::strtoul(av[2], NULL, 10) : 200;
+	std::string	configPath = ac > 3 ? av[3] : "tools/bench.conf";
+
+	if (ac > 4 || clientCount < 2 || rounds < 10){
+		std::cerr << "Usage: ./ircbench [clients >= 2] [rounds >= 10] [config]" << std::endl;
+		return (2);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	Server *server = NULL;
+	std::vector<BenchClient> clients(clientCount);
+	try {
+		Config config;
+		config.load(configPath);
+		// The server logs every line it sends, that is not what is measured
+		std::cout.setstate(std::ios::badbit);
+		server = new Server(BENCH_PASSWORD, config);
+		for (size_t i = 0; i < clientCount; i++){
+			clients[i].fd = server->openLocalConnection(INADDR_LOOPBACK);
+			if (clients[i].fd < 0)
+				throw (std::runtime_error("the server refused connection " + nick('#', i) + ", raise max_clients"));
+		}
+	} catch (std::exception& err){
+		std::cout.clear();
+		std::cerr << "ircbench: " << err.what() << std::endl;
+		delete (server);
+		return (2);
+	}
+
+	std::vector<std::pair<std::string, BenchResult> > results;
+	std::vector<std::string> scripts(clientCount);
+	const std::string channel = "#bench";
+	unsigned long commands;
+
+	// Registration
+	for (size_t i = 0; i < clientCount; i++)
+		scripts[i] = "PASS " + BENCH_PASSWORD + CLDR + "NICK " + nick('u', i) + CLDR + "USER b 0 * :bench" + CLDR;
+	results.push_back(std::make_pair("register", runScripts(*server, clients, scripts, clientCount * 3)));
+
+	for (size_t i = 0; i < clientCount; i++)
+		scripts[i] = "JOIN " + channel + CLDR;
+	results.push_back(std::make_pair("join", runScripts(*server, clients, scripts, clientCount)));
+
+	// One talker, everybody else reads
+	scripts.assign(clientCount, "");
+	for (size_t r = 0; r < rounds; r++)
+		scripts[0] += "PRIVMSG " + channel + " :the quick brown fox jumps over the lazy dog" + CLDR;
+	results.push_back(std::make_pair("fanout", runScripts(*server, clients, scripts, rounds)));
+
+	// Everybody talks in the channel
+	commands = 0;
+	for (size_t i = 0; i < clientCount; i++){
+		scripts[i].clear();
+		for (size_t r = 0; r < rounds / 10; r++, commands++)
+			scripts[i] += "PRIVMSG " + channel + " :chatter from everybody" + CLDR;
+	}
+	results.push_back(std::make_pair("chatter", runScripts(*server, clients, scripts, commands)));
+
+	commands = 0;
+	for (size_t i = 0; i < clientCount; i++){
+		scripts[i].clear();
+		for (size_t r = 0; r < rounds; r++, commands++)
+			scripts[i] += "PRIVMSG " + nick('u', (i + 1) % clientCount) + " :private message" + CLDR;
+	}
+	results.push_back(std::make_pair("private", runScripts(*server, clients, scripts, commands)));
+
+	commands = 0;
+	for (size_t i = 0; i < clientCount; i++){
+		scripts[i].clear();
+		for (size_t r = 0; r < rounds; r++, commands++)
+			scripts[i] += "PING :keepalive" + CLDR;
+	}
+	results.push_back(std::make_pair("ping", runScripts(*server, clients, scripts, commands)));
+
+	scripts.assign(clientCount, "");
+	for (size_t r = 0; r < rounds / 10; r++)
+		scripts[0] += "WHO " + channel + CLDR;
+	results.push_back(std::make_pair("who", runScripts(*server, clients, scripts, rounds / 10)));
+
+	scripts.assign(clientCount, "");
+	for (size_t r = 0; r < rounds; r++)
+		scripts[0] += "TOPIC " + channel + " :topic " + nick('#', r) + CLDR;
+	results.push_back(std::make_pair("topic", runScripts(*server, clients, scripts, rounds)));
+
+	// Renames and rejoins are seen by the whole channel
+	commands = 0;
+	for (size_t i = 0; i < clientCount; i++){
+		scripts[i].clear();
+		for (size_t r = 0; r < rounds / 10; r++, commands++)
+			scripts[i] += "NICK " + nick(r % 2 ? 'u' : 'v', i) + CLDR;
+	}
+	results.push_back(std::make_pair("nick", runScripts(*server, clients, scripts, commands)));
+
+	commands = 0;
+	for (size_t i = 0; i < clientCount; i++){
+		scripts[i].clear();
+		for (size_t r = 0; r < rounds / 10; r++, commands += 2)
+			scripts[i] += "PART " + channel + CLDR + "JOIN " + channel + CLDR;
+	}
+	results.push_back(std::make_pair("part/join", runScripts(*server, clients, scripts, commands)));
+
+	std::cout.clear();
+	std::cout << clientCount << " clients, " << rounds << " rounds, " << configPath << std::endl;
+	std::cout << std::left << std::setw(16) << "scenario" << std::right << std::setw(10) << "commands"
+		<< std::setw(12) << "lines out" << std::setw(12) << "iterations" << std::setw(12) << "server ms"
+		<< std::setw(16) << "server us/cmd" << std::endl;
+	for (size_t i = 0; i < results.size(); i++)
+		printResult(results[i].first, results[i].second);
+	for (size_t i = 0; i < clients.size(); i++)
+		close(clients[i].fd);
+	std::cout.setstate(std::ios::badbit);
+	delete (server);
+	return (0);
+}
@@ -0,0 +1,355 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   replay.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: hamalmar <hamalmar@student.42abudhabi.a    +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/12/29 09:41:07 by hamalmar          #+#    #+#             */
+/*   Updated: 2025/12/29 09:41:07 by hamalmar         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "../includes/TrafficCapture.hpp"
+
+/*
+	ircreplay (make replay): plays a capture (see TrafficCapture.hpp) against
+	a server over TCP, every session on its own connection, at the captured
+	pace, faster, or as fast as the server takes it.
+
+		./ircreplay <capture> <host> <port> <password> [speed|max]
+
+	PASS lines are sent with the given password, every connection comes
+	from this machine whatever address was captured. Once a session sent
+	its PASS it carries a latency probe: after one of its lines a PING goes
+	out, and the next one only once the PONG came back, so the probes
+	measure how long the server takes to get to a client's input without
+	adding much to it. A session the capture closed sends a last probe and
+	is closed once it is answered, when the server went through all its
+	lines. Once the capture is played the sessions left get DRAIN_US for
+	that. At the end:
+
+		sessions   opened, refused (connect failed), cut (closed by the
+		           server before the capture closed them, not after a QUIT)
+		lines      replayed, dropped (their session was refused or cut)
+		replies    lines read, error numerics (4xx/5xx), ERROR lines
+		latency    probe round trips, p50 p90 p99 max, probes unanswered
+*/
+
+static const std::string PROBE_TOKEN("hai-replay-");
+static const unsigned long DRAIN_US = 5000000;
+static const size_t MAX_PENDING_BYTES = 1048576;
+
+/**
+ * @brief The connection of a captured session.
+ * @var probeSent currentTimeUs() of the PING in flight, 0 without one.
+ * @var closed The capture closed the session, the socket goes once
+ * everything is sent and answered.
+ * @var fenced The last probe was sent.
+ * @var lines The captured lines queued for the session.
+ */
+struct ReplaySession {
+	int				fd;
+	bool			connecting;
+	bool			passSent;
+	bool			closed;
+	bool			quitSent;
+	bool			fenced;
+	unsigned long	lines;
+	std::string		output;
+	std::string		input;
+	unsigned long	probeSent;
+	unsigned long	probeNumber;
+};
+
+struct ReplayStats {
+	unsigned long	opened;
+	unsigned long	refused;
+	unsigned long	cut;
+	unsigned long	lines;
+	unsigned long	dropped;
+	unsigned long	replies;
+	unsigned long	errorNumerics;
+	unsigned long	errorLines;
+	unsigned long	probesLost;
+	std::vector<unsigned long>	latencies;   // us
+};
+
+static int	connectTo(const sockaddr_in& server){
+	int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (fd < 0)
+		return (-1);
+	// The client's own Nagle delay is not what is measured
+	int enable = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 ||
+		(connect(fd, reinterpret_cast<const sockaddr *>(&server), sizeof(server)) < 0 && errno != EINPROGRESS)){
+		close(fd);
+		return (-1);
+	}
+	return (fd);
+}
+
+static bool	isQuit(const std::string& line){
+	std::string command = line.substr(0, 5);
+	std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+	return (command == "QUIT" || command == "QUIT ");
+}
+
+static void	queueProbe(ReplaySession& session){
+	std::ostringstream probe;
+
+	probe << "PING :" << PROBE_TOKEN << ++session.probeNumber << CLDR;
+	session.output += probe.str();
+	session.probeSent = currentTimeUs();
+}
+
+/**
+ * @brief Count and answer what the server sent a session: registration,
+ * errors and the PONG of its probe.
+ */
+static void	readReplies(ReplaySession& session, ReplayStats& stats){
+	size_t start = 0;
+	size_t end;
+
+	while ((end = session.input.find('\n', start)) != std::string::npos){
+		std::string line = session.input.substr(start, end - start);
+		start = end + 1;
+		stats.replies++;
+		if (line.compare(0, 5, "ERROR") == 0){
+			stats.errorLines++;
+			continue;
+		}
+		std::istringstream iss(line);
+		std::string source;
+		std::string command;
+		iss >> source >> command;
+		if (command.length() == 3 && (command[0] == '4' || command[0] == '5'))
+			stats.errorNumerics++;
+		else if (command == "PONG" && session.probeSent != 0 &&
+			line.find(PROBE_TOKEN) != std::string::npos){
+			stats.latencies.push_back(currentTimeUs() - session.probeSent);
+			session.probeSent = 0;
+		}
+	}
+	session.input.erase(0, start);
+}
+
+/**
+ * @brief Socket events of a session.
+ * @return false once the session is over (its socket is closed).
+ */
+static bool	serveSession(ReplaySession& session, short revents, ReplayStats& stats){
+	char buffer[16384];
+
+	if (session.connecting && (revents & (POLLOUT | POLLERR | POLLHUP))){
+		int error = 0;
+		socklen_t length = sizeof(error);
+		if (getsockopt(session.fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0){
+			stats.refused++;
+			stats.lines -= session.lines;
+			stats.dropped += session.lines;
+			close(session.fd);
+			return (false);
+		}
+		session.connecting = false;
+		stats.opened++;
+	}
+	if (session.connecting)
+		return (true);
+	if (!session.output.empty()){
+		ssize_t sent = send(session.fd, session.output.data(), session.output.length(), MSG_NOSIGNAL);
+		if (sent > 0)
+			session.output.erase(0, sent);
+	}
+	if (revents & (POLLIN | POLLHUP | POLLERR)){
+		ssize_t got;
+		while ((got = recv(session.fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+			session.input.append(buffer, got);
+		readReplies(session, stats);
+		if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+			if (!session.closed && !session.quitSent)
+				stats.cut++;
+			// Roughly: a probe still queued is counted as a line
+			unsigned long unsent = std::count(session.output.begin(), session.output.end(), '\n');
+			unsent = std::min(unsent, session.lines);
+			stats.lines -= unsent;
+			stats.dropped += unsent;
+			if (session.probeSent != 0)
+				stats.probesLost++;
+			close(session.fd);
+			return (false);
+		}
+	}
+	if (session.closed && session.output.empty() && session.probeSent == 0){
+		if (session.passSent && !session.quitSent && !session.fenced){
+			queueProbe(session);
+			session.fenced = true;
+			return (true);
+		}
+		close(session.fd);
+		return (false);
+	}
+	return (true);
+}
+
+/**
+ * @brief Apply one captured event.
+ */
+static void	replayEvent(const TrafficCapture::Event& event, std::map<unsigned long, ReplaySession>& sessions,
+	const sockaddr_in& server, const std::string& password, ReplayStats& stats){
+	std::map<unsigned long, ReplaySession>::iterator it = sessions.find(event.session);
+
+	if (event.kind == TrafficCapture::OPEN){
+		ReplaySession session = {connectTo(server), true, false, false, false, false, 0, "", "", 0, 0};
+		if (session.fd < 0)
+			stats.refused++;
+		else
+			sessions[event.session] = session;
+		return;
+	}
+	if (it == sessions.end()){
+		stats.dropped += event.kind == TrafficCapture::LINE;
+		return;
+	}
+	ReplaySession& session = it->second;
+	if (event.kind == TrafficCapture::CLOSE){
+		session.closed = true;
+		return;
+	}
+	std::string line = event.line;
+	if (line.compare(0, 5, "PASS ") == 0 || line.compare(0, 5, "pass ") == 0){
+		line = "PASS " + password;
+		session.passSent = true;
+	}
+	session.output += line + CLDR;
+	session.quitSent = session.quitSent || isQuit(line);
+	stats.lines++;
+	session.lines++;
+	if (session.passSent && session.probeSent == 0 && !session.quitSent)
+		queueProbe(session);
+}
+
+static double	percentile(const std::vector<unsigned long>& sorted, double fraction){
+	if (sorted.empty())
+		return (0);
+	return (sorted[static_cast<size_t>(fraction * (sorted.size() - 1))] / 1000.0);
+}
+
+int	main(int ac, char **av){
+	if (ac < 5 || ac > 6){
+		std::cerr << "Usage: ./ircreplay <capture> <host> <port> <password> [speed|max]" << std::endl;
+		return (2);
+	}
+	std::string speedName = ac == 6 ? av[5] : "1";
+	// 0 is as fast as possible
+	double speed = speedName == "max" ? 0 : std::strtod(speedName.c_str(), NULL);
+	if (speedName != "max" && speed <= 0){
+		std::cerr << "ircreplay: speed must be positive or max" << std::endl;
+		return (2);
+	}
+	sockaddr_in server;
+	std::memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(std::atoi(av[3]));
+	hostent *host = gethostbyname(av[2]);
+	if (!host || host->h_addrtype != AF_INET){
+		std::cerr << "ircreplay: unknown host " << av[2] << std::endl;
+		return (2);
+	}
+	std::memcpy(&server.sin_addr, host->h_addr_list[0], sizeof(server.sin_addr));
+
+	std::ifstream file(av[1], std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::vector<TrafficCapture::Event> events;
+	try {
+		if (!file)
+			throw (std::runtime_error(std::string("cannot read ") + av[1]));
+		StateReader reader(data.data(), data.size());
+		TrafficCapture::readHeader(reader);
+		TrafficCapture::Event event;
+		event.time = 0;
+		while (!reader.atEnd()){
+			TrafficCapture::next(reader, event);
+			events.push_back(event);
+		}
+	} catch (std::exception& err){
+		// A capture cut by a crash is played up to its last whole record
+		if (events.empty()){
+			std::cerr << "ircreplay: " << av[1] << ": " << err.what() << std::endl;
+			return (2);
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	std::map<unsigned long, ReplaySession> sessions;
+	ReplayStats stats = {0, 0, 0, 0, 0, 0, 0, 0, 0, std::vector<unsigned long>()};
+	std::vector<pollfd> fds;
+	std::vector<unsigned long> polled;
+	size_t next = 0;
+	unsigned long started = currentTimeUs();
+	unsigned long drainUntil = 0;
+
+	while (next < events.size() || (!sessions.empty() && currentTimeUs() < drainUntil)){
+		unsigned long now = currentTimeUs();
+		size_t pending = 0;
+		for (std::map<unsigned long, ReplaySession>::iterator it = sessions.begin(); it != sessions.end(); ++it)
+			pending += it->second.output.size();
+		// At full speed the capture is fed as the server takes it
+		while (next < events.size() && (speed == 0 ? pending < MAX_PENDING_BYTES :
+			events[next].time * 1000 / speed <= now - started)){
+			pending += events[next].line.size();
+			replayEvent(events[next++], sessions, server, av[4], stats);
+		}
+		if (next == events.size() && drainUntil == 0){
+			drainUntil = currentTimeUs() + DRAIN_US;
+			// What the capture left open is closed once it has its answers
+			for (std::map<unsigned long, ReplaySession>::iterator it = sessions.begin(); it != sessions.end(); ++it)
+				it->second.closed = true;
+		}
+
+		fds.clear();
+		polled.clear();
+		for (std::map<unsigned long, ReplaySession>::iterator it = sessions.begin(); it != sessions.end(); ++it){
+			pollfd entry = {it->second.fd, POLLIN, 0};
+			if (it->second.connecting || !it->second.output.empty())
+				entry.events |= POLLOUT;
+			fds.push_back(entry);
+			polled.push_back(it->first);
+		}
+		int timeout = 100;
+		if (next < events.size() && speed != 0){
+			double due = events[next].time * 1000 / speed;
+			double wait = (due - (currentTimeUs() - started)) / 1000;
+			timeout = wait < 0 ? 0 : (wait < timeout ? static_cast<int>(wait) : timeout);
+		} else if (next < events.size())
+			timeout = 0;
+		if (poll(fds.empty() ? NULL : &fds[0], fds.size(), timeout) < 0 && errno != EINTR)
+			break;
+		for (size_t i = 0; i < fds.size(); i++){
+			ReplaySession& session = sessions[polled[i]];
+			if (!serveSession(session, fds[i].revents, stats))
+				sessions.erase(polled[i]);
+		}
+	}
+	for (std::map<unsigned long, ReplaySession>::iterator it = sessions.begin(); it != sessions.end(); ++it){
+		stats.probesLost += it->second.probeSent != 0;
+		close(it->second.fd);
+	}
+
+	std::sort(stats.latencies.begin(), stats.latencies.end());
+	double captured = events.empty() ? 0 : events.back().time / 1000.0;
+	std::cout << std::fixed << std::setprecision(3)
+		<< "capture   " << events.size() << " records over " << captured << " s, replayed in "
+		<< (currentTimeUs() - started) / 1000000.0 << " s (speed " << speedName << ")\n"
+		<< "sessions  " << stats.opened << " opened, " << stats.refused << " refused, " << stats.cut << " cut\n"
+		<< "lines     " << stats.lines << " replayed, " << stats.dropped << " dropped\n"
+		<< "replies   " << stats.replies << " lines, " << stats.errorNumerics << " error numerics, "
+		<< stats.errorLines << " ERROR\n"
+		<< std::setprecision(2)
+		<< "latency   " << stats.latencies.size() << " probes, p50 " << percentile(stats.latencies, 0.5)
+		<< " ms, p90 " << percentile(stats.latencies, 0.9) << " ms, p99 " << percentile(stats.latencies, 0.99)
+		<< " ms, max " << percentile(stats.latencies, 1) << " ms, " << stats.probesLost << " unanswered" << std::endl;
+	return (0);
+}